@@ -12,12 +12,43 @@
 #include <gpuplay.h>
 
 #define NV_MMIO_DUMP_FLUSH_FREQUENCY     65536
+#define NV_VRAM_DUMP_CHUNK_SIZE          0x100000        // VRAM is dumped 1MB at a time
+#define NV_VRAM_DUMP_FILE_NAME           "vram.bin"      // Written next to the log file
+#define NV_BENCH_BLOCK_SIZE              0x400000        // Working set for the throughput benchmarks
+#define NV_BENCH_ITERATIONS              5               // Runs per case in the VRAM bandwidth suite
+#define NV_BENCH_STRIDE                  0x1000          // Stride for the strided VRAM bandwidth cases
+
+#define NV_BENCH_PCI_TIMING_SIZE         0x100000        // Smaller working set for the latency timer/cache line sweep, since it runs every combination
+#define NV_BENCH_PCI_TIMING_CSV_NAME     "pci_tim.csv"   // Written next to the log file
+
+#define NV_PCI_SNAPSHOT_FILE_NAME        "pci_cfg.bin"   // Raw config space image, written next to the log file
+
+#define NV_VBIOS_INI_SECTION             "DumpVBIOS"
+#define NV_VBIOS_FILE_NAME               "vbios.bin"     // Written next to the log file
+#define NV_VBIOS_DIGEST_FILE_NAME        "vbios.txt"     // CRC32 and SHA-1 of vbios.bin
+
+#define NV_PROFILE_INI_SECTION           "ProfileMMIO"
+#define NV_PROFILE_CSV_FILE_NAME         "mmio_lat.csv"  // Written next to the log file
+#define NV_PROFILE_MAX_REGISTERS         4096            // Enough for a 16KB MMIO BAR
+#define NV_PROFILE_DEFAULT_SAMPLES       1000            // Reads per register
+#define NV_PROFILE_DEFAULT_SLOW_FACTOR   4               // Slow = median read takes this many times longer than the typical register
+
+void NVGeneric_OutputPath(char* path, const char* file_name);
 
 bool NVGeneric_DumpPCISpace();
 bool NVGeneric_DumpMMIO();
+bool NVGeneric_DumpVRAM();
 bool NVGeneric_DumpVBIOS();
 bool NVGeneric_DumpFIFO();
 bool NVGeneric_DumpRAMHT();                         // Dump all currently loaded objects in the current channel
 bool NVGeneric_DumpRAMFC();                         // Dump all channels that are not context switched to
 bool NVGeneric_DumpRAMRO();                         // Dump any errors that may have occurred 
-bool NVGeneric_DumpPGRAPHCache();
\ No newline at end of file
+bool NVGeneric_DumpPGRAPHCache();
+
+/* Benchmarks */
+bool NVGeneric_BenchBlockIO();
+bool NVGeneric_BenchNearPtr();
+bool NVGeneric_BenchVRAM();
+bool NVGeneric_BenchAGP();
+bool NVGeneric_BenchPCITiming();
+bool NVGeneric_ProfileMMIO();
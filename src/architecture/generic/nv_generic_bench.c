@@ -0,0 +1,539 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+    
+    nv_generic_bench.c: Generic throughput benchmarks
+*/
+
+#include "gpuplay.h"
+#include <architecture/generic/nv_generic.h>
+#include <core/timing/gpu_timing.h>
+
+/* One line of the VRAM bandwidth suite */
+typedef struct nv_bench_case_s
+{
+    const char* name;
+    uint32_t width;                 // Access size in bytes, or 0 for the block API
+    bool write;
+    bool strided;                   // Walk the working set NV_BENCH_STRIDE bytes at a time instead of sequentially
+} nv_bench_case_t;
+
+static const nv_bench_case_t nv_bench_vram_cases[] = 
+{
+    { "Read8", 1, false, false },
+    { "Read16", 2, false, false },
+    { "Read32", 4, false, false },
+    { "Write8", 1, true, false },
+    { "Write16", 2, true, false },
+    { "Write32", 4, true, false },
+    { "Read8 strided", 1, false, true },
+    { "Read16 strided", 2, false, true },
+    { "Read32 strided", 4, false, true },
+    { "Write8 strided", 1, true, true },
+    { "Write16 strided", 2, true, true },
+    { "Write32 strided", 4, true, true },
+    { "ReadBlock", 0, false, false },
+    { "WriteBlock", 0, true, false },
+    { "FillBlock", 0, true, true },         // block "strided" write = fill
+};
+
+#define NV_BENCH_VRAM_NUM_CASES     (sizeof(nv_bench_vram_cases) / sizeof(nv_bench_case_t))
+
+/* Convert a byte count and a TSC delta into MB/s */
+static double NVGeneric_BenchMBps(uint32_t bytes, uint64_t cycles)
+{
+    if (!cycles)
+        cycles = 1;
+
+    return ((double)bytes / 1048576.0) / Timing_CyclesToSeconds(cycles);
+}
+
+static void NVGeneric_BenchReport(const char* name, uint32_t bytes, uint64_t per_dword, uint64_t block)
+{
+    double per_dword_mbps = NVGeneric_BenchMBps(bytes, per_dword);
+    double block_mbps = NVGeneric_BenchMBps(bytes, block);
+
+    Logging_Write(log_level_message, "[BENCH] %-6s per-dword %9.2f MB/s, block %9.2f MB/s (%.2fx)\n", 
+        name, per_dword_mbps, block_mbps, block_mbps / per_dword_mbps);
+}
+
+/* Compare the per-dword DFB accessors against the block transfer API */
+bool NVGeneric_BenchBlockIO()
+{
+    uint32_t size = NV_BENCH_BLOCK_SIZE;
+
+    if (current_device.vram_amount
+    && current_device.vram_amount < size)
+        size = current_device.vram_amount;
+
+    uint32_t* buffer = calloc(1, size);
+
+    if (!buffer)
+    {
+        Logging_Write(log_level_error, "Failed to allocate memory for the block I/O benchmark\n");
+        return false;
+    }
+
+    Logging_Write(log_level_message, "Block I/O benchmark: %lu KB working set\n", size / 1024);
+
+    // the reads capture what is currently in VRAM, so the writes put it straight back
+    uint64_t start = Timing_ReadTSC();
+
+    for (uint32_t offset = 0; offset < size; offset += 4)
+        buffer[offset >> 2] = nv_dfb_read32(offset);
+
+    uint64_t read_per_dword = Timing_ReadTSC() - start;
+
+    start = Timing_ReadTSC();
+    nv_dfb_read_block(0, buffer, size);
+    uint64_t read_block = Timing_ReadTSC() - start;
+
+    start = Timing_ReadTSC();
+
+    for (uint32_t offset = 0; offset < size; offset += 4)
+        nv_dfb_write32(offset, buffer[offset >> 2]);
+
+    GPU_FlushWrites();      // queued writes haven't reached VRAM yet
+    uint64_t write_per_dword = Timing_ReadTSC() - start;
+
+    start = Timing_ReadTSC();
+    nv_dfb_write_block(0, buffer, size);
+    GPU_FlushWrites();
+    uint64_t write_block = Timing_ReadTSC() - start;
+
+    start = Timing_ReadTSC();
+
+    for (uint32_t offset = 0; offset < size; offset += 4)
+        nv_dfb_write32(offset, 0x00000000);
+
+    GPU_FlushWrites();
+    uint64_t fill_per_dword = Timing_ReadTSC() - start;
+
+    start = Timing_ReadTSC();
+    nv_dfb_fill32(0, 0x00000000, size);
+    GPU_FlushWrites();
+    uint64_t fill_block = Timing_ReadTSC() - start;
+
+    // undo the fill
+    nv_dfb_write_block(0, buffer, size);
+    GPU_FlushWrites();
+    free(buffer);
+
+    NVGeneric_BenchReport("Read", size, read_per_dword, read_block);
+    NVGeneric_BenchReport("Write", size, write_per_dword, write_block);
+    NVGeneric_BenchReport("Fill", size, fill_per_dword, fill_block);
+
+    return true;
+}
+
+/* Write an address pattern over the working set and read it back. Returns the number of mismatches */
+static uint32_t NVGeneric_BenchPattern(uint32_t size, uint64_t* write_ticks, uint64_t* read_ticks)
+{
+    uint32_t errors = 0;
+
+    uint64_t start = Timing_ReadTSC();
+
+    for (uint32_t offset = 0; offset < size; offset += 4)
+        nv_dfb_write32(offset, offset ^ 0xA5A5A5A5);
+
+    GPU_FlushWrites();      // queued writes haven't reached VRAM yet
+    *write_ticks = Timing_ReadTSC() - start;
+
+    start = Timing_ReadTSC();
+
+    for (uint32_t offset = 0; offset < size; offset += 4)
+    {
+        if (nv_dfb_read32(offset) != (offset ^ 0xA5A5A5A5))
+            errors++;
+    }
+
+    *read_ticks = Timing_ReadTSC() - start;
+
+    return errors;
+}
+
+/* Run the same VRAM pattern test through the selector path and the near pointer path */
+bool NVGeneric_BenchNearPtr()
+{
+    uint32_t size = NV_BENCH_BLOCK_SIZE;
+
+    if (current_device.vram_amount
+    && current_device.vram_amount < size)
+        size = current_device.vram_amount;
+
+    // near pointers may not have been requested on the command line, so turn them on just for this test
+    bool nearptr_was_enabled = (current_device.bar1 != NULL);
+
+    if (!nearptr_was_enabled
+    && !GPU_EnableNearPointers())
+    {
+        Logging_Write(log_level_error, "Near pointer benchmark: near pointers unavailable\n");
+        return false;
+    }
+
+    uint32_t* buffer = calloc(1, size);
+
+    if (!buffer)
+    {
+        Logging_Write(log_level_error, "Failed to allocate memory for the near pointer benchmark\n");
+
+        if (!nearptr_was_enabled)
+            GPU_DisableNearPointers();
+
+        return false;
+    }
+
+    nv_dfb_read_block(0, buffer, size);
+
+    uint64_t far_write = 0, far_read = 0, near_write = 0, near_read = 0;
+
+    // hide the near pointer so the accessors take the selector path
+    void* bar1 = current_device.bar1;
+    current_device.bar1 = NULL;
+    uint32_t far_errors = NVGeneric_BenchPattern(size, &far_write, &far_read);
+    current_device.bar1 = bar1;
+
+    uint32_t near_errors = NVGeneric_BenchPattern(size, &near_write, &near_read);
+
+    nv_dfb_write_block(0, buffer, size);
+    free(buffer);
+
+    if (!nearptr_was_enabled)
+        GPU_DisableNearPointers();
+
+    Logging_Write(log_level_message, "Near pointer benchmark: %lu KB working set\n", size / 1024);
+    Logging_Write(log_level_message, "[BENCH] Write  selector %9.2f MB/s, near %9.2f MB/s\n", 
+        NVGeneric_BenchMBps(size, far_write), NVGeneric_BenchMBps(size, near_write));
+    Logging_Write(log_level_message, "[BENCH] Read   selector %9.2f MB/s, near %9.2f MB/s\n", 
+        NVGeneric_BenchMBps(size, far_read), NVGeneric_BenchMBps(size, near_read));
+
+    if (far_errors || near_errors)
+    {
+        Logging_Write(log_level_error, "Pattern mismatches: %lu (selector), %lu (near)\n", far_errors, near_errors);
+        return false;
+    }
+
+    return true;
+}
+
+/* Make one pass over the working set. Strided passes touch the same bytes as sequential ones, just column by column */
+static uint32_t NVGeneric_BenchVRAMPass(const nv_bench_case_t* bench_case, uint32_t size, void* buffer)
+{
+    uint32_t sink = 0;
+
+    if (!bench_case->width)
+    {
+        if (!bench_case->write)
+            nv_dfb_read_block(0, buffer, size);
+        else if (!bench_case->strided)
+            nv_dfb_write_block(0, buffer, size);
+        else
+            nv_dfb_fill32(0, 0x5A5A5A5A, size);
+
+        return 0;
+    }
+
+    uint32_t stride = (bench_case->strided) ? NV_BENCH_STRIDE : size;
+
+    for (uint32_t column = 0; column < stride; column += bench_case->width)
+    {
+        for (uint32_t offset = column; offset < size; offset += stride)
+        {
+            switch (bench_case->width)
+            {
+                case 1:
+                    if (bench_case->write)
+                        nv_dfb_write8(offset, offset);
+                    else
+                        sink ^= nv_dfb_read8(offset);
+                    break;
+                case 2:
+                    if (bench_case->write)
+                        nv_dfb_write16(offset, offset);
+                    else
+                        sink ^= nv_dfb_read16(offset);
+                    break;
+                case 4:
+                    if (bench_case->write)
+                        nv_dfb_write32(offset, offset);
+                    else
+                        sink ^= nv_dfb_read32(offset);
+                    break;
+            }
+        }
+    }
+
+    return sink;
+}
+
+static int NVGeneric_BenchCompare(const void* a, const void* b)
+{
+    double da = *(const double*)a, db = *(const double*)b;
+    return (da > db) - (da < db);
+}
+
+/* VRAM/LFB bandwidth suite: 8/16/32-bit sequential and strided, plus the block paths. Reports min/median/max over NV_BENCH_ITERATIONS runs */
+bool NVGeneric_BenchVRAM()
+{
+    uint32_t size = NV_BENCH_BLOCK_SIZE;
+
+    if (current_device.vram_amount
+    && current_device.vram_amount < size)
+        size = current_device.vram_amount;
+
+    // whatever is on screen goes back when we're done
+    uint32_t* saved = calloc(1, size);
+    uint32_t* buffer = calloc(1, size);
+
+    if (!saved
+    || !buffer)
+    {
+        Logging_Write(log_level_error, "Failed to allocate memory for the VRAM bandwidth benchmark\n");
+        free(saved);
+        free(buffer);
+        return false;
+    }
+
+    nv_dfb_read_block(0, saved, size);
+
+    for (uint32_t i = 0; i < (size >> 2); i++)
+        buffer[i] = i ^ 0xA5A5A5A5;
+
+    Logging_Write(log_level_message, "VRAM bandwidth benchmark: %lu KB working set, %d iterations, %d byte stride\n", 
+        size / 1024, NV_BENCH_ITERATIONS, NV_BENCH_STRIDE);
+
+    for (uint32_t case_number = 0; case_number < NV_BENCH_VRAM_NUM_CASES; case_number++)
+    {
+        const nv_bench_case_t* bench_case = &nv_bench_vram_cases[case_number];
+        double mbps[NV_BENCH_ITERATIONS];
+
+        for (uint32_t iteration = 0; iteration < NV_BENCH_ITERATIONS; iteration++)
+        {
+            uint64_t start = Timing_ReadTSC();
+            NVGeneric_BenchVRAMPass(bench_case, size, buffer);
+            GPU_FlushWrites();      // queued writes haven't reached VRAM yet
+            mbps[iteration] = NVGeneric_BenchMBps(size, Timing_ReadTSC() - start);
+        }
+
+        qsort(mbps, NV_BENCH_ITERATIONS, sizeof(double), NVGeneric_BenchCompare);
+
+        Logging_Write(log_level_message, "[BENCH] %-16s min %9.2f MB/s, median %9.2f MB/s, max %9.2f MB/s\n", 
+            bench_case->name, mbps[0], mbps[NV_BENCH_ITERATIONS / 2], mbps[NV_BENCH_ITERATIONS - 1]);
+    }
+
+    nv_dfb_write_block(0, saved, size);
+    free(saved);
+    free(buffer);
+
+    return true;
+}
+
+/* LFB write bandwidth for every AGP rate/fast write/sideband combination both sides support, then back to the BIOS setup */
+bool NVGeneric_BenchAGP()
+{
+    if (!AGP_Init())
+        return false;
+
+    uint32_t common = AGP_CommonModes();
+    uint32_t size = NV_BENCH_BLOCK_SIZE;
+
+    if (current_device.vram_amount
+    && current_device.vram_amount < size)
+        size = current_device.vram_amount;
+
+    uint32_t* saved = calloc(1, size);
+    uint32_t* buffer = calloc(1, size);
+
+    if (!saved
+    || !buffer)
+    {
+        Logging_Write(log_level_error, "Failed to allocate memory for the AGP mode benchmark\n");
+        free(saved);
+        free(buffer);
+        return false;
+    }
+
+    nv_dfb_read_block(0, saved, size);
+
+    for (uint32_t i = 0; i < (size >> 2); i++)
+        buffer[i] = i ^ 0xA5A5A5A5;
+
+    Logging_Write(log_level_message, "AGP mode benchmark: %lu KB working set, %d iterations, common modes %03lx\n", 
+        size / 1024, NV_BENCH_ITERATIONS, common);
+
+    bool success = true;
+
+    for (uint32_t rate = PCI_AGP_RATE_1X; rate <= PCI_AGP_RATE_4X; rate <<= 1)
+    {
+        for (uint32_t mode = 0; mode < 4; mode++)
+        {
+            bool fast_writes = (mode & 1), sideband = (mode & 2);
+
+            if (!(common & rate)
+            || (fast_writes && !(common & PCI_AGP_FAST_WRITES))
+            || (sideband && !(common & PCI_AGP_SIDEBAND)))
+                continue;
+
+            if (!AGP_Configure(rate, fast_writes, sideband))
+            {
+                success = false;
+                continue;
+            }
+
+            double mbps[NV_BENCH_ITERATIONS];
+
+            for (uint32_t iteration = 0; iteration < NV_BENCH_ITERATIONS; iteration++)
+            {
+                uint64_t start = Timing_ReadTSC();
+                nv_dfb_write_block(0, buffer, size);
+                GPU_FlushWrites();
+                mbps[iteration] = NVGeneric_BenchMBps(size, Timing_ReadTSC() - start);
+            }
+
+            qsort(mbps, NV_BENCH_ITERATIONS, sizeof(double), NVGeneric_BenchCompare);
+
+            Logging_Write(log_level_message, "[BENCH] AGP %lux%-8s min %9.2f MB/s, median %9.2f MB/s, max %9.2f MB/s\n", rate,
+                (fast_writes && sideband) ? " FW SBA" : (fast_writes) ? " FW" : (sideband) ? " SBA" : "",
+                mbps[0], mbps[NV_BENCH_ITERATIONS / 2], mbps[NV_BENCH_ITERATIONS - 1]);
+        }
+    }
+
+    AGP_Restore();
+
+    nv_dfb_write_block(0, saved, size);
+    free(saved);
+    free(buffer);
+
+    return success;
+}
+
+// Values tried by the latency timer/cache line sweep. Cache line size is in dwords; 0 turns off Memory Write and Invalidate bursts
+static const uint8_t nv_bench_latency_timers[] = { 0x00, 0x20, 0x40, 0x60, 0x80, 0xC0, 0xF8 };
+static const uint8_t nv_bench_cache_line_sizes[] = { 0, 4, 8, 16 };
+
+#define NV_BENCH_NUM_LATENCY_TIMERS     (sizeof(nv_bench_latency_timers) / sizeof(uint8_t))
+#define NV_BENCH_NUM_CACHE_LINE_SIZES   (sizeof(nv_bench_cache_line_sizes) / sizeof(uint8_t))
+
+/* Median MB/s of NV_BENCH_ITERATIONS LFB block reads or writes */
+static double NVGeneric_BenchLFBMedian(void* buffer, uint32_t size, bool write)
+{
+    double mbps[NV_BENCH_ITERATIONS];
+
+    for (uint32_t iteration = 0; iteration < NV_BENCH_ITERATIONS; iteration++)
+    {
+        uint64_t start = Timing_ReadTSC();
+
+        if (write)
+        {
+            nv_dfb_write_block(0, buffer, size);
+            GPU_FlushWrites();
+        }
+        else
+            nv_dfb_read_block(0, buffer, size);
+
+        mbps[iteration] = NVGeneric_BenchMBps(size, Timing_ReadTSC() - start);
+    }
+
+    qsort(mbps, NV_BENCH_ITERATIONS, sizeof(double), NVGeneric_BenchCompare);
+    return mbps[NV_BENCH_ITERATIONS / 2];
+}
+
+/* LFB bandwidth for each latency timer and cache line size setting, then back to what the BIOS set. Results go to a CSV as well as the log */
+bool NVGeneric_BenchPCITiming()
+{
+    pci_config_snapshot_t* pci_config = PCI_CurrentConfig();
+    uint8_t original_latency_timer = pci_config->decoded.latency_timer;
+    uint8_t original_cache_line_size = pci_config->decoded.cache_line_size;
+    uint32_t size = NV_BENCH_PCI_TIMING_SIZE;
+
+    if (current_device.vram_amount
+    && current_device.vram_amount < size)
+        size = current_device.vram_amount;
+
+    uint32_t* saved = calloc(1, size);
+    uint32_t* buffer = calloc(1, size);
+
+    if (!saved
+    || !buffer)
+    {
+        Logging_Write(log_level_error, "Failed to allocate memory for the latency timer/cache line benchmark\n");
+        free(saved);
+        free(buffer);
+        return false;
+    }
+
+    nv_dfb_read_block(0, saved, size);
+
+    char csv_path[MAX_STR] = {0};
+    NVGeneric_OutputPath(csv_path, NV_BENCH_PCI_TIMING_CSV_NAME);
+    FILE* csv = fopen(csv_path, "w");
+
+    if (!csv)
+        Logging_Write(log_level_error, "Failed to open %s for writing\n", csv_path);
+    else
+        fprintf(csv, "latency_timer,cache_line_size,write_mbps,read_mbps\n");
+
+    Logging_Write(log_level_message, "Latency timer/cache line benchmark: %lu KB working set, %d iterations, BIOS set latency timer %02x, cache line size %02x\n",
+        size / 1024, NV_BENCH_ITERATIONS, original_latency_timer, original_cache_line_size);
+    Logging_Write(log_level_message, "[BENCH] Latency CacheLine      Write MB/s      Read MB/s\n");
+
+    double best_write = 0, best_read = 0;
+    uint8_t best_write_latency = 0, best_write_cache_line = 0, best_read_latency = 0, best_read_cache_line = 0;
+
+    for (uint32_t latency = 0; latency < NV_BENCH_NUM_LATENCY_TIMERS; latency++)
+    {
+        for (uint32_t cache_line = 0; cache_line < NV_BENCH_NUM_CACHE_LINE_SIZES; cache_line++)
+        {
+            PCI_WriteConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_LATENCY_TIMER, nv_bench_latency_timers[latency]);
+            PCI_WriteConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_CACHE_LINE_SIZE, nv_bench_cache_line_sizes[cache_line]);
+
+            // low latency timer bits and unsupported cache line sizes can be hardwired, so report what actually stuck
+            uint8_t latency_timer = pci_config->decoded.latency_timer;
+            uint8_t cache_line_size = pci_config->decoded.cache_line_size;
+
+            double write_mbps = NVGeneric_BenchLFBMedian(buffer, size, true);
+            double read_mbps = NVGeneric_BenchLFBMedian(buffer, size, false);
+
+            Logging_Write(log_level_message, "[BENCH]      %02x        %02x %14.2f %14.2f%s\n", latency_timer, cache_line_size, write_mbps, read_mbps,
+                (latency_timer != nv_bench_latency_timers[latency] || cache_line_size != nv_bench_cache_line_sizes[cache_line]) ? " (didn't stick)" : "");
+
+            if (csv)
+                fprintf(csv, "%02x,%02x,%.2f,%.2f\n", latency_timer, cache_line_size, write_mbps, read_mbps);
+
+            if (write_mbps > best_write)
+            {
+                best_write = write_mbps;
+                best_write_latency = latency_timer;
+                best_write_cache_line = cache_line_size;
+            }
+
+            if (read_mbps > best_read)
+            {
+                best_read = read_mbps;
+                best_read_latency = latency_timer;
+                best_read_cache_line = cache_line_size;
+            }
+        }
+    }
+
+    PCI_WriteConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_LATENCY_TIMER, original_latency_timer);
+    PCI_WriteConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_CACHE_LINE_SIZE, original_cache_line_size);
+
+    Logging_Write(log_level_message, "[BENCH] Best write: latency timer %02x, cache line size %02x (%.2f MB/s)\n", best_write_latency, best_write_cache_line, best_write);
+    Logging_Write(log_level_message, "[BENCH] Best read: latency timer %02x, cache line size %02x (%.2f MB/s)\n", best_read_latency, best_read_cache_line, best_read);
+
+    if (csv)
+    {
+        fclose(csv);
+        Logging_Write(log_level_message, "Latency timer/cache line results written to %s\n", csv_path);
+    }
+
+    nv_dfb_write_block(0, saved, size);
+    free(saved);
+    free(buffer);
+
+    return true;
+}
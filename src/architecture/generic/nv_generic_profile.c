@@ -0,0 +1,241 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    nv_generic_profile.c: Per-register MMIO latency profiler
+*/
+
+#include "gpuplay.h"
+#include <architecture/generic/nv_generic.h>
+#include <config/config.h>
+#include <core/timing/gpu_timing.h>
+#include <util/ini.h>
+
+/* Per-register results, kept until every register has been timed so slow ones can be judged against the rest */
+typedef struct nv_profile_result_s
+{
+    uint32_t offset;
+    uint32_t min;                   // All in cycles, with the RDTSC overhead taken off
+    uint32_t p50;
+    uint32_t p99;
+    uint32_t max;
+    double mean;
+    timing_histogram_t histogram;
+} nv_profile_result_t;
+
+static int NVGeneric_ProfileCompare(const void* a, const void* b)
+{
+    uint32_t ua = *(const uint32_t*)a, ub = *(const uint32_t*)b;
+    return (ua > ub) - (ua < ub);
+}
+
+/* Size of the MMIO BAR, from the selector limit the init function set up */
+static uint32_t NVGeneric_ProfileMMIOSize()
+{
+#ifdef __DJGPP__
+    if (current_device.bar0_selector)
+        return __dpmi_get_segment_limit(current_device.bar0_selector) + 1;
+#endif
+
+    if (gpu_io_backend == &gpu_io_backend_sim)
+        return GPU_SIM_MMIO_SIZE;
+
+    return 0;
+}
+
+/* Cost of the two RDTSCs around each sample, so it can be taken off */
+static uint32_t NVGeneric_ProfileOverhead()
+{
+    uint64_t best = UINT64_MAX;
+
+    for (uint32_t i = 0; i < NV_PROFILE_DEFAULT_SAMPLES; i++)
+    {
+        uint64_t start = Timing_ReadTSC();
+        uint64_t cycles = Timing_ReadTSC() - start;
+
+        if (cycles < best)
+            best = cycles;
+    }
+
+    return (uint32_t)best;
+}
+
+/* Build the register list: either Registers= from the INI, or every dword from Start= to End= */
+static uint32_t NVGeneric_ProfileBuildList(uint32_t* offsets, uint32_t mmio_size)
+{
+    ini_section_t section = ini_find_section(config.ini_file, NV_PROFILE_INI_SECTION);
+    char* registers = ini_section_get_string(section, "Registers", NULL);
+    uint32_t count = 0;
+
+    if (registers
+    && registers[0])
+    {
+        char* str = registers;
+
+        while (*str
+        && count < NV_PROFILE_MAX_REGISTERS)
+        {
+            char* end = NULL;
+            uint32_t offset = strtoul(str, &end, 16) & ~3;
+
+            if (end == str)
+                break;
+
+            if (offset < mmio_size)
+                offsets[count++] = offset;
+            else
+                Logging_Write(log_level_warning, "ProfileMMIO: register %08lx is outside the BAR, skipping\n", offset);
+
+            str = end + strspn(end, ", \t");
+        }
+
+        return count;
+    }
+
+    uint32_t start = ini_section_get_hex32(section, "Start", 0) & ~3;
+    uint32_t end = ini_section_get_hex32(section, "End", mmio_size);
+
+    if (end > mmio_size)
+        end = mmio_size;
+
+    for (uint32_t offset = start; offset < end && count < NV_PROFILE_MAX_REGISTERS; offset += 4)
+        offsets[count++] = offset;
+
+    return count;
+}
+
+/* Time every register on the list, then write a CSV and flag the ones that are much slower than the rest */
+bool NVGeneric_ProfileMMIO()
+{
+    uint32_t mmio_size = NVGeneric_ProfileMMIOSize();
+
+    if (!mmio_size)
+    {
+        Logging_Write(log_level_error, "ProfileMMIO: this GPU has no MMIO BAR mapped\n");
+        return false;
+    }
+
+    ini_section_t section = ini_find_section(config.ini_file, NV_PROFILE_INI_SECTION);
+    uint32_t samples = ini_section_get_uint(section, "Samples", NV_PROFILE_DEFAULT_SAMPLES);
+    uint32_t slow_factor = ini_section_get_uint(section, "SlowFactor", NV_PROFILE_DEFAULT_SLOW_FACTOR);
+    uint32_t slow_ns = ini_section_get_uint(section, "SlowNs", 0);
+
+    if (!samples)
+        samples = NV_PROFILE_DEFAULT_SAMPLES;
+
+    uint32_t* offsets = calloc(NV_PROFILE_MAX_REGISTERS, sizeof(uint32_t));
+    uint32_t* cycles = calloc(samples, sizeof(uint32_t));
+    nv_profile_result_t* results = calloc(NV_PROFILE_MAX_REGISTERS, sizeof(nv_profile_result_t));
+    uint32_t* medians = calloc(NV_PROFILE_MAX_REGISTERS, sizeof(uint32_t));
+
+    if (!offsets
+    || !cycles
+    || !results
+    || !medians)
+    {
+        Logging_Write(log_level_error, "Failed to allocate memory for the MMIO latency profiler\n");
+        free(offsets);
+        free(cycles);
+        free(results);
+        free(medians);
+        return false;
+    }
+
+    uint32_t num_registers = NVGeneric_ProfileBuildList(offsets, mmio_size);
+    uint32_t overhead = NVGeneric_ProfileOverhead();
+
+    Logging_Write(log_level_message, "MMIO latency profiler: %lu registers, %lu samples each, %lu cycle timer overhead\n",
+        num_registers, samples, overhead);
+
+    for (uint32_t reg = 0; reg < num_registers; reg++)
+    {
+        nv_profile_result_t* result = &results[reg];
+        uint64_t total = 0;
+
+        result->offset = offsets[reg];
+        Timing_HistogramReset(&result->histogram, NULL);
+
+        for (uint32_t sample = 0; sample < samples; sample++)
+        {
+            uint64_t start = Timing_ReadTSC();
+            mmio_read32(result->offset);
+            uint64_t elapsed = Timing_ReadTSC() - start;
+
+            elapsed = (elapsed > overhead) ? elapsed - overhead : 0;
+            cycles[sample] = (uint32_t)elapsed;
+            total += elapsed;
+            Timing_HistogramAdd(&result->histogram, elapsed);
+        }
+
+        qsort(cycles, samples, sizeof(uint32_t), NVGeneric_ProfileCompare);
+
+        result->min = cycles[0];
+        result->p50 = cycles[samples / 2];
+        result->p99 = cycles[(samples * 99) / 100];
+        result->max = cycles[samples - 1];
+        result->mean = (double)total / samples;
+        medians[reg] = result->p50;
+    }
+
+    // "slow" is relative to the typical register on this card unless an absolute threshold is given
+    qsort(medians, num_registers, sizeof(uint32_t), NVGeneric_ProfileCompare);
+    uint32_t typical = (num_registers) ? medians[num_registers / 2] : 0;
+
+    char csv_path[MAX_STR] = {0};
+    NVGeneric_OutputPath(csv_path, NV_PROFILE_CSV_FILE_NAME);
+    FILE* csv = fopen(csv_path, "w");
+
+    if (!csv)
+        Logging_Write(log_level_error, "Failed to open %s for writing\n", csv_path);
+    else
+    {
+        fprintf(csv, "offset,samples,min_ns,p50_ns,p99_ns,max_ns,mean_ns,slow");
+
+        for (uint32_t bucket = 0; bucket < TIMING_HISTOGRAM_BUCKETS; bucket++)
+            fprintf(csv, ",hist_%lluns", (1ULL << bucket));
+
+        fprintf(csv, "\n");
+    }
+
+    uint32_t num_slow = 0;
+
+    for (uint32_t reg = 0; reg < num_registers; reg++)
+    {
+        nv_profile_result_t* result = &results[reg];
+        double p50_ns = Timing_CyclesToNs(result->p50);
+        bool slow = (slow_ns) ? (p50_ns > slow_ns) : (result->p50 > typical * slow_factor);
+
+        if (slow)
+        {
+            num_slow++;
+            Logging_Write(log_level_warning, "[PROFILE] %08lx is slow: median %.1f ns, p99 %.1f ns (typical register %.1f ns)\n",
+                result->offset, p50_ns, Timing_CyclesToNs(result->p99), Timing_CyclesToNs(typical));
+        }
+
+        if (!csv)
+            continue;
+
+        fprintf(csv, "%08" PRIx32 ",%" PRIu32 ",%.1f,%.1f,%.1f,%.1f,%.1f,%d", result->offset, samples, Timing_CyclesToNs(result->min), p50_ns,
+            Timing_CyclesToNs(result->p99), Timing_CyclesToNs(result->max), Timing_CyclesToNs(result->mean), slow);
+
+        for (uint32_t bucket = 0; bucket < TIMING_HISTOGRAM_BUCKETS; bucket++)
+            fprintf(csv, ",%" PRIu32, result->histogram.buckets[bucket]);
+
+        fprintf(csv, "\n");
+    }
+
+    if (csv)
+    {
+        fclose(csv);
+        Logging_Write(log_level_message, "MMIO latency profile written to %s (%lu slow registers)\n", csv_path, num_slow);
+    }
+
+    free(offsets);
+    free(cycles);
+    free(results);
+    free(medians);
+    return (csv != NULL);
+}
@@ -12,62 +12,57 @@
 #include "gpuplay.h"
 #include <architecture/generic/nv_generic.h>
 
+/* Put an output file in the same directory as the log. GPUs after the first get their number before the extension, so -alldevices runs don't overwrite each other */
+void NVGeneric_OutputPath(char* path, const char* file_name)
+{
+    const char* log_file_name = (log_settings.file_name) ? log_settings.file_name : LOG_FILE_DEFAULT_NAME;
+    const char* separator = strrchr(log_file_name, '\\');
+
+    if (!separator)
+        separator = strrchr(log_file_name, '/');
+
+    uint32_t directory_length = (separator) ? (separator - log_file_name + 1) : 0;
+
+    if (!current_device.index)
+    {
+        snprintf(path, MAX_STR, "%.*s%s", (int)directory_length, log_file_name, file_name);
+        return;
+    }
+
+    const char* extension = strrchr(file_name, '.');
+    uint32_t stem_length = (extension) ? (extension - file_name) : strlen(file_name);
+
+    snprintf(path, MAX_STR, "%.*s%.*s%" PRIu32 "%s", (int)directory_length, log_file_name, (int)stem_length, file_name,
+        current_device.index, (extension) ? extension : "");
+}
+
 // Architecture Includes
 bool NVGeneric_DumpPCISpace()
 {
-    // read out the device id
-    uint16_t vendor_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_VENDOR_ID);
-    uint16_t device_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_DEVICE_ID);
-    uint16_t command = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_COMMAND);
-    uint16_t status = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_STATUS);
-    uint8_t revision = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_REVISION);
-    uint8_t class_id_high = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_CLASS_CODE_HIGH);
-    uint16_t class_id_low = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_CLASS_CODE_LOW);
-    uint8_t cache_line_size = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_CACHE_LINE_SIZE);
-    uint8_t latency_timer = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_LATENCY_TIMER);
-    uint8_t header_type = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_HEADER_TYPE);
-    uint8_t bist = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BIST);
-    uint32_t bar0 = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR0);
-    uint32_t bar1 = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR1);
-    uint32_t bar2 = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR2);
-    uint32_t bar3 = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR3);
-    uint32_t bar4 = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR4);
-    uint32_t bar5 = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR5);
-    uint32_t cardbus_cis_ptr = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_CARDBUS_CIS_PTR);
-    uint16_t subsystem_vendor_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_SUBSYSTEM_VENDOR_ID);
-    uint16_t subsystem_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_SUBSYSTEM_ID);
-    uint32_t rom_bar = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_EXPANSION_ROM_BASE);
-    uint8_t capabilities_ptr = PCI_ReadConfig8(current_device.bus_number, current_device.function_number,  PCI_CFG_OFFSET_CAPABILITIES_PTR);
-    uint8_t interrupt_line = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_INTERRUPT_LINE);
-    uint8_t interrupt_pin = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_INTERRUPT_PIN);
-    uint8_t minimum_grant = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_MINIMUM_GRANT);
-    uint8_t maximum_latency = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_MAXIMUM_LATENCY);
-
-    Logging_Write(log_level_message, "[PCI CFG] PCI ID %04x:%04x\n", vendor_id, device_id);
-    Logging_Write(log_level_message, "[PCI CFG] Command Register %04x\n", command);
-    Logging_Write(log_level_message, "[PCI CFG] Status Register %04x\n", status);
-    Logging_Write(log_level_message, "[PCI CFG] Revision %02x\n", revision);
-    Logging_Write(log_level_message, "[PCI CFG] Class ID: %06x\n", (class_id_high << 16) | class_id_low);
-    Logging_Write(log_level_message, "[PCI CFG] Cache Line Size %02x\n", cache_line_size);
-    Logging_Write(log_level_message, "[PCI CFG] Latency Timer %02x\n", latency_timer);
-    Logging_Write(log_level_message, "[PCI CFG] Header Type %02x (should be 0)\n", header_type);
-    Logging_Write(log_level_message, "[PCI CFG] BIST %02x\n", bist);
-    Logging_Write(log_level_message, "[PCI CFG] BAR0 %08x\n", bar0);
-    Logging_Write(log_level_message, "[PCI CFG] BAR1 %08x\n", bar1);
-    Logging_Write(log_level_message, "[PCI CFG] BAR2 %08x\n", bar2);
-    Logging_Write(log_level_message, "[PCI CFG] BAR3 %08x\n", bar3);
-    Logging_Write(log_level_message, "[PCI CFG] BAR4 %08x\n", bar4);
-    Logging_Write(log_level_message, "[PCI CFG] BAR5 %08x\n", bar5);
-    Logging_Write(log_level_message, "[PCI CFG] CardBus CIS Pointer %04x\n", cardbus_cis_ptr);
-    Logging_Write(log_level_message, "[PCI CFG] Subsystem ID %04x:%04x\n", subsystem_vendor_id, subsystem_id);
-    Logging_Write(log_level_message, "[PCI CFG] ROM BAR %04x\n", rom_bar);
-    Logging_Write(log_level_message, "[PCI CFG] Capabilities Pointer %02x\n", capabilities_ptr);
-    Logging_Write(log_level_message, "[PCI CFG] Interrupt Line %02x\n", interrupt_line);
-    Logging_Write(log_level_message, "[PCI CFG] Interrupt Pin %02x\n", interrupt_pin);
-    Logging_Write(log_level_message, "[PCI CFG] Minimum Grant %02x\n", minimum_grant);
-    Logging_Write(log_level_message, "[PCI CFG] Maximum Latency %02x\n", maximum_latency);
+    pci_config_snapshot_t* pci_config = PCI_CurrentConfig();
 
-    return true; 
+    if (!pci_config->valid)
+    {
+        Logging_Write(log_level_error, "Failed to read PCI configuration space\n");
+        return false;
+    }
+
+    PCI_SnapshotPrint(pci_config);
+    PCI_PrintCapabilities(pci_config);
+
+    // compare against the image the last run left behind, then replace it
+    char snapshot_path[MAX_STR] = {0};
+    NVGeneric_OutputPath(snapshot_path, NV_PCI_SNAPSHOT_FILE_NAME);
+
+    pci_config_snapshot_t previous = {0};
+
+    if (PCI_SnapshotLoad(&previous, snapshot_path))
+    {
+        uint32_t changed = PCI_SnapshotCompare(&previous, pci_config);
+        Logging_Write(log_level_message, "[PCI CFG] %lu bytes changed since the last run\n", changed);
+    }
+
+    return PCI_SnapshotSave(pci_config, snapshot_path); 
 }
 
 bool NVGeneric_DumpMMIO()
@@ -76,10 +71,53 @@ bool NVGeneric_DumpMMIO()
     return false;
 }
 
-bool NVGeneric_DumpVBIOS()
+/* Dump the whole of VRAM through the LFB, a chunk at a time */
+bool NVGeneric_DumpVRAM()
 {
-    Logging_Write(log_level_message, "DumpVBIOS not yet implemented for this GPU architecture\n");
-    return false;
+    if (!current_device.vram_amount)
+    {
+        Logging_Write(log_level_error, "DumpVRAM: VRAM size unknown for this GPU\n");
+        return false;
+    }
+
+    char path[MAX_STR] = {0};
+    NVGeneric_OutputPath(path, NV_VRAM_DUMP_FILE_NAME);
+
+    FILE* vram_dump = fopen(path, "wb");
+
+    if (!vram_dump)
+    {
+        Logging_Write(log_level_error, "Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    uint8_t* vram_buffer = calloc(1, NV_VRAM_DUMP_CHUNK_SIZE);
+
+    if (!vram_buffer)
+    {
+        Logging_Write(log_level_error, "Failed to allocate memory for VRAM dump\n");
+        fclose(vram_dump);
+        return false;
+    }
+
+    for (uint32_t offset = 0; offset < current_device.vram_amount; offset += NV_VRAM_DUMP_CHUNK_SIZE)
+    {
+        uint32_t size = current_device.vram_amount - offset;
+
+        if (size > NV_VRAM_DUMP_CHUNK_SIZE)
+            size = NV_VRAM_DUMP_CHUNK_SIZE;
+
+        Logging_Write(log_level_debug, "Dumping VRAM up to 0x%08X\n", offset);
+
+        nv_dfb_read_block(offset, vram_buffer, size);
+        fwrite(vram_buffer, size, 1, vram_dump);
+    }
+
+    fclose(vram_dump);
+    free(vram_buffer);
+
+    Logging_Write(log_level_message, "VRAM dump complete: %s (%lu MB)\n", path, current_device.vram_amount / 1048576);
+    return true;
 }
 
 bool NVGeneric_DumpFIFO()
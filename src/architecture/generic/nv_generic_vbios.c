@@ -0,0 +1,311 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    nv_generic_vbios.c: VBIOS dumper. Reads the expansion ROM BAR (or the shadow at C0000) in one go and checks every image in it
+*/
+
+#include "gpuplay.h"
+#include <architecture/generic/nv_generic.h>
+#include <config/config.h>
+#include <util/ini.h>
+
+#ifdef __DJGPP__
+#include "dpmi.h"
+#include "go32.h"
+#include "sys/movedata.h"
+#endif
+
+static inline uint16_t NVGeneric_ROM16(const uint8_t* rom, uint32_t offset)
+{
+    return rom[offset] | (rom[offset + 1] << 8);
+}
+
+static inline uint32_t NVGeneric_ROM32(const uint8_t* rom, uint32_t offset)
+{
+    return NVGeneric_ROM16(rom, offset) | ((uint32_t)NVGeneric_ROM16(rom, offset + 2) << 16);
+}
+
+#ifdef __DJGPP__
+
+/* Copy the whole ROM BAR out with one movedata. Returns a malloc'd buffer, or NULL if there's no usable ROM BAR */
+static uint8_t* NVGeneric_ReadROMBar(uint32_t* size)
+{
+    pci_bar_t rom_bar;
+
+    if (!PCI_ProbeRomBar(current_device.bus_number, current_device.function_number, &rom_bar))
+    {
+        Logging_Write(log_level_warning, "DumpVBIOS: %s has no expansion ROM BAR\n", current_device.device_info.name);
+        return NULL;
+    }
+
+    // the system BIOS normally assigns an address even though it leaves the ROM switched off
+    if (!rom_bar.base)
+    {
+        Logging_Write(log_level_warning, "DumpVBIOS: the expansion ROM BAR (%lu KB) was never given an address\n", rom_bar.size >> 10);
+        return NULL;
+    }
+
+    uint8_t* rom = malloc(rom_bar.size);
+
+    if (!rom)
+    {
+        Logging_Write(log_level_error, "DumpVBIOS: failed to allocate %lu KB\n", rom_bar.size >> 10);
+        return NULL;
+    }
+
+    uint32_t linear_address = 0;
+    int32_t selector = PCI_MapBar(&rom_bar, &linear_address);
+
+    if (!selector)
+    {
+        free(rom);
+        return NULL;
+    }
+
+    uint16_t command = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_COMMAND);
+    uint32_t original = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_EXPANSION_ROM_BASE);
+
+    if (!(command & PCI_CFG_OFFSET_COMMAND_MEM_ENABLED))
+        PCI_WriteConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_COMMAND, command | PCI_CFG_OFFSET_COMMAND_MEM_ENABLED);
+
+    // some chips share the ROM decoder with another BAR, so keep the window between enable and disable as short as possible
+    PCI_WriteConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_EXPANSION_ROM_BASE, rom_bar.base | PCI_ROM_BAR_ENABLE);
+    movedata(selector, 0, _my_ds(), (uint32_t)rom, rom_bar.size);
+    PCI_WriteConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_EXPANSION_ROM_BASE, original);
+
+    if (!(command & PCI_CFG_OFFSET_COMMAND_MEM_ENABLED))
+        PCI_WriteConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_COMMAND, command);
+
+    PCI_UnmapBar(selector, linear_address);
+
+    Logging_Write(log_level_debug, "DumpVBIOS: read %lu KB from the ROM BAR at %08lx\n", rom_bar.size >> 10, rom_bar.base);
+    *size = rom_bar.size;
+    return rom;
+}
+
+/* The copy the system BIOS made at C0000. Only ever the primary VGA card's, and it may have been patched during POST */
+static uint8_t* NVGeneric_ReadShadowVBIOS(uint32_t* size)
+{
+    uint8_t header[PCI_ROM_UNIT];
+
+    movedata(_dos_ds, VGA_REALMODE_VBIOS_LOCATION, _my_ds(), (uint32_t)header, sizeof(header));
+
+    if (NVGeneric_ROM16(header, 0) != PCI_ROM_SIGNATURE
+    || !header[PCI_ROM_OFFSET_SIZE])
+    {
+        Logging_Write(log_level_warning, "DumpVBIOS: no VBIOS shadow at %05x\n", VGA_REALMODE_VBIOS_LOCATION);
+        return NULL;
+    }
+
+    *size = header[PCI_ROM_OFFSET_SIZE] * PCI_ROM_UNIT;
+    uint8_t* rom = malloc(*size);
+
+    if (!rom)
+    {
+        Logging_Write(log_level_error, "DumpVBIOS: failed to allocate %lu KB\n", *size >> 10);
+        return NULL;
+    }
+
+    movedata(_dos_ds, VGA_REALMODE_VBIOS_LOCATION, _my_ds(), (uint32_t)rom, *size);
+
+    Logging_Write(log_level_debug, "DumpVBIOS: read %lu KB from the shadow at %05x\n", *size >> 10, VGA_REALMODE_VBIOS_LOCATION);
+    return rom;
+}
+
+#else
+
+// Outside DOS there's no ROM BAR mapping and no real-mode memory to find the shadow in
+static uint8_t* NVGeneric_ReadROMBar(uint32_t* size)
+{
+    Logging_Write(log_level_warning, "DumpVBIOS: the ROM BAR can only be read under DOS\n");
+    return NULL;
+}
+
+static uint8_t* NVGeneric_ReadShadowVBIOS(uint32_t* size)
+{
+    Logging_Write(log_level_warning, "DumpVBIOS: the VBIOS shadow can only be read under DOS\n");
+    return NULL;
+}
+
+#endif
+
+/*
+    Walk the image chain, checking the 55AA signature and checksum of each one.
+    Returns how many bytes the images cover (the rest of the ROM is padding), or 0 if there isn't a valid first image.
+*/
+static uint32_t NVGeneric_WalkVBIOSImages(const uint8_t* rom, uint32_t size, bool* checksums_ok)
+{
+    uint32_t offset = 0;
+    uint32_t end = 0;
+
+    *checksums_ok = true;
+
+    for (uint32_t image = 0; image < PCI_ROM_MAX_IMAGES; image++)
+    {
+        if (offset + PCI_ROM_OFFSET_PCIR + 2 > size
+        || NVGeneric_ROM16(rom, offset) != PCI_ROM_SIGNATURE)
+        {
+            if (!image)
+                Logging_Write(log_level_error, "DumpVBIOS: no 55AA signature, this isn't a ROM image\n");
+            else
+                Logging_Write(log_level_warning, "DumpVBIOS: image %lu at %05lx has no 55AA signature, stopping\n", image, offset);
+
+            break;
+        }
+
+        uint32_t length = rom[offset + PCI_ROM_OFFSET_SIZE] * PCI_ROM_UNIT;
+        uint32_t pcir = offset + NVGeneric_ROM16(rom, offset + PCI_ROM_OFFSET_PCIR);
+        uint16_t vendor_id = 0, device_id = 0;
+        uint8_t code_type = 0;
+        bool last = true;
+
+        // without a PCI data structure it's a pre-PCI image, and the size byte is all there is
+        if (pcir + PCI_ROM_PCIR_OFFSET_INDICATOR < size
+        && NVGeneric_ROM32(rom, pcir) == PCI_ROM_PCIR_SIGNATURE)
+        {
+            vendor_id = NVGeneric_ROM16(rom, pcir + PCI_ROM_PCIR_OFFSET_VENDOR_ID);
+            device_id = NVGeneric_ROM16(rom, pcir + PCI_ROM_PCIR_OFFSET_DEVICE_ID);
+            code_type = rom[pcir + PCI_ROM_PCIR_OFFSET_CODE_TYPE];
+            last = (rom[pcir + PCI_ROM_PCIR_OFFSET_INDICATOR] & PCI_ROM_PCIR_INDICATOR_LAST);
+
+            if (NVGeneric_ROM16(rom, pcir + PCI_ROM_PCIR_OFFSET_LENGTH))
+                length = NVGeneric_ROM16(rom, pcir + PCI_ROM_PCIR_OFFSET_LENGTH) * PCI_ROM_UNIT;
+        }
+
+        if (!length)
+        {
+            Logging_Write(log_level_error, "DumpVBIOS: image %lu at %05lx has a length of 0\n", image, offset);
+            break;
+        }
+
+        if (offset + length > size)
+        {
+            Logging_Write(log_level_warning, "DumpVBIOS: image %lu claims %lu KB but the ROM ends first\n", image, length >> 10);
+            length = size - offset;
+        }
+
+        uint8_t checksum = 0;
+
+        for (uint32_t byte = 0; byte < length; byte++)
+            checksum += rom[offset + byte];
+
+        if (checksum)
+            *checksums_ok = false;
+
+        Logging_Write(log_level_message, "DumpVBIOS: image %lu at %05lx: %lu KB, PCI ID %04x:%04x, code type %d, checksum %s (%02x)\n", image, offset,
+            length >> 10, vendor_id, device_id, code_type, (checksum) ? "BAD" : "ok", checksum);
+
+        if (vendor_id
+        && (vendor_id != current_device.device_info.vendor_id || device_id != current_device.device_info.device_id))
+            Logging_Write(log_level_warning, "DumpVBIOS: image %lu is for %04x:%04x, not this GPU\n", image, vendor_id, device_id);
+
+        offset += length;
+        end = offset;
+
+        if (last)
+            break;
+    }
+
+    return end;
+}
+
+/* Write the dump, and a text file with its hashes next to it so collected dumps can be told apart without opening them */
+static bool NVGeneric_SaveVBIOS(const uint8_t* rom, uint32_t size, const char* source)
+{
+    char path[MAX_STR] = {0};
+    uint8_t sha1[HASH_SHA1_DIGEST_SIZE];
+    char sha1_string[HASH_SHA1_DIGEST_SIZE * 2 + 1] = {0};
+    hash_sha1_t sha1_state;
+
+    uint32_t crc32 = Hash_CRC32(0, rom, size);
+
+    Hash_SHA1Init(&sha1_state);
+    Hash_SHA1Update(&sha1_state, rom, size);
+    Hash_SHA1Final(&sha1_state, sha1);
+
+    for (uint32_t i = 0; i < HASH_SHA1_DIGEST_SIZE; i++)
+        sprintf(&sha1_string[i * 2], "%02x", sha1[i]);
+
+    NVGeneric_OutputPath(path, NV_VBIOS_FILE_NAME);
+    FILE* stream = fopen(path, "wb");
+
+    if (!stream)
+    {
+        Logging_Write(log_level_error, "Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    bool success = (fwrite(rom, size, 1, stream) == 1);
+    fclose(stream);
+
+    if (!success)
+    {
+        Logging_Write(log_level_error, "Failed to write VBIOS to %s\n", path);
+        return false;
+    }
+
+    Logging_Write(log_level_message, "VBIOS dump complete: %s (%lu KB from %s), CRC32 %08lx, SHA-1 %s\n", path, size >> 10, source, crc32, sha1_string);
+
+    NVGeneric_OutputPath(path, NV_VBIOS_DIGEST_FILE_NAME);
+    stream = fopen(path, "w");
+
+    if (!stream)
+    {
+        Logging_Write(log_level_error, "Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    fprintf(stream, "GPU=%s\nPCIID=%04x:%04x\nSubsystem=%04x:%04x\nSource=%s\nSize=%" PRIu32 "\nCRC32=%08" PRIx32 "\nSHA1=%s\n", current_device.device_info.name,
+        current_device.pci_config.decoded.vendor_id, current_device.pci_config.decoded.device_id,
+        current_device.pci_config.decoded.subsystem_vendor_id, current_device.pci_config.decoded.subsystem_id,
+        source, size, crc32, sha1_string);
+    fclose(stream);
+    return true;
+}
+
+/* Source= in [DumpVBIOS]: auto tries the ROM BAR and falls back to the shadow, rom and shadow only try the one */
+bool NVGeneric_DumpVBIOS()
+{
+    const char* source = ini_section_get_string(ini_find_section(config.ini_file, NV_VBIOS_INI_SECTION), "Source", "auto");
+    bool try_rom = strcasecmp(source, "shadow");
+    bool try_shadow = strcasecmp(source, "rom");
+
+    for (uint32_t attempt = 0; attempt < 2; attempt++)
+    {
+        bool from_rom = (attempt == 0);
+
+        if ((from_rom && !try_rom)
+        || (!from_rom && !try_shadow))
+            continue;
+
+        uint32_t size = 0;
+        uint8_t* rom = (from_rom) ? NVGeneric_ReadROMBar(&size) : NVGeneric_ReadShadowVBIOS(&size);
+
+        if (!rom)
+            continue;
+
+        bool checksums_ok = false;
+        uint32_t length = NVGeneric_WalkVBIOSImages(rom, size, &checksums_ok);
+
+        if (!length)
+        {
+            free(rom);
+            continue;
+        }
+
+        // a shadow checksum can legitimately be off if the BIOS patched it after POST
+        if (!checksums_ok)
+            Logging_Write(log_level_warning, "DumpVBIOS: checksum mismatch, saving the dump anyway\n");
+
+        bool success = NVGeneric_SaveVBIOS(rom, length, (from_rom) ? "ROM BAR" : "shadow");
+        free(rom);
+        return success && checksums_ok;
+    }
+
+    Logging_Write(log_level_error, "DumpVBIOS: couldn't read a VBIOS (Source=%s)\n", source);
+    return false;
+}
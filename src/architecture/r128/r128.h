@@ -36,7 +36,3 @@ bool r128_dump_mmio();
 // GPUS stuff
 bool r128_gpus_section_applies(uint32_t fourcc);
 bool r128_gpus_parse_section(uint32_t fourcc, FILE* stream);
-
-// Rage128 specific state
-extern r128_state_t r128_state;
-
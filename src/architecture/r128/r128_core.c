@@ -20,64 +20,60 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-r128_state_t r128_state = {0};                    // Rage128 specific state 
+/* Rage128 specific state lives with the device, so two of the same card don't share it */
+static inline r128_state_t* r128_get_state()
+{
+    if (!current_device.arch_state)
+        current_device.arch_state = calloc(1, sizeof(r128_state_t));
+
+    return current_device.arch_state;
+}
 
 bool r128_init()
 {
-    // Read PCI BARs
+    // Size the PCI BARs
     // Rage128 layout:
-    // BAR0 = Linear Frame Buffer (LFB) - 64MB prefetchable memory
+    // BAR0 = Linear Frame Buffer (LFB) - prefetchable memory, 64MB on the boards we've seen
     // BAR1 = I/O ports (256 bytes) - not used for MMIO
     // BAR2 = Register Map (MMIO) - 16KB non-prefetchable memory
-    uint32_t bar0_base = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR0);
-    uint32_t bar2_base = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR2);
-
-    /* According to PCI spec, only the top bits matter for base addresses */
-    bar0_base &= 0xFFFFFFF0;  // 32-bit memory space, 4-byte aligned
-    bar2_base &= 0xFFFFFFF0;  // 32-bit memory space, 4-byte aligned
+    pci_bar_t* bars = current_device.bars;
+    PCI_ProbeBars(current_device.bus_number, current_device.function_number, bars);
 
-    Logging_Write(log_level_debug, "R128 - PCI BAR0 (LFB) 0x%08lX\n", bar0_base);
-    Logging_Write(log_level_debug, "R128 - PCI BAR2 (MMIO) 0x%08lX\n", bar2_base);
-    
-    /* We need to allocate an LDT for this */
-    /* So start by allocating a physical mapping. */
-
-    __dpmi_meminfo meminfo_bar0 = {0};
-    __dpmi_meminfo meminfo_bar2 = {0};
+    if (!bars[0].size
+    || bars[0].io
+    || !bars[2].size
+    || bars[2].io)
+    {
+        Logging_Write(log_level_error, "R128 - BAR0 and BAR2 must both be memory BARs (sizes %lu, %lu)\n", bars[0].size, bars[2].size);
+        return false;
+    }
 
-    // BAR0 is the Linear Frame Buffer (64MB)
-    meminfo_bar0.address = bar0_base;
-    meminfo_bar0.size = 0x4000000;  // 64MB
-    
-    // BAR2 is the Register Map / MMIO (16KB)
-    meminfo_bar2.address = bar2_base;
-    meminfo_bar2.size = 0x4000;  // 16KB
+    Logging_Write(log_level_debug, "R128 - PCI BAR0 (LFB) 0x%08lX, %lu KB\n", bars[0].base, bars[0].size >> 10);
+    Logging_Write(log_level_debug, "R128 - PCI BAR2 (MMIO) 0x%08lX, %lu KB\n", bars[2].base, bars[2].size >> 10);
 
-    current_device.bar1_dfb_start = bar0_base;  // LFB is like BAR1 on NV cards
+    current_device.bar1_dfb_start = bars[0].base;  // LFB is like BAR1 on NV cards
     // Rage128 doesn't use RAMIN like NV cards, but we'll set it for compatibility
-    current_device.ramin_start = bar2_base;
+    current_device.ramin_start = bars[2].base;
 
-    __dpmi_physical_address_mapping(&meminfo_bar0);
-    __dpmi_physical_address_mapping(&meminfo_bar2);
-    
-    Logging_Write(log_level_debug, "R128 Init: Mapping BAR2 (MMIO - 16KB) to bar0_selector...\n");
+    /* Map each BAR at the size it actually decodes, with a selector limit to match */
+    Logging_Write(log_level_debug, "R128 Init: Mapping BAR2 (MMIO) to bar0_selector...\n");
 
-    /* Set up LDT for BAR2 (MMIO) - MMIO goes to bar0_selector since mmio_read32 uses it */
-    current_device.bar0_selector = __dpmi_allocate_ldt_descriptors(1);
-    __dpmi_set_segment_base_address(current_device.bar0_selector, meminfo_bar2.address);
-    __dpmi_set_segment_limit(current_device.bar0_selector, 0x4000 - 1);  // 16KB
+    // MMIO goes to bar0_selector since mmio_read32 uses it
+    current_device.bar0_selector = PCI_MapBar(&bars[2], NULL);
 
-    Logging_Write(log_level_debug, "R128 Init: Mapping BAR0 (LFB - 64MB) to bar1_selector...\n");
+    Logging_Write(log_level_debug, "R128 Init: Mapping BAR0 (LFB) to bar1_selector...\n");
 
-    /* Set up LDT for BAR0 (LFB) - LFB goes to bar1_selector like DFB on NV cards */
-    current_device.bar1_selector = __dpmi_allocate_ldt_descriptors(1);
-    __dpmi_set_segment_base_address(current_device.bar1_selector, meminfo_bar0.address);
-    __dpmi_set_segment_limit(current_device.bar1_selector, 0x4000000 - 1);  // 64MB
+    // LFB goes to bar1_selector like DFB on NV cards
+    current_device.bar1_selector = PCI_MapBar(&bars[0], NULL);
+
+    if (!current_device.bar0_selector
+    || !current_device.bar1_selector)
+        return false;
 
     /* Read configuration registers */
-    uint32_t vendor_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_VENDOR_ID);
-    uint32_t device_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_DEVICE_ID);
-    uint32_t revision_id = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_REVISION);
+    uint32_t vendor_id = PCI_CurrentConfig()->decoded.vendor_id;
+    uint32_t device_id = PCI_CurrentConfig()->decoded.device_id;
+    uint32_t revision_id = PCI_CurrentConfig()->decoded.revision;
 
     Logging_Write(log_level_debug, "R128 - Vendor ID: 0x%04X\n", vendor_id);
     Logging_Write(log_level_debug, "R128 - Device ID: 0x%04X\n", device_id);
@@ -105,7 +101,7 @@ bool r128_init()
     current_device.straps = mmio_read32(R128_CONFIG_XSTRAP);
 
     /* Store original CONFIG_CNTL for shutdown */
-    r128_state.original_config_cntl = mmio_read32(R128_CONFIG_CNTL);
+    r128_get_state()->original_config_cntl = mmio_read32(R128_CONFIG_CNTL);
 
     /* Enable bus mastering if not already enabled */
     uint16_t command = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_COMMAND);
@@ -124,9 +120,9 @@ bool r128_init()
 void r128_shutdown()
 {
     // Restore original CONFIG_CNTL if needed
-    if (r128_state.original_config_cntl != 0)
+    if (r128_get_state()->original_config_cntl != 0)
     {
-        mmio_write32(R128_CONFIG_CNTL, r128_state.original_config_cntl);
+        mmio_write32(R128_CONFIG_CNTL, r128_get_state()->original_config_cntl);
     }
 
     Logging_Write(log_level_debug, "R128 Shutdown: Complete\n");
@@ -136,9 +132,9 @@ bool r128_dump_mfg_info()
 {
     Logging_Write(log_level_message, "Rage128 Manufacture-Time Configuration: \n");
     
-    uint32_t vendor_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_VENDOR_ID);
-    uint32_t device_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_DEVICE_ID);
-    uint32_t revision_id = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_REVISION);
+    uint32_t vendor_id = PCI_CurrentConfig()->decoded.vendor_id;
+    uint32_t device_id = PCI_CurrentConfig()->decoded.device_id;
+    uint32_t revision_id = PCI_CurrentConfig()->decoded.revision;
     
     Logging_Write(log_level_message, "Vendor ID          = 0x%04X\n", vendor_id);
     Logging_Write(log_level_message, "Device ID          = 0x%04X\n", device_id);
@@ -182,14 +178,8 @@ bool r128_dump_mmio()
         return false;
     }
     
-    // Read MMIO space (16KB)
-    for (uint32_t addr = 0; addr < R128_MMIO_SIZE; addr += 4)
-    {
-        if (addr % 0x1000 == 0)
-            Logging_Write(log_level_debug, "Dumping MMIO up to 0x%08X\n", addr);
-        
-        mmio_buffer[addr >> 2] = mmio_read32(addr);
-    }
+    // Read MMIO space (16KB) in one go
+    mmio_read_block(0, mmio_buffer, R128_MMIO_SIZE);
     
     fwrite(mmio_buffer, R128_MMIO_SIZE, 1, mmio_dump);
     fclose(mmio_dump);
@@ -20,6 +20,7 @@
 typedef struct voodoo3_state_s
 {
     uint32_t original_pci_command;     // Store original PCI command for shutdown
+    uint16_t io_base_port;             // Register I/O base from BAR2. 0 until init has run
 } voodoo3_state_t;
 
 //
@@ -28,6 +29,9 @@ typedef struct voodoo3_state_s
 
 bool voodoo3_init();
 void voodoo3_shutdown();
+bool voodoo3_sim_init();
+
+extern gpu_script_command_t voodoo3_commands[];         // waitio32
 
 /* Voodoo3 Tests */
 bool voodoo3_dump_mfg_info();
@@ -36,7 +40,3 @@ bool voodoo3_dump_mmio();
 // GPUS stuff
 bool voodoo3_gpus_section_applies(uint32_t fourcc);
 bool voodoo3_gpus_parse_section(uint32_t fourcc, FILE* stream);
-
-// Voodoo3 specific state
-extern voodoo3_state_t voodoo3_state;
-
@@ -17,144 +17,161 @@
 
 #include "gpuplay.h"
 #include "util/util.h"
-#include "pc.h"
 #include <stdio.h>
 #include <stdlib.h>
 
-voodoo3_state_t voodoo3_state = {0};                    // Voodoo3 specific state
+/* Voodoo3 specific state lives with the device, so two of the same card don't share it */
+static inline voodoo3_state_t* voodoo3_get_state()
+{
+    if (!current_device.arch_state)
+        current_device.arch_state = calloc(1, sizeof(voodoo3_state_t));
+
+    return current_device.arch_state;
+}
 
 // I/O port access functions for Voodoo3
 // Voodoo3 uses I/O ports accessed via BAR2 (PCI18)
-// The I/O base address is stored as a port number (not a memory address)
-static uint16_t voodoo3_io_base_port = 0;
-
+// The I/O base address is stored as a port number (not a memory address), in the per-device state
 static inline uint8_t voodoo3_io_read8(uint32_t offset)
 {
-    if (voodoo3_io_base_port == 0)
+    uint16_t io_base_port = voodoo3_get_state()->io_base_port;
+
+    if (io_base_port == 0)
         return 0;
     
     // Access I/O port at io_base_port + offset
-    return inportb(voodoo3_io_base_port + (uint16_t)offset);
+    return port_read8(io_base_port + (uint16_t)offset);
 }
 
 static inline uint16_t voodoo3_io_read16(uint32_t offset)
 {
-    if (voodoo3_io_base_port == 0)
+    uint16_t io_base_port = voodoo3_get_state()->io_base_port;
+
+    if (io_base_port == 0)
         return 0;
     
     // Access I/O port at io_base_port + offset
-    return inportw(voodoo3_io_base_port + (uint16_t)offset);
+    return port_read16(io_base_port + (uint16_t)offset);
 }
 
 static inline uint32_t voodoo3_io_read32(uint32_t offset)
 {
-    if (voodoo3_io_base_port == 0)
+    uint16_t io_base_port = voodoo3_get_state()->io_base_port;
+
+    if (io_base_port == 0)
         return 0;
     
-    // For 32-bit reads, read two 16-bit values
-    // Note: Voodoo3 registers are typically 32-bit aligned
-    uint16_t port = voodoo3_io_base_port + (uint16_t)offset;
-    uint32_t low = inportw(port);
-    uint32_t high = inportw(port + 2);
-    
-    return low | (high << 16);
+    // Voodoo3 registers are 32-bit, so read them in one bus cycle
+    return port_read32(io_base_port + (uint16_t)offset);
 }
 
 static inline void voodoo3_io_write8(uint32_t offset, uint8_t value)
 {
-    if (voodoo3_io_base_port == 0)
+    uint16_t io_base_port = voodoo3_get_state()->io_base_port;
+
+    if (io_base_port == 0)
         return;
     
-    outportb(voodoo3_io_base_port + (uint16_t)offset, value);
+    port_write8(io_base_port + (uint16_t)offset, value);
 }
 
 static inline void voodoo3_io_write16(uint32_t offset, uint16_t value)
 {
-    if (voodoo3_io_base_port == 0)
+    uint16_t io_base_port = voodoo3_get_state()->io_base_port;
+
+    if (io_base_port == 0)
         return;
     
-    outportw(voodoo3_io_base_port + (uint16_t)offset, value);
+    port_write16(io_base_port + (uint16_t)offset, value);
 }
 
 static inline void voodoo3_io_write32(uint32_t offset, uint32_t value)
 {
-    if (voodoo3_io_base_port == 0)
+    uint16_t io_base_port = voodoo3_get_state()->io_base_port;
+
+    if (io_base_port == 0)
         return;
     
-    // For 32-bit writes, write two 16-bit values
-    // Note: Voodoo3 registers are typically 32-bit aligned
-    uint16_t port = voodoo3_io_base_port + (uint16_t)offset;
-    outportw(port, (uint16_t)(value & 0xFFFF));
-    outportw(port + 2, (uint16_t)((value >> 16) & 0xFFFF));
+    // One 32-bit cycle. Splitting it would let registers that latch on write see half a value
+    port_write32(io_base_port + (uint16_t)offset, value);
+}
+
+// waitio32 <offset> <mask> <value> <timeout in us>: wait32 for the I/O register space, offset from the I/O BAR
+static bool voodoo3_command_wait_io32(gpu_script_args_t* args)
+{
+    // there's no I/O BAR under -sim, so the offset goes straight into the simulated port space
+    if (command_line.simulate)
+        return Script_Wait32(args, gpu_poll_space_port, 0);
+
+    // registered once for every Voodoo3, but the script may be talking to some other card now
+    if (current_device.device_info.init_function != voodoo3_init
+    || voodoo3_get_state()->io_base_port == 0)
+    {
+        Logging_Write(log_level_error, "%s: the current device isn't an initialized Voodoo3\n", args->argv[0]);
+        return false;
+    }
+
+    return Script_Wait32(args, gpu_poll_space_port, voodoo3_get_state()->io_base_port);
 }
 
+// Registered by GPUPlay_InitDevice through the device list, so they're there under -sim too
+gpu_script_command_t voodoo3_commands[] =
+{
+    { "waitio32", "waitvoodoo3io32", voodoo3_command_wait_io32, 4 },
+
+    { NULL, NULL, NULL},            // Sentinel value for end of list.
+};
+
 bool voodoo3_init()
 {
-    // Read PCI BARs
+    // Size the PCI BARs
     // Voodoo3 layout:
-    // BAR0 = Frame Buffer - 32MB non-prefetchable memory
-    // BAR1 = Texture Memory - 32MB prefetchable memory
+    // BAR0 = Frame Buffer - non-prefetchable memory, 32MB on the boards we've seen
+    // BAR1 = Texture Memory - prefetchable memory, 32MB on the boards we've seen
     // BAR2 = I/O ports (256 bytes) - Register access via PCI18 (ioBaseAddr)
-    uint32_t bar0_base = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR0);
-    uint32_t bar1_base = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR1);
-    uint32_t bar2_base = PCI_ReadConfig32(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_BAR2);
+    pci_bar_t* bars = current_device.bars;
+    PCI_ProbeBars(current_device.bus_number, current_device.function_number, bars);
 
-    /* According to PCI spec, only the top bits matter for base addresses */
-    bar0_base &= 0xFFFFFFF0;  // 32-bit memory space, 4-byte aligned
-    bar1_base &= 0xFFFFFFF0;  // 32-bit memory space, 4-byte aligned
-    
-    // BAR2 for I/O space: bits 0-1 indicate it's I/O space (bit 0 = 1)
-    // The actual I/O port address is in bits 2-31
-    // For I/O space, we need to extract the port number
-    if (bar2_base & 0x01)
+    if (bars[2].size
+    && bars[2].io)
     {
-        // This is I/O space - extract the port address
-        voodoo3_io_base_port = (uint16_t)(bar2_base & 0xFFFC);  // I/O port address (aligned to 4 bytes)
-        Logging_Write(log_level_debug, "Voodoo3 - PCI BAR2 (I/O Ports) 0x%04X\n", voodoo3_io_base_port);
+        voodoo3_get_state()->io_base_port = (uint16_t)bars[2].base;
+        Logging_Write(log_level_debug, "Voodoo3 - PCI BAR2 (I/O Ports) 0x%04X, %lu ports\n", voodoo3_get_state()->io_base_port, bars[2].size);
     }
     else
     {
-        Logging_Write(log_level_error, "Voodoo3 - BAR2 is not I/O space! (0x%08lX)\n", bar2_base);
+        Logging_Write(log_level_error, "Voodoo3 - BAR2 is not I/O space! (0x%08lX)\n", PCI_CurrentConfig()->decoded.bars[2]);
         return false;
     }
 
-    Logging_Write(log_level_debug, "Voodoo3 - PCI BAR0 (Frame Buffer) 0x%08lX\n", bar0_base);
-    Logging_Write(log_level_debug, "Voodoo3 - PCI BAR1 (Texture Memory) 0x%08lX\n", bar1_base);
-    
-    /* We need to allocate an LDT for memory BARs */
-    /* So start by allocating a physical mapping. */
+    if (!bars[0].size
+    || bars[0].io)
+    {
+        Logging_Write(log_level_error, "Voodoo3 - BAR0 is not a memory BAR! (0x%08lX)\n", PCI_CurrentConfig()->decoded.bars[0]);
+        return false;
+    }
 
-    __dpmi_meminfo meminfo_bar0 = {0};
-    __dpmi_meminfo meminfo_bar1 = {0};
+    Logging_Write(log_level_debug, "Voodoo3 - PCI BAR0 (Frame Buffer) 0x%08lX, %lu KB\n", bars[0].base, bars[0].size >> 10);
+    Logging_Write(log_level_debug, "Voodoo3 - PCI BAR1 (Texture Memory) 0x%08lX, %lu KB\n", bars[1].base, bars[1].size >> 10);
 
-    // BAR0 is the Frame Buffer (32MB)
-    meminfo_bar0.address = bar0_base;
-    meminfo_bar0.size = 0x2000000;  // 32MB
+    current_device.bar1_dfb_start = bars[0].base;  // Frame buffer is like BAR1 on NV cards
+    current_device.ramin_start = bars[1].base;     // Texture memory. Nothing goes through it, so it isn't mapped
     
-    // BAR1 is the Texture Memory (32MB)
-    meminfo_bar1.address = bar1_base;
-    meminfo_bar1.size = 0x2000000;  // 32MB
+    Logging_Write(log_level_debug, "Voodoo3 Init: Mapping BAR0 (Frame Buffer) to bar1_selector...\n");
 
-    current_device.bar1_dfb_start = bar0_base;  // Frame buffer is like BAR1 on NV cards
-    current_device.ramin_start = bar1_base;     // Texture memory
-
-    __dpmi_physical_address_mapping(&meminfo_bar0);
-    __dpmi_physical_address_mapping(&meminfo_bar1);
-    
-    Logging_Write(log_level_debug, "Voodoo3 Init: Mapping BAR0 (Frame Buffer - 32MB) to bar1_selector...\n");
+    /* Map the frame buffer at the size it actually decodes, with a selector limit to match */
+    current_device.bar1_selector = PCI_MapBar(&bars[0], NULL);
 
-    /* Set up LDT for BAR0 (Frame Buffer) */
-    current_device.bar1_selector = __dpmi_allocate_ldt_descriptors(1);
-    __dpmi_set_segment_base_address(current_device.bar1_selector, meminfo_bar0.address);
-    __dpmi_set_segment_limit(current_device.bar1_selector, 0x2000000 - 1);  // 32MB
+    if (!current_device.bar1_selector)
+        return false;
 
     // Note: BAR2 is I/O ports, not memory-mapped, so we don't set up bar0_selector for it
-    // I/O access is done directly via inport/outport functions
+    // I/O access goes through port_read*/port_write*, so it works on the simulated backend too
 
     /* Read configuration registers */
-    uint32_t vendor_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_VENDOR_ID);
-    uint32_t device_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_DEVICE_ID);
-    uint32_t revision_id = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_REVISION);
+    uint32_t vendor_id = PCI_CurrentConfig()->decoded.vendor_id;
+    uint32_t device_id = PCI_CurrentConfig()->decoded.device_id;
+    uint32_t revision_id = PCI_CurrentConfig()->decoded.revision;
 
     Logging_Write(log_level_debug, "Voodoo3 - Vendor ID: 0x%04X\n", vendor_id);
     Logging_Write(log_level_debug, "Voodoo3 - Device ID: 0x%04X\n", device_id);
@@ -186,7 +203,7 @@ bool voodoo3_init()
 
     /* Store original PCI command for shutdown */
     uint16_t command = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_COMMAND);
-    voodoo3_state.original_pci_command = command;
+    voodoo3_get_state()->original_pci_command = command;
 
     /* Enable bus mastering if not already enabled */
     if (!(command & PCI_CFG_OFFSET_COMMAND_BUS_MASTER))
@@ -220,21 +237,33 @@ bool voodoo3_init()
 void voodoo3_shutdown()
 {
     // Restore original PCI command if needed
-    if (voodoo3_state.original_pci_command != 0)
+    if (voodoo3_get_state()->original_pci_command != 0)
     {
-        PCI_WriteConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_COMMAND, voodoo3_state.original_pci_command);
+        PCI_WriteConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_COMMAND, voodoo3_get_state()->original_pci_command);
     }
 
     Logging_Write(log_level_debug, "Voodoo3 Shutdown: Complete\n");
 }
 
+// Always idle: nothing queued and nothing running
+static uint32_t voodoo3_sim_read_status(uint32_t offset, uint32_t value)
+{
+    return VOODOO3_STATUS_CMD_FIFO_EMPTY;
+}
+
+/* Under -sim, the I/O registers sit at the bottom of the port space (waitio32 uses an I/O base of 0 there) */
+bool voodoo3_sim_init()
+{
+    return GPUSim_AddHook(gpu_sim_space_port, VOODOO3_IO_STATUS, voodoo3_sim_read_status, NULL);
+}
+
 bool voodoo3_dump_mfg_info()
 {
     Logging_Write(log_level_message, "3Dfx Voodoo3 Manufacture-Time Configuration: \n");
     
-    uint32_t vendor_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_VENDOR_ID);
-    uint32_t device_id = PCI_ReadConfig16(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_DEVICE_ID);
-    uint32_t revision_id = PCI_ReadConfig8(current_device.bus_number, current_device.function_number, PCI_CFG_OFFSET_REVISION);
+    uint32_t vendor_id = PCI_CurrentConfig()->decoded.vendor_id;
+    uint32_t device_id = PCI_CurrentConfig()->decoded.device_id;
+    uint32_t revision_id = PCI_CurrentConfig()->decoded.revision;
     
     Logging_Write(log_level_message, "Vendor ID          = 0x%04X\n", vendor_id);
     Logging_Write(log_level_message, "Device ID          = 0x%04X\n", device_id);
@@ -264,7 +293,7 @@ bool voodoo3_dump_mmio()
 {
     Logging_Write(log_level_message, "Dumping Voodoo3 I/O register space...\n");
     
-    if (voodoo3_io_base_port == 0)
+    if (voodoo3_get_state()->io_base_port == 0)
     {
         Logging_Write(log_level_error, "Voodoo3 I/O base port not initialized!\n");
         return false;
@@ -277,7 +306,7 @@ bool voodoo3_dump_mmio()
         return false;
     }
     
-    uint32_t* io_buffer = calloc(1, 0x1000);
+    uint32_t* io_buffer = calloc(1, VOODOO3_IO_SIZE);
     if (!io_buffer)
     {
         Logging_Write(log_level_error, "Failed to allocate memory for I/O dump\n");
@@ -285,23 +314,15 @@ bool voodoo3_dump_mmio()
         return false;
     }
     
-    // Read I/O space (256 bytes = 0x100, but we'll dump 1KB for safety)
-    // Voodoo3 I/O space is 256 bytes, but we'll read up to 1KB
-    for (uint32_t offset = 0; offset < 0x1000; offset += 4)
-    {
-        if (offset % 0x100 == 0)
-            Logging_Write(log_level_debug, "Dumping I/O ports at offset 0x%04X (port 0x%04X)\n", offset, voodoo3_io_base_port + offset);
-        
-        // Read 32-bit value from I/O port
-        io_buffer[offset >> 2] = voodoo3_io_read32(offset);
-    }
+    // The whole I/O space is 256 bytes, so grab it in one burst
+    port_read_range32(voodoo3_get_state()->io_base_port, io_buffer, VOODOO3_IO_SIZE);
     
-    fwrite(io_buffer, 0x1000, 1, io_dump);
+    fwrite(io_buffer, VOODOO3_IO_SIZE, 1, io_dump);
     fclose(io_dump);
     free(io_buffer);
     
     Logging_Write(log_level_message, "I/O dump complete: voodoo3_io_dump.bin (dumped %d bytes from I/O ports 0x%04X-0x%04X)\n", 
-                  0x1000, voodoo3_io_base_port, voodoo3_io_base_port + 0x1000 - 1);
+                  VOODOO3_IO_SIZE, voodoo3_get_state()->io_base_port, voodoo3_get_state()->io_base_port + VOODOO3_IO_SIZE - 1);
     
     return true;
 }
@@ -43,6 +43,8 @@
 // VGA registers are accessed at ioBaseAddr + (VGA_ADDR - 0x0300)
 // For example: VGA Misc Output (0x03C2) = ioBaseAddr + 0x00C2
 
+#define VOODOO3_IO_SIZE                                   0x0100          // Size of the I/O register space
+
 // Status and Control Registers
 #define VOODOO3_IO_STATUS                                 0x0000          // Status register (read-only)
 #define VOODOO3_IO_INTRCTRL                               0x0008          // Interrupt control
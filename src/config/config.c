@@ -20,14 +20,27 @@
 nv_config_t config = {0}; 
 
 // Functions
-bool Config_Load()
+
+/* Read gpuplay.ini. Done early, since some settings (e.g. the PCI config mechanism) are needed before the GPU is detected */
+bool Config_Init()
 {
+    if (config.ini_file)
+        return true; 
+
     config.ini_file = ini_read(INI_FILE_NAME);
 
     if (!config.ini_file)
         return false; 
 
     Logging_Write(log_level_message, "Loaded gpuplay.ini\n");
+    return true; 
+}
+
+/* Build the list of tests to run for the detected GPU */
+bool Config_Load()
+{
+    if (!Config_Init())
+        return false; 
 
     ini_section_t section_tests = ini_find_section(config.ini_file, "Tests");
 
@@ -132,4 +145,21 @@ bool Config_Load()
     
     config.loaded = true; 
     return true; 
-};
\ No newline at end of file
+};
+
+/* Throw the test list away, so Config_Load can build it again for another GPU */
+void Config_UnloadTests()
+{
+    nv_config_test_entry_t* test_entry = config.test_list_head;
+
+    while (test_entry)
+    {
+        nv_config_test_entry_t* next = test_entry->next;
+        free(test_entry);
+        test_entry = next;
+    }
+
+    config.test_list_head = config.test_list_tail = NULL;
+    config.num_tests_enabled = 0;
+    config.loaded = false;
+}
\ No newline at end of file
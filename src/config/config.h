@@ -44,4 +44,6 @@ typedef struct nv_config_s
 
 extern nv_config_t config; 
 
-bool Config_Load();
\ No newline at end of file
+bool Config_Init();
+bool Config_Load();
+void Config_UnloadTests();
\ No newline at end of file
@@ -1,4 +1,4 @@
-/* 
+/*
     GPUPlay
     Copyright © 2025 frostbite3000
 
@@ -10,34 +10,80 @@
 
 #include <gpuplay.h>
 
-// The selected device after detection is done. 
-nv_device_t current_device = {0}; 
+// Every supported device found, and the one that is selected. Device 0 is active until something else is selected
+nv_device_t gpu_devices[GPU_MAX_DEVICES] = {0};
+uint32_t gpu_num_devices = 0;
+nv_device_t* gpu_active_device = &gpu_devices[0];
 
+/* Fill gpu_devices with every supported GPU in the PCI device table */
 bool GPU_Detect()
 {
-    nv_device_info_t current_device_info = supported_devices[0]; 
-    int32_t i = 0; 
+    if (!PCI_Enumerate())
+        return false;
 
-    // iterate through all the known device info sets
-    while (current_device_info.vendor_id != 0x00)
+    gpu_num_devices = 0;
+
+    // go in bus order so the result doesn't depend on the order of supported_devices
+    for (uint32_t entry_id = 0; entry_id < pci_devices.count; entry_id++)
     {
-        current_device_info = supported_devices[i];
-        
-        Logging_Write(log_level_debug, "Trying to find GPU: %s\n", current_device_info.name);
+        pci_device_entry_t* entry = &pci_devices.entries[entry_id];
 
-        if (PCI_DevicePresent(current_device_info.device_id, current_device_info.vendor_id))
+        for (uint32_t i = 0; supported_devices[i].vendor_id; i++)
         {
-            Logging_Write(log_level_message, "Detected GPU: %s\n", current_device_info.name);
+            nv_device_info_t* device_info = &supported_devices[i];
+
+            if (device_info->vendor_id != entry->vendor_id
+            || device_info->device_id != entry->device_id)
+                continue;
+
+            if (gpu_num_devices >= GPU_MAX_DEVICES)
+            {
+                Logging_Write(log_level_warning, "More than %d supported GPUs, ignoring %s at PCI %02x:%02x.%x\n",
+                    GPU_MAX_DEVICES, device_info->name, entry->bus_number, entry->function_number >> 3, entry->function_number & 7);
+                break;
+            }
+
+            Logging_Write(log_level_message, "Detected GPU %lu: %s (PCI %02x:%02x.%x)\n",
+                gpu_num_devices, device_info->name, entry->bus_number, entry->function_number >> 3, entry->function_number & 7);
 
-            // set up current info
-            current_device.device_info = current_device_info;
-            return true; 
+            nv_device_t* device = &gpu_devices[gpu_num_devices];
+
+            device->device_info = *device_info;
+            device->bus_number = entry->bus_number;
+            device->function_number = entry->function_number;
+            device->index = gpu_num_devices++;
+
+            // everything after this reads the header from here instead of the bus
+            PCI_SnapshotCapture(&device->pci_config, device->bus_number, device->function_number);
+            break;
         }
+    }
 
-        i++;
+    if (!gpu_num_devices)
+    {
+        Logging_Write(log_level_error, "No supported Other GPU found\n");
+        return false;
     }
 
-    Logging_Write(log_level_error, "No supported Other GPU found\n");
-    return false; 
+    return true;
+}
+
+/* Make another device the one every accessor talks to */
+bool GPU_SelectDevice(uint32_t index)
+{
+    if (index >= gpu_num_devices)
+    {
+        Logging_Write(log_level_error, "There is no GPU %lu (%lu detected)\n", index, gpu_num_devices);
+        return false;
+    }
+
+    if (gpu_active_device == &gpu_devices[index])
+        return true;
+
+    // queued writes belong to the device that's active now
+    GPU_FlushWrites();
 
+    gpu_active_device = &gpu_devices[index];
+    Logging_Write(log_level_debug, "Selected GPU %lu: %s\n", index, current_device.device_info.name);
+    return true;
 }
@@ -6,17 +6,197 @@
     Licensed under the MIT license (see license file)
 
     gpu_io.c: Implements I/O functions that are shared across all pieces of graphics hardware.
+    The actual accesses are done by the selected backend (gpu_io_hw.c or gpu_io_sim.c); this layer does the write queue and tracing.
 */
 
 #include <gpuplay.h>
-#include <architecture/r128/r128.h>
-#include "architecture/r128/r128_ref.h"
-#include "pc.h"
-#include "sys/farptr.h"
 #include "util/util.h"
+#include <core/timing/gpu_timing.h>
+#include <core/trace/gpu_trace.h>
 #include <stdint.h>
 #include <time.h>
 
+// The backend every access goes through. Hardware unless -sim was passed (or there's no hardware backend)
+gpu_io_backend_t* gpu_io_backend = &GPU_IO_BACKEND_DEFAULT;
+
+//
+// Write queue state
+// When enabled, 32-bit MMIO and DFB writes are buffered here and drained in bursts by GPU_FlushWrites.
+// Anything that could observe the hardware (reads, narrower writes, block transfers) drains the queue first so ordering is kept.
+//
+
+#define GPU_WRITE_QUEUE_SIZE        256
+
+typedef enum gpu_write_target_e
+{
+    gpu_write_target_mmio = 0,
+    gpu_write_target_dfb = 1,
+} gpu_write_target; 
+
+typedef struct gpu_write_queue_entry_s
+{
+    uint32_t target;                // gpu_write_target
+    uint32_t offset;
+    uint32_t value;
+} gpu_write_queue_entry_t;
+
+static gpu_write_queue_entry_t gpu_write_queue[GPU_WRITE_QUEUE_SIZE];
+static uint32_t gpu_write_queue_count = 0;
+static bool gpu_write_queue_enabled = false; 
+
+//
+// Shadow register cache
+// Remembers the last value written to (or read from) each MMIO register and I/O port, per device.
+// Registers marked non-readable are answered from here once we know their value, which is what makes the rmw helpers cheap.
+// Nothing is recorded (and nothing is allocated) until GPU_ShadowMark or GPU_ShadowGet is first used, so plain register writes don't pay for it.
+//
+
+static inline gpu_shadow_t* gpu_shadow_get()
+{
+    if (!current_device.shadow)
+        current_device.shadow = calloc(1, sizeof(gpu_shadow_t));
+
+    return current_device.shadow;
+}
+
+/* Shadow storage for a space, allocated the first time anything is recorded in it */
+static inline bool gpu_shadow_space_init(gpu_shadow_t* shadow, gpu_shadow_space space)
+{
+    if (shadow->values[space])
+        return true;
+
+    shadow->values[space] = calloc(GPU_SHADOW_SPACE_SIZE >> 2, sizeof(uint32_t));
+    shadow->flags[space] = calloc(GPU_SHADOW_SPACE_SIZE >> 2, sizeof(uint8_t));
+
+    return (shadow->values[space] && shadow->flags[space]);
+}
+
+static inline void gpu_shadow_record(gpu_shadow_space space, uint32_t offset, uint32_t val)
+{
+    gpu_shadow_t* shadow = current_device.shadow;
+
+    if (!shadow
+    || offset >= GPU_SHADOW_SPACE_SIZE
+    || !gpu_shadow_space_init(shadow, space))
+        return;
+
+    shadow->values[space][offset >> 2] = val;
+    shadow->flags[space][offset >> 2] |= GPU_SHADOW_FLAG_VALID;
+}
+
+/* Byte writes only land in the shadow if we already know the rest of the dword */
+static inline void gpu_shadow_record8(gpu_shadow_space space, uint32_t offset, uint8_t val)
+{
+    gpu_shadow_t* shadow = current_device.shadow;
+
+    if (offset >= GPU_SHADOW_SPACE_SIZE
+    || !shadow
+    || !shadow->values[space]
+    || !(shadow->flags[space][offset >> 2] & GPU_SHADOW_FLAG_VALID))
+        return;
+
+    uint32_t shift = (offset & 3) * 8;
+    uint32_t* entry = &shadow->values[space][offset >> 2];
+    *entry = (*entry & ~(0xFFu << shift)) | ((uint32_t)val << shift);
+}
+
+/* Returns true (and the shadowed value) if the register must not be read from the bus and we know what's in it */
+static inline bool gpu_shadow_lookup(gpu_shadow_space space, uint32_t offset, uint32_t* val)
+{
+    gpu_shadow_t* shadow = current_device.shadow;
+
+    if (offset >= GPU_SHADOW_SPACE_SIZE
+    || !shadow
+    || !shadow->flags[space]
+    || !(shadow->flags[space][offset >> 2] & GPU_SHADOW_FLAG_NO_READ))
+        return false;
+
+    // written before the shadow existed (or never): a bus read is the only way to find out, and it makes the entry valid
+    if (!(shadow->flags[space][offset >> 2] & GPU_SHADOW_FLAG_VALID))
+    {
+        Logging_Write(log_level_warning, "Shadowed register %08lx hasn't been written since it was shadowed, reading it from the bus\n", offset);
+        return false;
+    }
+
+    *val = shadow->values[space][offset >> 2];
+    return true;
+}
+
+static void gpu_shadow_record_fill(gpu_shadow_space space, uint32_t offset, const uint32_t* buffer, uint32_t val, uint32_t size)
+{
+    if (!current_device.shadow)
+        return;
+
+    for (uint32_t i = 0; i < (size >> 2); i++)
+        gpu_shadow_record(space, offset + (i << 2), (buffer) ? buffer[i] : val);
+}
+
+/* Mark size bytes of registers as non-readable (answered from the shadow) or readable again */
+void GPU_ShadowMark(gpu_shadow_space space, uint32_t offset, uint32_t size, bool no_read)
+{
+    gpu_shadow_t* shadow = gpu_shadow_get();
+
+    if (!shadow
+    || !gpu_shadow_space_init(shadow, space))
+    {
+        Logging_Write(log_level_error, "Failed to allocate the shadow register cache\n");
+        return;
+    }
+
+    for (uint32_t reg = offset & ~3; reg < offset + size && reg < GPU_SHADOW_SPACE_SIZE; reg += 4)
+    {
+        if (no_read)
+            shadow->flags[space][reg >> 2] |= GPU_SHADOW_FLAG_NO_READ;
+        else
+            shadow->flags[space][reg >> 2] &= ~GPU_SHADOW_FLAG_NO_READ;
+    }
+}
+
+/* Last known value of a register. Returns false if nothing has been written to it (or read from it) since the cache was first used */
+bool GPU_ShadowGet(gpu_shadow_space space, uint32_t offset, uint32_t* val)
+{
+    // the first call turns recording on, so it can only know about accesses from then on
+    gpu_shadow_t* shadow = gpu_shadow_get();
+
+    if (!shadow
+    || !gpu_shadow_space_init(shadow, space))
+    {
+        Logging_Write(log_level_error, "Failed to allocate the shadow register cache\n");
+        return false;
+    }
+
+    if (offset >= GPU_SHADOW_SPACE_SIZE
+    || !(shadow->flags[space][offset >> 2] & GPU_SHADOW_FLAG_VALID))
+        return false;
+
+    *val = shadow->values[space][offset >> 2];
+    return true;
+}
+
+void GPU_ShadowReset()
+{
+    gpu_shadow_t* shadow = current_device.shadow;
+
+    if (!shadow)
+        return;
+
+    for (uint32_t space = 0; space < gpu_shadow_space_count; space++)
+    {
+        free(shadow->values[space]);
+        free(shadow->flags[space]);
+    }
+
+    free(shadow);
+    current_device.shadow = NULL;
+}
+
+/* Drain any queued writes before touching the hardware directly */
+static inline void gpu_io_drain_pending()
+{
+    if (gpu_write_queue_count)
+        GPU_FlushWrites();
+}
+
 //
 // MMIO Functinos
 //
@@ -24,23 +204,67 @@
 /* Read 8-bit value from the MMIO */
 uint8_t mmio_read8(uint32_t offset)
 {
-    return _farpeekb(current_device.bar0_selector, offset);
+    gpu_io_drain_pending();
+
+    uint8_t val = gpu_io_backend->mmio_read8(offset);
+
+    GPU_TRACE(trace_op_mmio_read, 1, offset, val);
+    return val;
 }
 
-/* Read 32-bit value from the MMIO */
+/* Read 32-bit value from the MMIO. Non-readable registers come from the shadow without touching the bus */
 uint32_t mmio_read32(uint32_t offset)
 {
-    return _farpeekl(current_device.bar0_selector, offset);
+    uint32_t val;
+
+    if (gpu_shadow_lookup(gpu_shadow_space_mmio, offset, &val))
+        return val;
+
+    gpu_io_drain_pending();
+
+    val = gpu_io_backend->mmio_read32(offset);
+
+    if (current_device.shadow)
+        gpu_shadow_record(gpu_shadow_space_mmio, offset, val);
+
+    GPU_TRACE(trace_op_mmio_read, 4, offset, val);
+    return val;
 }
 
 void mmio_write8(uint32_t offset, uint8_t val)
 {
-    _farpokeb(current_device.bar0_selector, offset, val);
+    gpu_io_drain_pending();
+
+    gpu_shadow_record8(gpu_shadow_space_mmio, offset, val);
+
+    GPU_TRACE(trace_op_mmio_write, 1, offset, val);
+    gpu_io_backend->mmio_write8(offset, val);
+}
+
+static inline void mmio_write32_direct(uint32_t offset, uint32_t val)
+{
+    GPU_TRACE(trace_op_mmio_write, 4, offset, val);
+    gpu_io_backend->mmio_write32(offset, val);
 }
 
 void mmio_write32(uint32_t offset, uint32_t val)
 {
-    _farpokel(current_device.bar0_selector, offset, val);
+    // the shadow holds the value as soon as it's written, even if it's still sitting in the queue
+    gpu_shadow_record(gpu_shadow_space_mmio, offset, val);
+
+    if (gpu_write_queue_enabled)
+    {
+        if (gpu_write_queue_count == GPU_WRITE_QUEUE_SIZE)
+            GPU_FlushWrites();
+
+        gpu_write_queue_entry_t* entry = &gpu_write_queue[gpu_write_queue_count++];
+        entry->target = gpu_write_target_mmio;
+        entry->offset = offset;
+        entry->value = val;
+        return;
+    }
+
+    mmio_write32_direct(offset, val);
 }
 
 //
@@ -50,129 +274,459 @@ void mmio_write32(uint32_t offset, uint32_t val)
 /* Read 8-bit value from the DFB */
 uint8_t nv_dfb_read8(uint32_t offset)
 {
-    return _farpeekb(current_device.bar1_selector, offset);
+    gpu_io_drain_pending();
+
+    uint8_t val = gpu_io_backend->dfb_read8(offset);
+
+    GPU_TRACE(trace_op_dfb_read, 1, offset, val);
+    return val;
 }
 
 /* Read 16-bit value from the DFB */
 uint16_t nv_dfb_read16(uint32_t offset)
 {
-    return _farpeekw(current_device.bar1_selector, offset);
+    gpu_io_drain_pending();
+
+    uint16_t val = gpu_io_backend->dfb_read16(offset);
+
+    GPU_TRACE(trace_op_dfb_read, 2, offset, val);
+    return val;
 }
 
 /* Read 32-bit value from the DFB */
 uint32_t nv_dfb_read32(uint32_t offset)
 {
-    return _farpeekl(current_device.bar1_selector, offset);
+    gpu_io_drain_pending();
+
+    uint32_t val = gpu_io_backend->dfb_read32(offset);
+
+    GPU_TRACE(trace_op_dfb_read, 4, offset, val);
+    return val;
 }
 
 /* Write 8-bit value to the DFB */
 void nv_dfb_write8(uint32_t offset, uint8_t val)
 {
-    _farpokeb(current_device.bar1_selector, offset, val);
+    gpu_io_drain_pending();
+
+    GPU_TRACE(trace_op_dfb_write, 1, offset, val);
+    gpu_io_backend->dfb_write8(offset, val);
 }
 
 /* Write 16-bit value to the DFB */
 void nv_dfb_write16(uint32_t offset, uint16_t val)
 {
-    _farpokew(current_device.bar1_selector, offset, val);
+    gpu_io_drain_pending();
+
+    GPU_TRACE(trace_op_dfb_write, 2, offset, val);
+    gpu_io_backend->dfb_write16(offset, val);
+}
+
+static inline void nv_dfb_write32_direct(uint32_t offset, uint32_t val)
+{
+    GPU_TRACE(trace_op_dfb_write, 4, offset, val);
+    gpu_io_backend->dfb_write32(offset, val);
 }
 
+/* Write 32-bit value to the DFB */
 void nv_dfb_write32(uint32_t offset, uint32_t val)
 {
-    _farpokel(current_device.bar1_selector, offset, val);
+    if (gpu_write_queue_enabled)
+    {
+        if (gpu_write_queue_count == GPU_WRITE_QUEUE_SIZE)
+            GPU_FlushWrites();
+
+        gpu_write_queue_entry_t* entry = &gpu_write_queue[gpu_write_queue_count++];
+        entry->target = gpu_write_target_dfb;
+        entry->offset = offset;
+        entry->value = val;
+        return;
+    }
+
+    nv_dfb_write32_direct(offset, val);
+}
+
+//
+// Write queue
+//
+
+static inline void gpu_io_drain_entry(const gpu_write_queue_entry_t* entry)
+{
+    if (entry->target == gpu_write_target_mmio)
+        mmio_write32_direct(entry->offset, entry->value);
+    else
+        nv_dfb_write32_direct(entry->offset, entry->value);
 }
 
+/* Send every queued write to the hardware, in order */
+void GPU_FlushWrites()
+{
+    gpu_write_queue_entry_t* entry = gpu_write_queue;
+    uint32_t count = gpu_write_queue_count;
+
+    // clear the count first so nothing we call can re-enter the drain
+    gpu_write_queue_count = 0;
+
+    // unrolled by four; the queue is usually full when this runs
+    while (count >= 4)
+    {
+        gpu_io_drain_entry(&entry[0]);
+        gpu_io_drain_entry(&entry[1]);
+        gpu_io_drain_entry(&entry[2]);
+        gpu_io_drain_entry(&entry[3]);
+        entry += 4;
+        count -= 4;
+    }
+
+    while (count--)
+        gpu_io_drain_entry(entry++);
+}
+
+/* Read-modify-write: only the bits in mask are replaced with val. The read comes from the shadow if the register is non-readable */
+uint32_t mmio_rmw32(uint32_t offset, uint32_t mask, uint32_t val)
+{
+    uint32_t new_val = (mmio_read32(offset) & ~mask) | (val & mask);
+
+    mmio_write32(offset, new_val);
+    return new_val;
+}
+
+uint32_t port_rmw32(uint16_t port, uint32_t mask, uint32_t val)
+{
+    uint32_t new_val = (port_read32(port) & ~mask) | (val & mask);
+
+    port_write32(port, new_val);
+    return new_val;
+}
+
+/* Drain the queue and read back from the card so posted writes have actually landed */
+void GPU_WriteBarrier()
+{
+    GPU_FlushWrites();
+
+    // a read from the device can't pass the writes before it
+    nv_dfb_read32(0);
+}
+
+static uint32_t gpu_poll_port_read32(uint32_t port)
+{
+    return gpu_io_backend->port_read32(port);
+}
+
+/*
+    Read a register until (value & mask) == match or timeout_cycles have gone by. Always reads at least once.
+    Straight to the backend: a shadowed register would never change, and tracing every read would flood the trace and slow the loop down
+*/
+bool GPU_Poll32(gpu_poll_space space, uint32_t offset, uint32_t mask, uint32_t match, uint64_t timeout_cycles, gpu_poll_result_t* result)
+{
+    uint32_t (*read32)(uint32_t offset) = gpu_io_backend->mmio_read32;
+
+    if (space == gpu_poll_space_dfb)
+        read32 = gpu_io_backend->dfb_read32;
+    else if (space == gpu_poll_space_port)
+        read32 = gpu_poll_port_read32;
+
+    // whatever we're waiting on was probably started by a queued write
+    GPU_FlushWrites();
+
+    uint32_t val, iterations = 0;
+    uint64_t start = Timing_ReadTSC(), elapsed;
+    bool matched;
+
+    do
+    {
+        val = read32(offset);
+        iterations++;
+        matched = ((val & mask) == match);
+        elapsed = Timing_ReadTSC() - start;
+    } while (!matched
+        && elapsed < timeout_cycles);
+
+    // just the last read
+    GPU_TRACE((space == gpu_poll_space_dfb) ? trace_op_dfb_read : (space == gpu_poll_space_port) ? trace_op_port_read : trace_op_mmio_read, 4, offset, val);
+
+    result->matched = matched;
+    result->value = val;
+    result->iterations = iterations;
+    result->cycles = elapsed;
+    return matched;
+}
+
+void GPU_EnableWriteQueue(bool enabled)
+{
+    static bool registered_atexit = false; 
+
+    if (!enabled)
+        GPU_FlushWrites();
+
+    gpu_write_queue_enabled = enabled; 
+
+    // make sure nothing is left behind on an exit() path
+    if (enabled
+    && !registered_atexit)
+    {
+        atexit(GPU_FlushWrites);
+        registered_atexit = true; 
+    }
+}
+
+//
+// Block transfer functions
+// Sizes are in bytes. The hardware backend moves these with movedata (rep movsl) or rep stosl instead of one far call per dword.
+//
+
+/* Read size bytes of MMIO starting at offset into buffer */
+void mmio_read_block(uint32_t offset, void* buffer, uint32_t size)
+{
+    gpu_io_drain_pending();
+
+    GPU_TRACE(trace_op_mmio_read, TRACE_WIDTH_BLOCK, offset, size);
+    gpu_io_backend->mmio_read_block(offset, buffer, size);
+}
+
+/* Write size bytes from buffer into the MMIO starting at offset */
+void mmio_write_block(uint32_t offset, const void* buffer, uint32_t size)
+{
+    gpu_io_drain_pending();
+
+    gpu_shadow_record_fill(gpu_shadow_space_mmio, offset, buffer, 0, size);
+
+    GPU_TRACE(trace_op_mmio_write, TRACE_WIDTH_BLOCK, offset, size);
+    gpu_io_backend->mmio_write_block(offset, buffer, size);
+}
+
+/* Write val to every dword in the size bytes of MMIO starting at offset */
+void mmio_fill32(uint32_t offset, uint32_t val, uint32_t size)
+{
+    gpu_io_drain_pending();
+
+    gpu_shadow_record_fill(gpu_shadow_space_mmio, offset, NULL, val, size);
+
+    GPU_TRACE(trace_op_mmio_write, TRACE_WIDTH_BLOCK, offset, size);
+    gpu_io_backend->mmio_fill32(offset, val, size);
+}
+
+/* Read size bytes of the DFB starting at offset into buffer */
+void nv_dfb_read_block(uint32_t offset, void* buffer, uint32_t size)
+{
+    gpu_io_drain_pending();
+
+    GPU_TRACE(trace_op_dfb_read, TRACE_WIDTH_BLOCK, offset, size);
+    gpu_io_backend->dfb_read_block(offset, buffer, size);
+}
+
+/* Write size bytes from buffer into the DFB starting at offset */
+void nv_dfb_write_block(uint32_t offset, const void* buffer, uint32_t size)
+{
+    gpu_io_drain_pending();
+
+    GPU_TRACE(trace_op_dfb_write, TRACE_WIDTH_BLOCK, offset, size);
+    gpu_io_backend->dfb_write_block(offset, buffer, size);
+}
+
+/* Write val to every dword in the size bytes of the DFB starting at offset */
+void nv_dfb_fill32(uint32_t offset, uint32_t val, uint32_t size)
+{
+    gpu_io_drain_pending();
+
+    GPU_TRACE(trace_op_dfb_write, TRACE_WIDTH_BLOCK, offset, size);
+    gpu_io_backend->dfb_fill32(offset, val, size);
+}
+
+//
+// Port I/O Functions
+// Absolute port numbers. Port I/O is never queued, but it does drain the queue so it can't overtake queued writes.
+//
+
+uint8_t port_read8(uint16_t port)
+{
+    gpu_io_drain_pending();
+
+    uint8_t val = gpu_io_backend->port_read8(port);
+
+    GPU_TRACE(trace_op_port_read, 1, port, val);
+    return val;
+}
+
+uint16_t port_read16(uint16_t port)
+{
+    gpu_io_drain_pending();
+
+    uint16_t val = gpu_io_backend->port_read16(port);
+
+    GPU_TRACE(trace_op_port_read, 2, port, val);
+    return val;
+}
+
+void port_write8(uint16_t port, uint8_t val)
+{
+    gpu_io_drain_pending();
+
+    gpu_shadow_record8(gpu_shadow_space_port, port, val);
+
+    GPU_TRACE(trace_op_port_write, 1, port, val);
+    gpu_io_backend->port_write8(port, val);
+}
+
+void port_write16(uint16_t port, uint16_t val)
+{
+    gpu_io_drain_pending();
+
+    gpu_shadow_record8(gpu_shadow_space_port, port, val & 0xFF);
+    gpu_shadow_record8(gpu_shadow_space_port, port + 1, val >> 8);
+
+    GPU_TRACE(trace_op_port_write, 2, port, val);
+    gpu_io_backend->port_write16(port, val);
+}
+
+uint32_t port_read32(uint16_t port)
+{
+    uint32_t val;
+
+    if (gpu_shadow_lookup(gpu_shadow_space_port, port, &val))
+        return val;
+
+    gpu_io_drain_pending();
+
+    val = gpu_io_backend->port_read32(port);
+
+    if (current_device.shadow)
+        gpu_shadow_record(gpu_shadow_space_port, port, val);
+
+    GPU_TRACE(trace_op_port_read, 4, port, val);
+    return val;
+}
+
+void port_write32(uint16_t port, uint32_t val)
+{
+    gpu_io_drain_pending();
+    gpu_shadow_record(gpu_shadow_space_port, port, val);
+
+    GPU_TRACE(trace_op_port_write, 4, port, val);
+    gpu_io_backend->port_write32(port, val);
+}
+
+/* Read size bytes from a single port, a dword at a time */
+void port_read_block32(uint16_t port, void* buffer, uint32_t size)
+{
+    gpu_io_drain_pending();
+
+    GPU_TRACE(trace_op_port_read, TRACE_WIDTH_BLOCK, port, size);
+    gpu_io_backend->port_read_block32(port, buffer, size);
+}
+
+/* Write size bytes to a single port, a dword at a time */
+void port_write_block32(uint16_t port, const void* buffer, uint32_t size)
+{
+    gpu_io_drain_pending();
+
+    GPU_TRACE(trace_op_port_write, TRACE_WIDTH_BLOCK, port, size);
+    gpu_io_backend->port_write_block32(port, buffer, size);
+}
+
+/* Read size bytes of consecutive ports starting at port */
+void port_read_range32(uint16_t port, void* buffer, uint32_t size)
+{
+    gpu_io_drain_pending();
+
+    GPU_TRACE(trace_op_port_read, TRACE_WIDTH_BLOCK, port, size);
+    gpu_io_backend->port_read_range32(port, buffer, size);
+}
 
 //
 // Universal VGA functions
 //
 
+/* Shorthands for the VGA functions */
+#define vga_inb(port)               port_read8(port)
+#define vga_outb(port, val)         port_write8(port, val)
+
 uint8_t vga_crtc_read(uint8_t index)
 {
-    uint8_t miscout = inportb(VGA_PORT_MISCOUT);
+    uint8_t miscout = vga_inb(VGA_PORT_MISCOUT);
 
     if (!(miscout & 1))
-        return inportb(VGA_PORT_MONO_CRTC_INDEX);
+        return vga_inb(VGA_PORT_MONO_CRTC_INDEX);
     else
-        return inportb(VGA_PORT_COLOR_CRTC_INDEX);
+        return vga_inb(VGA_PORT_COLOR_CRTC_INDEX);
 }
 
 uint8_t vga_gdc_read(uint8_t index)
 {
-    outportb(VGA_PORT_GRAPHICS_INDEX, index);
+    vga_outb(VGA_PORT_GRAPHICS_INDEX, index);
 
-    return inportb(VGA_PORT_GRAPHICS);
+    return vga_inb(VGA_PORT_GRAPHICS);
 }
 
 // Read a byte from the VGA sequencer register with index index.
 uint8_t vga_sequencer_read(uint8_t index)
 {
-    outportb(VGA_PORT_SEQUENCER_INDEX, index);
+    vga_outb(VGA_PORT_SEQUENCER_INDEX, index);
 
-    return inportb(VGA_PORT_SEQUENCER);
+    return vga_inb(VGA_PORT_SEQUENCER);
 }
 
 // Read a VGA attribute register.
 uint8_t vga_attribute_read(uint8_t index)
 {
     // figure out if this is colour or mono
-    uint8_t miscout = inportb(VGA_PORT_MISCOUT);
+    uint8_t miscout = vga_inb(VGA_PORT_MISCOUT);
 
     // do a useless read to reset the attribute register flip-flop
 
     if (!(miscout & 1))
-        inportb(VGA_PORT_INPUT0_MONO);
+        vga_inb(VGA_PORT_INPUT0_MONO);
     else
-        inportb(VGA_PORT_INPUT0_COLOR);
+        vga_inb(VGA_PORT_INPUT0_COLOR);
 
     // write to 3c0. writing to the data is 3c1, but reading is 3c0. what.
-    outportb(VGA_PORT_ATTRIBUTE_REGISTER, index);
-    return inportb(VGA_PORT_ATTRIBUTE_DATA_WRITE);
+    vga_outb(VGA_PORT_ATTRIBUTE_REGISTER, index);
+    return vga_inb(VGA_PORT_ATTRIBUTE_DATA_WRITE);
 }
 
 void vga_crtc_write(uint8_t index, uint8_t value)
 {
-    uint8_t miscout = inportb(VGA_PORT_MISCOUT);
+    uint8_t miscout = vga_inb(VGA_PORT_MISCOUT);
 
     if (!(miscout & 1))
     {
-        outportb(VGA_PORT_MONO_CRTC_INDEX ,index);
-        outportb(VGA_PORT_MONO_CRTC, value);
+        vga_outb(VGA_PORT_MONO_CRTC_INDEX ,index);
+        vga_outb(VGA_PORT_MONO_CRTC, value);
     }
     else
     {
-        outportb(VGA_PORT_COLOR_CRTC_INDEX, value);
-        outportb(VGA_PORT_COLOR_CRTC, value);
+        vga_outb(VGA_PORT_COLOR_CRTC_INDEX, value);
+        vga_outb(VGA_PORT_COLOR_CRTC, value);
     }
 }
 
 void vga_gdc_write(uint8_t index, uint8_t value)
 {
-    outportb(VGA_PORT_GRAPHICS_INDEX, index);
-    outportb(VGA_PORT_GRAPHICS, value);
+    vga_outb(VGA_PORT_GRAPHICS_INDEX, index);
+    vga_outb(VGA_PORT_GRAPHICS, value);
 }
 
 void vga_sequencer_write(uint8_t index, uint8_t value)
 {
-    outportb(VGA_PORT_SEQUENCER_INDEX, index);
-    outportb(VGA_PORT_SEQUENCER, value);
+    vga_outb(VGA_PORT_SEQUENCER_INDEX, index);
+    vga_outb(VGA_PORT_SEQUENCER, value);
 }
 
 void vga_attribute_write(uint8_t index, uint8_t value)
 {
     // figure out if this is colour or mono
-    uint8_t miscout = inportb(VGA_PORT_MISCOUT);
+    uint8_t miscout = vga_inb(VGA_PORT_MISCOUT);
 
     // do a useless read to reset the attribute register flip-flop
 
     if (!(miscout & 1))
-        inportb(VGA_PORT_INPUT0_MONO);
+        vga_inb(VGA_PORT_INPUT0_MONO);
     else
-        inportb(VGA_PORT_INPUT0_COLOR);
+        vga_inb(VGA_PORT_INPUT0_COLOR);
 
     // write to 3c0
-    outportb(VGA_PORT_ATTRIBUTE_REGISTER, index);
-    outportb(VGA_PORT_ATTRIBUTE_REGISTER, value);
+    vga_outb(VGA_PORT_ATTRIBUTE_REGISTER, index);
+    vga_outb(VGA_PORT_ATTRIBUTE_REGISTER, value);
 
 
     // figure out what is being written next
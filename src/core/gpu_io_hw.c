@@ -0,0 +1,399 @@
+/* 
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_io_hw.c: Hardware I/O backend. Goes through the BAR selectors (or near pointers) and real port I/O.
+    DOS only: host builds have nothing but the simulated backend.
+*/
+
+#include <gpuplay.h>
+#include "util/util.h"
+#include <stdint.h>
+
+#ifdef __DJGPP__
+#include "pc.h"
+#include "sys/farptr.h"
+#include "sys/movedata.h"
+
+//
+// MMIO
+//
+
+static uint8_t gpu_hw_mmio_read8(uint32_t offset)
+{
+    if (current_device.bar0)
+        return *(volatile uint8_t*)((uint8_t*)current_device.bar0 + offset);
+
+    return _farpeekb(current_device.bar0_selector, offset);
+}
+
+static uint32_t gpu_hw_mmio_read32(uint32_t offset)
+{
+    if (current_device.bar0)
+        return *(volatile uint32_t*)((uint8_t*)current_device.bar0 + offset);
+
+    return _farpeekl(current_device.bar0_selector, offset);
+}
+
+static void gpu_hw_mmio_write8(uint32_t offset, uint8_t val)
+{
+    if (current_device.bar0)
+    {
+        *(volatile uint8_t*)((uint8_t*)current_device.bar0 + offset) = val;
+        return;
+    }
+
+    _farpokeb(current_device.bar0_selector, offset, val);
+}
+
+static void gpu_hw_mmio_write32(uint32_t offset, uint32_t val)
+{
+    if (current_device.bar0)
+    {
+        *(volatile uint32_t*)((uint8_t*)current_device.bar0 + offset) = val;
+        return;
+    }
+
+    _farpokel(current_device.bar0_selector, offset, val);
+}
+
+//
+// DFB
+//
+
+static uint8_t gpu_hw_dfb_read8(uint32_t offset)
+{
+    if (current_device.bar1)
+        return *(volatile uint8_t*)((uint8_t*)current_device.bar1 + offset);
+
+    return _farpeekb(current_device.bar1_selector, offset);
+}
+
+static uint16_t gpu_hw_dfb_read16(uint32_t offset)
+{
+    if (current_device.bar1)
+        return *(volatile uint16_t*)((uint8_t*)current_device.bar1 + offset);
+
+    return _farpeekw(current_device.bar1_selector, offset);
+}
+
+static uint32_t gpu_hw_dfb_read32(uint32_t offset)
+{
+    if (current_device.bar1)
+        return *(volatile uint32_t*)((uint8_t*)current_device.bar1 + offset);
+
+    return _farpeekl(current_device.bar1_selector, offset);
+}
+
+static void gpu_hw_dfb_write8(uint32_t offset, uint8_t val)
+{
+    if (current_device.bar1)
+    {
+        *(volatile uint8_t*)((uint8_t*)current_device.bar1 + offset) = val;
+        return;
+    }
+
+    _farpokeb(current_device.bar1_selector, offset, val);
+}
+
+static void gpu_hw_dfb_write16(uint32_t offset, uint16_t val)
+{
+    if (current_device.bar1)
+    {
+        *(volatile uint16_t*)((uint8_t*)current_device.bar1 + offset) = val;
+        return;
+    }
+
+    _farpokew(current_device.bar1_selector, offset, val);
+}
+
+static void gpu_hw_dfb_write32(uint32_t offset, uint32_t val)
+{
+    if (current_device.bar1)
+    {
+        *(volatile uint32_t*)((uint8_t*)current_device.bar1 + offset) = val;
+        return;
+    }
+
+    _farpokel(current_device.bar1_selector, offset, val);
+}
+
+//
+// Block transfers
+// Anything that isn't a multiple of 4 is moved a byte at a time at the end by movedata.
+//
+
+/* Fill size bytes starting at offset in the segment described by selector with a 32-bit value */
+static void gpu_hw_fill32(int32_t selector, uint32_t offset, uint32_t val, uint32_t size)
+{
+    uint32_t count = size >> 2;
+
+    if (!count)
+        return;
+
+    // es is not preserved by gcc, so save it ourselves
+    __asm__ __volatile__(
+        "pushl %%es\n\t"
+        "movw %w4, %%es\n\t"
+        "cld\n\t"
+        "rep stosl\n\t"
+        "popl %%es"
+        : "=D" (offset), "=c" (count)
+        : "0" (offset), "1" (count), "r" (selector), "a" (val)
+        : "memory", "cc");
+}
+
+/* Fill size bytes starting at a near pointer with a 32-bit value */
+static void gpu_hw_fill32_near(void* base, uint32_t offset, uint32_t val, uint32_t size)
+{
+    volatile uint32_t* dst = (volatile uint32_t*)((uint8_t*)base + offset);
+
+    for (uint32_t count = size >> 2; count; count--)
+        *dst++ = val;
+}
+
+/* 
+    Near pointer copies. Never memcpy: it's free to use byte or unaligned accesses and to merge or reorder them, 
+    none of which registers put up with. One dword access each, then the tail a byte at a time, like movedata
+*/
+static void gpu_hw_read_block_near(void* base, uint32_t offset, void* buffer, uint32_t size)
+{
+    volatile uint32_t* src = (volatile uint32_t*)((uint8_t*)base + offset);
+    uint8_t* dst = buffer;
+
+    for (uint32_t count = size >> 2; count; count--)
+    {
+        uint32_t val = *src++;
+        memcpy(dst, &val, sizeof(uint32_t));       // the buffer is ordinary memory, but may not be aligned
+        dst += sizeof(uint32_t);
+    }
+
+    volatile uint8_t* src_tail = (volatile uint8_t*)src;
+
+    for (uint32_t count = size & 3; count; count--)
+        *dst++ = *src_tail++;
+}
+
+static void gpu_hw_write_block_near(void* base, uint32_t offset, const void* buffer, uint32_t size)
+{
+    volatile uint32_t* dst = (volatile uint32_t*)((uint8_t*)base + offset);
+    const uint8_t* src = buffer;
+
+    for (uint32_t count = size >> 2; count; count--)
+    {
+        uint32_t val;
+        memcpy(&val, src, sizeof(uint32_t));
+        *dst++ = val;
+        src += sizeof(uint32_t);
+    }
+
+    volatile uint8_t* dst_tail = (volatile uint8_t*)dst;
+
+    for (uint32_t count = size & 3; count; count--)
+        *dst_tail++ = *src++;
+}
+
+static void gpu_hw_mmio_read_block(uint32_t offset, void* buffer, uint32_t size)
+{
+    if (current_device.bar0)
+        gpu_hw_read_block_near(current_device.bar0, offset, buffer, size);
+    else
+        movedata(current_device.bar0_selector, offset, _my_ds(), (uint32_t)buffer, size);
+}
+
+static void gpu_hw_mmio_write_block(uint32_t offset, const void* buffer, uint32_t size)
+{
+    if (current_device.bar0)
+        gpu_hw_write_block_near(current_device.bar0, offset, buffer, size);
+    else
+        movedata(_my_ds(), (uint32_t)buffer, current_device.bar0_selector, offset, size);
+}
+
+static void gpu_hw_mmio_fill32(uint32_t offset, uint32_t val, uint32_t size)
+{
+    if (current_device.bar0)
+        gpu_hw_fill32_near(current_device.bar0, offset, val, size);
+    else
+        gpu_hw_fill32(current_device.bar0_selector, offset, val, size);
+}
+
+static void gpu_hw_dfb_read_block(uint32_t offset, void* buffer, uint32_t size)
+{
+    if (current_device.bar1)
+        gpu_hw_read_block_near(current_device.bar1, offset, buffer, size);
+    else
+        movedata(current_device.bar1_selector, offset, _my_ds(), (uint32_t)buffer, size);
+}
+
+static void gpu_hw_dfb_write_block(uint32_t offset, const void* buffer, uint32_t size)
+{
+    if (current_device.bar1)
+        gpu_hw_write_block_near(current_device.bar1, offset, buffer, size);
+    else
+        movedata(_my_ds(), (uint32_t)buffer, current_device.bar1_selector, offset, size);
+}
+
+static void gpu_hw_dfb_fill32(uint32_t offset, uint32_t val, uint32_t size)
+{
+    if (current_device.bar1)
+        gpu_hw_fill32_near(current_device.bar1, offset, val, size);
+    else
+        gpu_hw_fill32(current_device.bar1_selector, offset, val, size);
+}
+
+//
+// Port I/O
+//
+
+static uint8_t gpu_hw_port_read8(uint16_t port)
+{
+    return inportb(port);
+}
+
+static uint16_t gpu_hw_port_read16(uint16_t port)
+{
+    return inportw(port);
+}
+
+static void gpu_hw_port_write8(uint16_t port, uint8_t val)
+{
+    outportb(port, val);
+}
+
+static void gpu_hw_port_write16(uint16_t port, uint16_t val)
+{
+    outportw(port, val);
+}
+
+static uint32_t gpu_hw_port_read32(uint16_t port)
+{
+    return inportl(port);
+}
+
+static void gpu_hw_port_write32(uint16_t port, uint32_t val)
+{
+    outportl(port, val);
+}
+
+static void gpu_hw_port_read_block32(uint16_t port, void* buffer, uint32_t size)
+{
+    inportsl(port, buffer, size >> 2);
+}
+
+static void gpu_hw_port_write_block32(uint16_t port, const void* buffer, uint32_t size)
+{
+    outportsl(port, buffer, size >> 2);
+}
+
+/* There's no string instruction that increments the port, so this is an inl per dword with nothing in between */
+static void gpu_hw_port_read_range32(uint16_t port, void* buffer, uint32_t size)
+{
+    uint32_t* dst = buffer;
+
+    for (uint32_t count = size >> 2; count; count--, port += 4)
+        *dst++ = inportl(port);
+}
+
+gpu_io_backend_t gpu_io_backend_hardware = 
+{
+    "hardware",
+    gpu_hw_mmio_read8,
+    gpu_hw_mmio_read32,
+    gpu_hw_mmio_write8,
+    gpu_hw_mmio_write32,
+    gpu_hw_dfb_read8,
+    gpu_hw_dfb_read16,
+    gpu_hw_dfb_read32,
+    gpu_hw_dfb_write8,
+    gpu_hw_dfb_write16,
+    gpu_hw_dfb_write32,
+    gpu_hw_mmio_read_block,
+    gpu_hw_mmio_write_block,
+    gpu_hw_mmio_fill32,
+    gpu_hw_dfb_read_block,
+    gpu_hw_dfb_write_block,
+    gpu_hw_dfb_fill32,
+    gpu_hw_port_read8,
+    gpu_hw_port_read16,
+    gpu_hw_port_write8,
+    gpu_hw_port_write16,
+    gpu_hw_port_read32,
+    gpu_hw_port_write32,
+    gpu_hw_port_read_block32,
+    gpu_hw_port_write_block32,
+    gpu_hw_port_read_range32,
+    NULL,                           // PCI config space goes through the PCI BIOS
+    NULL,
+};
+
+//
+// Near pointer support
+// With near pointers enabled, bar0/bar1 point straight at the BAR mappings and every accessor is a single load or store.
+// Otherwise they stay NULL and everything goes through the LDT selectors set up by the init function.
+//
+
+/* Turn a BAR selector into a near pointer to the same linear address */
+static void* gpu_hw_selector_to_near(int32_t selector)
+{
+    unsigned long base = 0;
+
+    if (!selector)
+        return NULL;
+
+    if (__dpmi_get_segment_base_address(selector, &base) == -1)
+        return NULL;
+
+    return (void*)(base + __djgpp_conventional_base);
+}
+
+/* Map bar0/bar1 as near pointers. Returns false (and leaves the selector path alone) if the DPMI host won't allow it */
+bool GPU_EnableNearPointers()
+{
+    if (gpu_io_backend != &gpu_io_backend_hardware)
+    {
+        Logging_Write(log_level_warning, "Near pointers only apply to the hardware backend\n");
+        return false; 
+    }
+
+    if (!__djgpp_nearptr_enable())
+    {
+        Logging_Write(log_level_warning, "Near pointers not available under this DPMI host, falling back to selectors\n");
+        return false; 
+    }
+
+    current_device.bar0 = gpu_hw_selector_to_near(current_device.bar0_selector);
+    current_device.bar1 = gpu_hw_selector_to_near(current_device.bar1_selector);
+
+    Logging_Write(log_level_debug, "Near pointers enabled: bar0=%p bar1=%p\n", current_device.bar0, current_device.bar1);
+    return true; 
+}
+
+void GPU_DisableNearPointers()
+{
+    if (!current_device.bar0 
+    && !current_device.bar1)
+        return;
+
+    GPU_FlushWrites();
+
+    current_device.bar0 = current_device.bar1 = NULL;
+    __djgpp_nearptr_disable();
+}
+
+#else
+
+bool GPU_EnableNearPointers()
+{
+    Logging_Write(log_level_warning, "Near pointers only apply to the hardware backend\n");
+    return false; 
+}
+
+// never enabled, so there's nothing to undo
+void GPU_DisableNearPointers()
+{
+}
+
+#endif
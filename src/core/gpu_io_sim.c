@@ -0,0 +1,361 @@
+/* 
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_io_sim.c: Simulated I/O backend. MMIO, VRAM, port space and PCI config space are plain RAM,
+    with optional per-register hooks for anything that needs to behave like a real register.
+*/
+
+#include <gpuplay.h>
+#include "util/util.h"
+#include <stdint.h>
+
+typedef struct gpu_sim_region_s
+{
+    uint8_t* memory;
+    uint32_t size;
+    uint32_t* hook_bitmap;          // One bit per dword. Only allocated once the region has a hook
+} gpu_sim_region_t; 
+
+typedef struct gpu_sim_hook_s
+{
+    gpu_sim_space space;
+    uint32_t offset;                // Dword aligned
+    gpu_sim_read_hook_t read_hook;
+    gpu_sim_write_hook_t write_hook;
+} gpu_sim_hook_t;
+
+static gpu_sim_region_t gpu_sim_regions[gpu_sim_space_count] = {0};
+static gpu_sim_hook_t gpu_sim_hooks[GPU_SIM_HOOKS_MAX] = {0};
+static uint32_t gpu_sim_num_hooks = 0;
+
+static const uint32_t gpu_sim_region_sizes[gpu_sim_space_count] = 
+{
+    GPU_SIM_MMIO_SIZE,
+    GPU_SIM_VRAM_SIZE,
+    GPU_SIM_PORT_SIZE,
+    GPU_SIM_PCI_SIZE,
+};
+
+static inline bool gpu_sim_has_hook(gpu_sim_region_t* region, uint32_t offset)
+{
+    return region->hook_bitmap
+    && (region->hook_bitmap[offset >> 7] & (1u << ((offset >> 2) & 31)));
+}
+
+static gpu_sim_hook_t* gpu_sim_find_hook(gpu_sim_space space, uint32_t offset)
+{
+    for (uint32_t i = 0; i < gpu_sim_num_hooks; i++)
+    {
+        if (gpu_sim_hooks[i].space == space
+        && gpu_sim_hooks[i].offset == offset)
+            return &gpu_sim_hooks[i];
+    }
+
+    return NULL; 
+}
+
+/* Read width bytes. Out of range reads float high like a master abort would */
+static uint32_t gpu_sim_read(gpu_sim_space space, uint32_t offset, uint32_t width)
+{
+    gpu_sim_region_t* region = &gpu_sim_regions[space];
+    uint32_t mask = (width == 4) ? 0xFFFFFFFF : ((1 << (width * 8)) - 1);
+
+    if (offset + width > region->size)
+        return mask;
+
+    uint32_t aligned = offset & ~3;
+
+    if (gpu_sim_has_hook(region, aligned))
+    {
+        gpu_sim_hook_t* hook = gpu_sim_find_hook(space, aligned);
+        uint32_t dword = *(uint32_t*)&region->memory[aligned];
+
+        if (hook 
+        && hook->read_hook)
+            dword = hook->read_hook(aligned, dword);
+
+        return (dword >> ((offset & 3) * 8)) & mask;
+    }
+
+    uint32_t val = 0;
+    memcpy(&val, &region->memory[offset], width);
+    return val;
+}
+
+/* Write width bytes. Out of range writes go nowhere */
+static void gpu_sim_write(gpu_sim_space space, uint32_t offset, uint32_t width, uint32_t val)
+{
+    gpu_sim_region_t* region = &gpu_sim_regions[space];
+
+    if (offset + width > region->size)
+        return;
+
+    uint32_t aligned = offset & ~3;
+
+    if (gpu_sim_has_hook(region, aligned))
+    {
+        gpu_sim_hook_t* hook = gpu_sim_find_hook(space, aligned);
+        uint32_t old_dword = *(uint32_t*)&region->memory[aligned];
+        uint32_t new_dword = old_dword;
+
+        // merge narrow writes into the dword the hook sees
+        memcpy((uint8_t*)&new_dword + (offset & 3), &val, width);
+
+        if (hook 
+        && hook->write_hook)
+            new_dword = hook->write_hook(aligned, old_dword, new_dword);
+
+        *(uint32_t*)&region->memory[aligned] = new_dword;
+        return;
+    }
+
+    memcpy(&region->memory[offset], &val, width);
+}
+
+static uint8_t gpu_sim_mmio_read8(uint32_t offset) { return gpu_sim_read(gpu_sim_space_mmio, offset, 1); }
+static uint32_t gpu_sim_mmio_read32(uint32_t offset) { return gpu_sim_read(gpu_sim_space_mmio, offset, 4); }
+static void gpu_sim_mmio_write8(uint32_t offset, uint8_t val) { gpu_sim_write(gpu_sim_space_mmio, offset, 1, val); }
+static void gpu_sim_mmio_write32(uint32_t offset, uint32_t val) { gpu_sim_write(gpu_sim_space_mmio, offset, 4, val); }
+
+static uint8_t gpu_sim_dfb_read8(uint32_t offset) { return gpu_sim_read(gpu_sim_space_dfb, offset, 1); }
+static uint16_t gpu_sim_dfb_read16(uint32_t offset) { return gpu_sim_read(gpu_sim_space_dfb, offset, 2); }
+static uint32_t gpu_sim_dfb_read32(uint32_t offset) { return gpu_sim_read(gpu_sim_space_dfb, offset, 4); }
+static void gpu_sim_dfb_write8(uint32_t offset, uint8_t val) { gpu_sim_write(gpu_sim_space_dfb, offset, 1, val); }
+static void gpu_sim_dfb_write16(uint32_t offset, uint16_t val) { gpu_sim_write(gpu_sim_space_dfb, offset, 2, val); }
+static void gpu_sim_dfb_write32(uint32_t offset, uint32_t val) { gpu_sim_write(gpu_sim_space_dfb, offset, 4, val); }
+
+static uint8_t gpu_sim_port_read8(uint16_t port) { return gpu_sim_read(gpu_sim_space_port, port, 1); }
+static uint16_t gpu_sim_port_read16(uint16_t port) { return gpu_sim_read(gpu_sim_space_port, port, 2); }
+static void gpu_sim_port_write8(uint16_t port, uint8_t val) { gpu_sim_write(gpu_sim_space_port, port, 1, val); }
+static void gpu_sim_port_write16(uint16_t port, uint16_t val) { gpu_sim_write(gpu_sim_space_port, port, 2, val); }
+static uint32_t gpu_sim_port_read32(uint16_t port) { return gpu_sim_read(gpu_sim_space_port, port, 4); }
+static void gpu_sim_port_write32(uint16_t port, uint32_t val) { gpu_sim_write(gpu_sim_space_port, port, 4, val); }
+
+/* Same port every time, so a hook on it sees every dword go past */
+static void gpu_sim_port_read_block32(uint16_t port, void* buffer, uint32_t size)
+{
+    uint32_t* dst = buffer;
+
+    for (uint32_t count = size >> 2; count; count--)
+        *dst++ = gpu_sim_read(gpu_sim_space_port, port, 4);
+}
+
+static void gpu_sim_port_write_block32(uint16_t port, const void* buffer, uint32_t size)
+{
+    const uint32_t* src = buffer;
+
+    for (uint32_t count = size >> 2; count; count--)
+        gpu_sim_write(gpu_sim_space_port, port, 4, *src++);
+}
+
+/* Only one simulated device, so the bus and function are ignored */
+static uint32_t gpu_sim_pci_read32(uint32_t bus_number, uint32_t function_number, uint32_t offset) 
+{ 
+    return gpu_sim_read(gpu_sim_space_pci, offset, 4); 
+}
+
+static void gpu_sim_pci_write32(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t val) 
+{ 
+    gpu_sim_write(gpu_sim_space_pci, offset, 4, val); 
+}
+
+/* Block transfers go a dword at a time so hooks still fire */
+static void gpu_sim_read_block(gpu_sim_space space, uint32_t offset, void* buffer, uint32_t size)
+{
+    uint8_t* dst = buffer;
+
+    for (; size >= 4; size -= 4, offset += 4, dst += 4)
+    {
+        uint32_t val = gpu_sim_read(space, offset, 4);
+        memcpy(dst, &val, 4);
+    }
+
+    for (; size; size--, offset++, dst++)
+        *dst = gpu_sim_read(space, offset, 1);
+}
+
+static void gpu_sim_write_block(gpu_sim_space space, uint32_t offset, const void* buffer, uint32_t size)
+{
+    const uint8_t* src = buffer;
+
+    for (; size >= 4; size -= 4, offset += 4, src += 4)
+    {
+        uint32_t val = 0;
+        memcpy(&val, src, 4);
+        gpu_sim_write(space, offset, 4, val);
+    }
+
+    for (; size; size--, offset++, src++)
+        gpu_sim_write(space, offset, 1, *src);
+}
+
+static void gpu_sim_fill32(gpu_sim_space space, uint32_t offset, uint32_t val, uint32_t size)
+{
+    for (uint32_t count = size >> 2; count; count--, offset += 4)
+        gpu_sim_write(space, offset, 4, val);
+}
+
+static void gpu_sim_mmio_read_block(uint32_t offset, void* buffer, uint32_t size) { gpu_sim_read_block(gpu_sim_space_mmio, offset, buffer, size); }
+static void gpu_sim_mmio_write_block(uint32_t offset, const void* buffer, uint32_t size) { gpu_sim_write_block(gpu_sim_space_mmio, offset, buffer, size); }
+static void gpu_sim_mmio_fill32(uint32_t offset, uint32_t val, uint32_t size) { gpu_sim_fill32(gpu_sim_space_mmio, offset, val, size); }
+static void gpu_sim_dfb_read_block(uint32_t offset, void* buffer, uint32_t size) { gpu_sim_read_block(gpu_sim_space_dfb, offset, buffer, size); }
+static void gpu_sim_dfb_write_block(uint32_t offset, const void* buffer, uint32_t size) { gpu_sim_write_block(gpu_sim_space_dfb, offset, buffer, size); }
+static void gpu_sim_dfb_fill32(uint32_t offset, uint32_t val, uint32_t size) { gpu_sim_fill32(gpu_sim_space_dfb, offset, val, size); }
+static void gpu_sim_port_read_range32(uint16_t port, void* buffer, uint32_t size) { gpu_sim_read_block(gpu_sim_space_port, port, buffer, size & ~3); }
+
+gpu_io_backend_t gpu_io_backend_sim = 
+{
+    "simulated",
+    gpu_sim_mmio_read8,
+    gpu_sim_mmio_read32,
+    gpu_sim_mmio_write8,
+    gpu_sim_mmio_write32,
+    gpu_sim_dfb_read8,
+    gpu_sim_dfb_read16,
+    gpu_sim_dfb_read32,
+    gpu_sim_dfb_write8,
+    gpu_sim_dfb_write16,
+    gpu_sim_dfb_write32,
+    gpu_sim_mmio_read_block,
+    gpu_sim_mmio_write_block,
+    gpu_sim_mmio_fill32,
+    gpu_sim_dfb_read_block,
+    gpu_sim_dfb_write_block,
+    gpu_sim_dfb_fill32,
+    gpu_sim_port_read8,
+    gpu_sim_port_read16,
+    gpu_sim_port_write8,
+    gpu_sim_port_write16,
+    gpu_sim_port_read32,
+    gpu_sim_port_write32,
+    gpu_sim_port_read_block32,
+    gpu_sim_port_write_block32,
+    gpu_sim_port_read_range32,
+    gpu_sim_pci_read32,
+    gpu_sim_pci_write32,
+};
+
+/* Set up a simulated device and switch every access over to the simulated backend */
+bool GPUSim_Init(uint32_t vendor_id, uint32_t device_id)
+{
+    for (uint32_t space = 0; space < gpu_sim_space_count; space++)
+    {
+        gpu_sim_regions[space].size = gpu_sim_region_sizes[space];
+        gpu_sim_regions[space].memory = calloc(1, gpu_sim_region_sizes[space]);
+
+        if (!gpu_sim_regions[space].memory)
+        {
+            Logging_Write(log_level_error, "Failed to allocate simulated device memory\n");
+            GPUSim_Shutdown();
+            return false; 
+        }
+    }
+
+    // pick up the real device info if we know about it, so architecture-specific tests and GPUS parsers apply
+    uint32_t i = 0;
+
+    while (supported_devices[i].vendor_id)
+    {
+        if (supported_devices[i].vendor_id == vendor_id
+        && supported_devices[i].device_id == device_id)
+        {
+            current_device.device_info = supported_devices[i];
+            break;
+        }
+
+        i++;
+    }
+
+    if (!current_device.device_info.vendor_id)
+    {
+        current_device.device_info.vendor_id = vendor_id;
+        current_device.device_info.device_id = device_id;
+        current_device.device_info.name = "Simulated GPU";
+    }
+
+    current_device.vram_amount = GPU_SIM_VRAM_SIZE;
+    gpu_num_devices = 1;                // the one simulated device is device 0, which is already active
+
+    // enough of a config header for the generic PCI tests
+    gpu_sim_write(gpu_sim_space_pci, PCI_CFG_OFFSET_VENDOR_ID, 2, vendor_id);
+    gpu_sim_write(gpu_sim_space_pci, PCI_CFG_OFFSET_DEVICE_ID, 2, device_id);
+    gpu_sim_write(gpu_sim_space_pci, PCI_CFG_OFFSET_COMMAND, 2, PCI_CFG_OFFSET_COMMAND_IO_ENABLED | PCI_CFG_OFFSET_COMMAND_MEM_ENABLED);
+    gpu_sim_write(gpu_sim_space_pci, 0x08, 4, 0x03000000);     // VGA compatible display controller
+
+    gpu_io_backend = &gpu_io_backend_sim;
+    PCI_SnapshotCapture(&current_device.pci_config, current_device.bus_number, current_device.function_number);
+
+    // e.g. status registers that have to read idle, or scripts polling them never finish
+    if (current_device.device_info.sim_init_function
+    && !current_device.device_info.sim_init_function())
+    {
+        Logging_Write(log_level_error, "Failed to set up the simulated %s\n", current_device.device_info.name);
+        GPUSim_Shutdown();
+        return false; 
+    }
+
+    Logging_Write(log_level_message, "Simulating GPU %04lx:%04lx (%s)\n", vendor_id, device_id, current_device.device_info.name);
+    return true; 
+}
+
+/* Hook a register. Offsets are rounded down to the containing dword */
+bool GPUSim_AddHook(gpu_sim_space space, uint32_t offset, gpu_sim_read_hook_t read_hook, gpu_sim_write_hook_t write_hook)
+{
+    gpu_sim_region_t* region = &gpu_sim_regions[space];
+
+    offset &= ~3;
+
+    if (!region->memory
+    || offset >= region->size)
+    {
+        Logging_Write(log_level_error, "GPUSim_AddHook: offset %08lx out of range for space %d\n", offset, space);
+        return false; 
+    }
+
+    gpu_sim_hook_t* hook = gpu_sim_find_hook(space, offset);
+
+    if (!hook
+    && gpu_sim_num_hooks >= GPU_SIM_HOOKS_MAX)
+    {
+        Logging_Write(log_level_error, "GPUSim_AddHook: too many hooks\n");
+        return false; 
+    }
+
+    // before claiming a slot, so a failed allocation doesn't leave a half-filled hook behind
+    if (!region->hook_bitmap)
+    {
+        region->hook_bitmap = calloc(1, (region->size >> 5) + sizeof(uint32_t));
+
+        if (!region->hook_bitmap)
+            return false; 
+    }
+
+    if (!hook)
+        hook = &gpu_sim_hooks[gpu_sim_num_hooks++];
+
+    hook->space = space;
+    hook->offset = offset;
+    hook->read_hook = read_hook;
+    hook->write_hook = write_hook;
+
+    region->hook_bitmap[offset >> 7] |= (1u << ((offset >> 2) & 31));
+    return true; 
+}
+
+void GPUSim_Shutdown()
+{
+    for (uint32_t space = 0; space < gpu_sim_space_count; space++)
+    {
+        free(gpu_sim_regions[space].memory);
+        free(gpu_sim_regions[space].hook_bitmap);
+        gpu_sim_regions[space].memory = NULL;
+        gpu_sim_regions[space].hook_bitmap = NULL;
+    }
+
+    gpu_sim_num_hooks = 0;
+    gpu_io_backend = &GPU_IO_BACKEND_DEFAULT;
+}
@@ -0,0 +1,335 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_mtrr.c: Write-combining MTRR over the LFB
+*/
+
+#include "gpuplay.h"
+#include "util/util.h"
+#include <core/mtrr/gpu_mtrr.h>
+#include <core/timing/gpu_timing.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+mtrr_state_t mtrr_state = {0};
+
+#ifdef __DJGPP__
+#include "dos.h"
+#include "dpmi.h"
+
+static inline uint64_t MTRR_ReadMSR(uint32_t msr)
+{
+    uint32_t low, high;
+    __asm__ __volatile__("rdmsr" : "=a" (low), "=d" (high) : "c" (msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline void MTRR_WriteMSR(uint32_t msr, uint64_t value)
+{
+    __asm__ __volatile__("wrmsr" : : "c" (msr), "a" ((uint32_t)value), "d" ((uint32_t)(value >> 32)));
+}
+
+static inline void MTRR_CPUID(uint32_t leaf, uint32_t* eax, uint32_t* edx)
+{
+    uint32_t ebx, ecx;
+    *eax = leaf;
+    __asm__ __volatile__("cpuid" : "+a" (*eax), "=b" (ebx), "=c" (ecx), "=d" (*edx));
+}
+
+/* The low two bits of CS are the privilege level we run at */
+static bool MTRR_IsRing0()
+{
+    uint16_t cs;
+    __asm__ __volatile__("movw %%cs, %0" : "=r" (cs));
+    return !(cs & 3);
+}
+
+static inline void MTRR_FlushTLB()
+{
+    uint32_t cr3;
+    __asm__ __volatile__("movl %%cr3, %0\n\tmovl %0, %%cr3" : "=r" (cr3) : : "memory");
+}
+
+/*
+    Change one variable range the way the Intel SDM says to: caches off and flushed, MTRRs disabled,
+    write the pair, flush again, then turn everything back on. DOS only ever runs one CPU, so there's nobody else to stop.
+*/
+static void MTRR_Write(uint32_t index, uint64_t base, uint64_t mask)
+{
+    int interrupts_were_enabled = disable();
+    uint32_t cr0;
+
+    __asm__ __volatile__("movl %%cr0, %0" : "=r" (cr0));
+    __asm__ __volatile__("movl %0, %%cr0\n\twbinvd" : : "r" ((cr0 | MTRR_CR0_CD) & ~MTRR_CR0_NW) : "memory");
+    MTRR_FlushTLB();
+
+    uint64_t def_type = MTRR_ReadMSR(MTRR_MSR_DEF_TYPE);
+    MTRR_WriteMSR(MTRR_MSR_DEF_TYPE, def_type & ~MTRR_DEF_TYPE_ENABLE);
+
+    MTRR_WriteMSR(MTRR_MSR_PHYS_BASE(index), base);
+    MTRR_WriteMSR(MTRR_MSR_PHYS_MASK(index), mask);
+
+    MTRR_WriteMSR(MTRR_MSR_DEF_TYPE, def_type);
+
+    __asm__ __volatile__("wbinvd" : : : "memory");
+    MTRR_FlushTLB();
+    __asm__ __volatile__("movl %0, %%cr0" : : "r" (cr0) : "memory");
+
+    if (interrupts_were_enabled)
+        enable();
+}
+
+/* Everything is checked once, in an order where nothing can fault: CPUID, then CPL, and only then an MSR */
+bool MTRR_IsAvailable()
+{
+    if (mtrr_state.probed)
+        return mtrr_state.available;
+
+    mtrr_state.probed = true;
+
+    // every CPU with MTRRs has a TSC, so if Timing_Init didn't find one there's no point asking CPUID
+    if (!timing_state.has_tsc)
+    {
+        Logging_Write(log_level_warning, "MTRR: this CPU has no MTRRs\n");
+        return false;
+    }
+
+    uint32_t eax, edx;
+    MTRR_CPUID(1, &eax, &edx);
+
+    if (!(edx & MTRR_CPUID_MTRR))
+    {
+        Logging_Write(log_level_warning, "MTRR: this CPU has no MTRRs\n");
+        return false;
+    }
+
+    uint32_t features = edx;
+
+    if (!MTRR_IsRing0())
+    {
+        Logging_Write(log_level_warning, "MTRR: MSRs can only be written at ring 0. Use a ring 0 DPMI host (e.g. CWSDPR0) for write-combining\n");
+        return false;
+    }
+
+    uint64_t capabilities = MTRR_ReadMSR(MTRR_MSR_CAP);
+
+    if (!(capabilities & MTRR_CAP_WC))
+    {
+        Logging_Write(log_level_warning, "MTRR: this CPU doesn't support the write-combining memory type\n");
+        return false;
+    }
+
+    mtrr_state.num_variable = capabilities & MTRR_CAP_VCNT_MASK;
+
+    // mask bits above the physical address width are reserved and fault if set
+    MTRR_CPUID(0x80000000, &eax, &edx);
+
+    if (eax >= MTRR_CPUID_EXT_ADDRESS_SIZE)
+    {
+        MTRR_CPUID(MTRR_CPUID_EXT_ADDRESS_SIZE, &eax, &edx);
+        mtrr_state.physical_bits = eax & 0xFF;
+    }
+    else
+        mtrr_state.physical_bits = (features & (MTRR_CPUID_PAE | MTRR_CPUID_PSE36)) ? 36 : 32;
+
+    Logging_Write(log_level_debug, "MTRR: %lu variable ranges, %lu-bit physical addresses\n", mtrr_state.num_variable, mtrr_state.physical_bits);
+
+    mtrr_state.available = true;
+    return true;
+}
+
+/* Make [base, base + size) write-combining. size must be a power of two of at least 4KB and base aligned to it, which a BAR always is */
+int32_t MTRR_SetWriteCombining(uint32_t base, uint32_t size)
+{
+    static bool registered_atexit = false;
+
+    if (!MTRR_IsAvailable())
+        return -1;
+
+    if (size < 0x1000
+    || (size & (size - 1))
+    || (base & (size - 1)))
+    {
+        Logging_Write(log_level_error, "MTRR: %08lx, %lu KB can't be covered by one variable range\n", base, size >> 10);
+        return -1;
+    }
+
+    if (mtrr_state.num_ranges >= MTRR_MAX_RANGES)
+    {
+        Logging_Write(log_level_error, "MTRR: already using %d ranges\n", MTRR_MAX_RANGES);
+        return -1;
+    }
+
+    uint64_t address_mask = ((1ULL << mtrr_state.physical_bits) - 1) & ~0xFFFULL;
+    uint64_t mask = ~(uint64_t)(size - 1) & address_mask;
+    int32_t free_index = -1;
+
+    for (uint32_t index = 0; index < mtrr_state.num_variable; index++)
+    {
+        uint64_t other_mask = MTRR_ReadMSR(MTRR_MSR_PHYS_MASK(index));
+
+        if (!(other_mask & MTRR_PHYS_MASK_VALID))
+        {
+            if (free_index < 0)
+                free_index = index;
+
+            continue;
+        }
+
+        // two masked ranges overlap if they agree on every bit both masks care about
+        uint64_t other_base = MTRR_ReadMSR(MTRR_MSR_PHYS_BASE(index));
+
+        if (!((other_base ^ base) & other_mask & mask))
+        {
+            Logging_Write(log_level_warning, "MTRR: range %lu (%08lx, type %lu) already covers the LFB%s\n", index,
+                (uint32_t)(other_base & MTRR_PAGE_MASK), (uint32_t)(other_base & 0xFF),
+                ((other_base & 0xFF) == MTRR_TYPE_UC) ? "; uncached wins over write-combining" : "");
+        }
+    }
+
+    if (free_index < 0)
+    {
+        Logging_Write(log_level_error, "MTRR: all %lu variable ranges are in use\n", mtrr_state.num_variable);
+        return -1;
+    }
+
+    mtrr_range_t* range = &mtrr_state.ranges[mtrr_state.num_ranges++];
+
+    range->index = free_index;
+    range->original_base = MTRR_ReadMSR(MTRR_MSR_PHYS_BASE(free_index));
+    range->original_mask = MTRR_ReadMSR(MTRR_MSR_PHYS_MASK(free_index));
+
+    MTRR_Write(free_index, base | MTRR_TYPE_WC, mask | MTRR_PHYS_MASK_VALID);
+
+    // a WC range left behind would outlive us and confuse whatever runs next
+    if (!registered_atexit)
+    {
+        atexit(MTRR_Shutdown);
+        registered_atexit = true;
+    }
+
+    Logging_Write(log_level_debug, "MTRR: range %ld is now write-combining over %08lx, %lu KB\n", free_index, base, size >> 10);
+    return free_index;
+}
+
+void MTRR_Shutdown()
+{
+    // newest first, in case the same range was somehow taken twice
+    while (mtrr_state.num_ranges)
+    {
+        mtrr_range_t* range = &mtrr_state.ranges[--mtrr_state.num_ranges];
+
+        MTRR_Write(range->index, range->original_base, range->original_mask);
+        Logging_Write(log_level_debug, "MTRR: range %lu restored\n", range->index);
+    }
+}
+
+/* Best write bandwidth over the first size bytes of the LFB, in MB/s */
+static double MTRR_BenchLFBWrite(const void* buffer, uint32_t size)
+{
+    uint64_t best = 0;
+
+    for (uint32_t iteration = 0; iteration < MTRR_BENCH_ITERATIONS; iteration++)
+    {
+        uint64_t start = Timing_ReadTSC();
+
+        nv_dfb_write_block(0, buffer, size);
+        GPU_FlushWrites();
+
+        uint64_t cycles = Timing_ReadTSC() - start;
+
+        if (!best
+        || cycles < best)
+            best = cycles;
+    }
+
+    return (best) ? (size / Timing_CyclesToSeconds(best)) / 1048576.0 : 0.0;
+}
+
+/* Cover the current device's LFB (mapped by its init function) with a WC range, and say how much it helped */
+bool GPU_EnableWriteCombining()
+{
+    if (!current_device.bar1_selector)
+    {
+        Logging_Write(log_level_error, "MTRR: %s has no LFB mapped\n", current_device.device_info.name);
+        return false;
+    }
+
+    if (!MTRR_IsAvailable())
+        return false;
+
+    // PCI_MapBar sets the limit to exactly the BAR size
+    uint32_t lfb_size = __dpmi_get_segment_limit(current_device.bar1_selector) + 1;
+    uint32_t bench_size = (lfb_size < MTRR_BENCH_SIZE) ? lfb_size : MTRR_BENCH_SIZE;
+
+    uint8_t* saved = calloc(1, bench_size);
+    uint8_t* buffer = calloc(1, bench_size);
+
+    if (!saved
+    || !buffer)
+    {
+        free(saved);
+        free(buffer);
+        Logging_Write(log_level_error, "MTRR: not enough memory for the bandwidth test\n");
+        return false;
+    }
+
+    // whatever is on screen survives the test
+    nv_dfb_read_block(0, saved, bench_size);
+
+    double before = MTRR_BenchLFBWrite(buffer, bench_size);
+    int32_t index = MTRR_SetWriteCombining(current_device.bar1_dfb_start, lfb_size);
+    double after = (index >= 0) ? MTRR_BenchLFBWrite(buffer, bench_size) : before;
+
+    nv_dfb_write_block(0, saved, bench_size);
+    GPU_FlushWrites();
+
+    free(saved);
+    free(buffer);
+
+    if (index < 0)
+        return false;
+
+    Logging_Write(log_level_message, "MTRR: LFB %08lx (%lu KB) is write-combining, write bandwidth %.2f MB/s -> %.2f MB/s\n",
+        current_device.bar1_dfb_start, lfb_size >> 10, before, after);
+
+    // the page tables win over the MTRR, and some hosts map physical memory with PCD set
+    if (after < before * 1.2)
+        Logging_Write(log_level_warning, "MTRR: no real improvement. The DPMI host may be mapping the LFB uncached in its page tables\n");
+
+    return true;
+}
+
+#else
+
+// The MSRs belong to the host OS, and there's no LFB to cover anyway
+bool MTRR_IsAvailable()
+{
+    if (!mtrr_state.probed)
+        Logging_Write(log_level_warning, "MTRR: write-combining is only available under DOS\n");
+
+    mtrr_state.probed = true;
+    return false;
+}
+
+int32_t MTRR_SetWriteCombining(uint32_t base, uint32_t size)
+{
+    MTRR_IsAvailable();
+    return -1;
+}
+
+void MTRR_Shutdown()
+{
+}
+
+bool GPU_EnableWriteCombining()
+{
+    return MTRR_IsAvailable();
+}
+
+#endif
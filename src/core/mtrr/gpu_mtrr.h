@@ -0,0 +1,66 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_mtrr.h: Write-combining over the LFB with a variable-range MTRR.
+
+    MSRs can only be touched at ring 0, so this only does anything under a ring 0 DPMI host (e.g. CWSDPR0).
+    Everything checks for that first and refuses cleanly instead of faulting.
+*/
+
+#pragma once
+#include <gpuplay.h>
+
+#define MTRR_CPUID_MTRR                 (1 << 12)       // Leaf 1 EDX
+#define MTRR_CPUID_PAE                  (1 << 6)        // Leaf 1 EDX, implies 36-bit physical addresses
+#define MTRR_CPUID_PSE36                (1 << 17)       // Leaf 1 EDX, likewise
+#define MTRR_CPUID_EXT_ADDRESS_SIZE     0x80000008      // EAX bits 7:0 = physical address bits
+
+#define MTRR_MSR_CAP                    0xFE
+#define MTRR_CAP_VCNT_MASK              0xFF            // Number of variable ranges
+#define MTRR_CAP_WC                     (1 << 10)       // Write-combining is a valid type
+#define MTRR_MSR_DEF_TYPE               0x2FF
+#define MTRR_DEF_TYPE_ENABLE            (1 << 11)
+#define MTRR_MSR_PHYS_BASE(n)           (0x200 + ((n) << 1))
+#define MTRR_MSR_PHYS_MASK(n)           (0x201 + ((n) << 1))
+#define MTRR_PHYS_MASK_VALID            (1 << 11)
+#define MTRR_PAGE_MASK                  0xFFFFF000
+
+#define MTRR_TYPE_UC                    0
+#define MTRR_TYPE_WC                    1
+
+#define MTRR_MAX_RANGES                 GPU_MAX_DEVICES // At most one per GPU
+#define MTRR_BENCH_SIZE                 0x100000        // LFB written for the before/after bandwidth
+#define MTRR_BENCH_ITERATIONS           3               // Best of
+
+#define MTRR_CR0_NW                     (1 << 29)
+#define MTRR_CR0_CD                     (1 << 30)
+
+/* A variable range we took, and what was in it before */
+typedef struct mtrr_range_s
+{
+    uint32_t index;
+    uint64_t original_base;
+    uint64_t original_mask;
+} mtrr_range_t;
+
+typedef struct mtrr_state_s
+{
+    bool probed;
+    bool available;                 // CPU has MTRRs with WC, and we are at ring 0
+    uint32_t num_variable;          // Variable ranges the CPU has
+    uint32_t physical_bits;
+    mtrr_range_t ranges[MTRR_MAX_RANGES];
+    uint32_t num_ranges;            // Ranges we have programmed
+} mtrr_state_t;
+
+extern mtrr_state_t mtrr_state;
+
+bool MTRR_IsAvailable();
+int32_t MTRR_SetWriteCombining(uint32_t base, uint32_t size);  // Returns the variable range used, or -1
+void MTRR_Shutdown();                                            // Put back every range we took
+
+bool GPU_EnableWriteCombining();                                 // WC over the current device's LFB, with before/after bandwidth
@@ -8,34 +8,154 @@
     pci.c: Implements wrappers around PCI BIOS functions
 */
 
-#include "dos.h"
-#include "dpmi.h"
 #include "gpuplay.h"
 #include "util/util.h"
+#include <core/trace/gpu_trace.h>
 
+#include <signal.h>
 #include <stdint.h>
 
-/* Discover the PCI BIOS */
-bool PCI_BiosIsPresent(void) 
-{ 
-  __dpmi_regs regs = {0};
+#ifdef __DJGPP__
+#include "dos.h"
+#include "dpmi.h"
+#endif
 
-  regs.h.ah = PCI_FUNCTION_ID_BASE;
-  regs.h.al = PCI_BIOS_PRESENT;
+// function_number is the BIOS-style device/function byte, which is exactly what mechanism #1 wants in bits 15:8
+#define PCI_MECHANISM_1_ADDRESS_FOR(bus_number, function_number, offset) \
+    (PCI_MECHANISM_1_ENABLE | ((bus_number) << 16) | ((function_number) << 8) | ((offset) & 0xFC))
 
-  __dpmi_int(INT_PCI_BIOS, &regs);
+pci_mechanism pci_config_mechanism = pci_mechanism_bios;
+uint32_t pci_last_bus = 0;
+pci_journal_t pci_journal = {0};
+
+// Signals the journal gets restored on, and whoever had them before
+static const int pci_journal_signals[] = { SIGINT, SIGABRT, SIGSEGV, SIGFPE, SIGILL };
+#define PCI_JOURNAL_NUM_SIGNALS     (sizeof(pci_journal_signals) / sizeof(pci_journal_signals[0]))
+static void (*pci_journal_previous_handlers[PCI_JOURNAL_NUM_SIGNALS])(int);
+
+#ifdef __DJGPP__
+
+/* 
+    Mechanism #1 accessors. The address/data pair must not be split by anything else doing config cycles,
+    so interrupts are off for the duration.
+*/
+static uint32_t PCI_Mechanism1Read(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t width)
+{
+    uint32_t value;
+    int interrupts_were_enabled = disable();
+
+    outportl(PCI_MECHANISM_1_ADDRESS, PCI_MECHANISM_1_ADDRESS_FOR(bus_number, function_number, offset));
+
+    if (width == 1)
+        value = inportb(PCI_MECHANISM_1_DATA + (offset & 3));
+    else if (width == 2)
+        value = inportw(PCI_MECHANISM_1_DATA + (offset & 2));
+    else
+        value = inportl(PCI_MECHANISM_1_DATA);
+
+    if (interrupts_were_enabled)
+        enable();
+
+    return value;
+}
+
+static void PCI_Mechanism1Write(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t width, uint32_t value)
+{
+    int interrupts_were_enabled = disable();
+
+    outportl(PCI_MECHANISM_1_ADDRESS, PCI_MECHANISM_1_ADDRESS_FOR(bus_number, function_number, offset));
+
+    if (width == 1)
+        outportb(PCI_MECHANISM_1_DATA + (offset & 3), value);
+    else if (width == 2)
+        outportw(PCI_MECHANISM_1_DATA + (offset & 2), value);
+    else
+        outportl(PCI_MECHANISM_1_DATA, value);
+
+    if (interrupts_were_enabled)
+        enable();
+}
+
+/* 
+    Probe for mechanism #1 the same way everyone else does: the address register has to hold a dword with the enable bit set,
+    which mechanism #2 hardware (where 0xCF8 is a byte register) can't do. Then make sure there's actually a host bridge answering.
+*/
+bool PCI_Mechanism1IsPresent(void)
+{
+    int interrupts_were_enabled = disable();
+
+    uint32_t saved_address = inportl(PCI_MECHANISM_1_ADDRESS);
+
+    outportl(PCI_MECHANISM_1_ADDRESS, PCI_MECHANISM_1_ENABLE);
+    bool address_latched = (inportl(PCI_MECHANISM_1_ADDRESS) == PCI_MECHANISM_1_ENABLE);
+    outportl(PCI_MECHANISM_1_ADDRESS, saved_address);
+
+    if (interrupts_were_enabled)
+        enable();
+
+    if (!address_latched)
+        return false;
+
+    // something on bus 0 has to answer (normally the host bridge at device 0)
+    for (uint32_t device = 0; device < 32; device++)
+    {
+        if (PCI_Mechanism1Read(0, device << 3, PCI_CFG_OFFSET_VENDOR_ID, 2) != 0xFFFF)
+            return true;
+    }
 
-  if (regs.d.edx != PCI_BIOS_MAGIC) // "PCI "
-  {
-    Logging_Write(log_level_error, "PCI BIOS not found, or PCI BIOS specification was below version 2.0c\n");
     return false;
-  }
+}
 
-  Logging_Write(log_level_message, "Found PCI BIOS, specification version %x.%x\n", regs.h.bh, regs.h.bl); // %x as a cheap way of printing it as BCD
-  return true; 
+/* The real config space: mechanism #1 if we found it, otherwise the PCI BIOS. False if the BIOS refused */
+bool PCI_HardwareRead(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t width, uint32_t* value)
+{
+    if (pci_config_mechanism == pci_mechanism_1)
+    {
+        *value = PCI_Mechanism1Read(bus_number, function_number, offset, width);
+        return true;
+    }
+
+    __dpmi_regs regs = {0};
+
+    regs.h.ah = PCI_FUNCTION_ID_BASE;
+    regs.h.al = (width == 1) ? PCI_READ_CONFIG_BYTE : (width == 2) ? PCI_READ_CONFIG_WORD : PCI_READ_CONFIG_DWORD;
+    regs.h.bh = bus_number;
+    regs.h.bl = function_number;
+    regs.x.di = offset;
+
+    __dpmi_int(INT_PCI_BIOS, &regs);
+
+    if (regs.h.ah) // non-zero = error
+        return false;
+
+    *value = (width == 1) ? regs.h.cl : (width == 2) ? regs.x.cx : regs.d.ecx;
+    return true;
 }
 
-bool PCI_DevicePresent(uint32_t device_id, uint32_t vendor_id)
+bool PCI_HardwareWrite(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t width, uint32_t value)
+{
+    if (pci_config_mechanism == pci_mechanism_1)
+    {
+        PCI_Mechanism1Write(bus_number, function_number, offset, width, value);
+        return true;
+    }
+
+    __dpmi_regs regs = {0};
+
+    regs.h.ah = PCI_FUNCTION_ID_BASE;
+    regs.h.al = (width == 1) ? PCI_WRITE_CONFIG_BYTE : (width == 2) ? PCI_WRITE_CONFIG_WORD : PCI_WRITE_CONFIG_DWORD;
+    regs.h.bh = bus_number;
+    regs.h.bl = function_number;
+    regs.x.di = offset;
+    regs.d.ecx = value;     // CL and CX are the low end of ECX, and value is already no wider than the write
+
+    __dpmi_int(INT_PCI_BIOS, &regs);
+
+    return !regs.h.ah;
+}
+
+/* Ask the BIOS where the device is, and make that the current device's location */
+static bool PCI_HardwareFindDevice(uint32_t device_id, uint32_t vendor_id)
 {
     __dpmi_regs regs = {0};
 
@@ -68,26 +188,113 @@ bool PCI_DevicePresent(uint32_t device_id, uint32_t vendor_id)
     return true; 
 }
 
-uint8_t PCI_ReadConfig8(uint32_t bus_number, uint32_t function_number, uint32_t offset)
+/* Discover the PCI BIOS */
+bool PCI_BiosIsPresent(void) 
+{ 
+  __dpmi_regs regs = {0};
+
+  regs.h.ah = PCI_FUNCTION_ID_BASE;
+  regs.h.al = PCI_BIOS_PRESENT;
+
+  __dpmi_int(INT_PCI_BIOS, &regs);
+
+  if (regs.d.edx != PCI_BIOS_MAGIC) // "PCI "
+  {
+    Logging_Write(log_level_error, "PCI BIOS not found, or PCI BIOS specification was below version 2.0c\n");
+    return false;
+  }
+
+  Logging_Write(log_level_message, "Found PCI BIOS, specification version %x.%x\n", regs.h.bh, regs.h.bl); // %x as a cheap way of printing it as BCD
+
+  // CL = number of the last PCI bus in the system
+  pci_last_bus = regs.h.cl;
+  return true; 
+}
+
+#else
+
+// Outside DOS the simulated backend's config space is the only one, and every access goes there before it could get here
+bool PCI_HardwareRead(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t width, uint32_t* value)
 {
-    __dpmi_regs regs = {0};
+    return false;
+}
 
-    regs.h.ah = PCI_FUNCTION_ID_BASE;
-    regs.h.al = PCI_READ_CONFIG_BYTE;
-    regs.h.bh = bus_number;
-    regs.h.bl = function_number;
-    regs.x.di = offset;
+bool PCI_HardwareWrite(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t width, uint32_t value)
+{
+    return false;
+}
 
-    __dpmi_int(INT_PCI_BIOS, &regs);
+static bool PCI_HardwareFindDevice(uint32_t device_id, uint32_t vendor_id)
+{
+    return false;
+}
+
+bool PCI_Mechanism1IsPresent(void)
+{
+    return false;
+}
 
-    if (!regs.h.ah)
-        return regs.h.cl;
-    else 
+bool PCI_BiosIsPresent(void) 
+{
+    Logging_Write(log_level_error, "There's no PCI BIOS outside DOS. Use -sim\n");
+    return false;
+}
+
+#endif
+
+/* Pick the config mechanism from the [PCI] Mechanism= setting: auto (default), bios or direct */
+void PCI_SelectMechanism(const char* setting)
+{
+    pci_config_mechanism = pci_mechanism_bios;
+
+    if (setting
+    && !strcasecmp(setting, "bios"))
+    {
+        Logging_Write(log_level_message, "PCI config space: PCI BIOS (forced in INI)\n");
+        return;
+    }
+
+    bool forced = (setting && !strcasecmp(setting, "direct"));
+
+    if (PCI_Mechanism1IsPresent())
+    {
+        pci_config_mechanism = pci_mechanism_1;
+        Logging_Write(log_level_message, "PCI config space: mechanism #1 (ports %03X/%03X)\n", PCI_MECHANISM_1_ADDRESS, PCI_MECHANISM_1_DATA);
+    }
+    else if (forced)
+        Logging_Write(log_level_warning, "Mechanism=direct set in INI but configuration mechanism #1 wasn't found; using the PCI BIOS\n");
+    else
+        Logging_Write(log_level_message, "PCI config space: PCI BIOS\n");
+}
+
+bool PCI_DevicePresent(uint32_t device_id, uint32_t vendor_id)
+{
+    // the simulated backend only has one device, which is always there
+    if (gpu_io_backend->pci_read32)
+    {
+        current_device.bus_number = current_device.function_number = 0;
+        return (gpu_io_backend->pci_read32(0, 0, PCI_CFG_OFFSET_VENDOR_ID) == ((device_id << 16) | vendor_id));
+    }
+
+    return PCI_HardwareFindDevice(device_id, vendor_id);
+}
+
+uint8_t PCI_ReadConfig8(uint32_t bus_number, uint32_t function_number, uint32_t offset)
+{
+    if (gpu_io_backend->pci_read32)
+        return PCI_ReadConfig32(bus_number, function_number, offset & ~3) >> ((offset & 3) * 8);
+
+    uint32_t value = 0;
+
+    if (!PCI_HardwareRead(bus_number, function_number, offset, 1, &value))
     {
         //todo fatal error code
         Logging_Write(log_level_error, "FAILED to read PCI bus %lu function %lu offset %08lX info (8bit)\n", bus_number, function_number, offset);
         return 0x00;
     }
+
+    GPU_TRACE(trace_op_pci_read, 1, PCI_TRACE_ADDRESS(bus_number, function_number, offset), value);
+    return value;
 }
 
 uint16_t PCI_ReadConfig16(uint32_t bus_number, uint32_t function_number, uint32_t offset)
@@ -98,24 +305,20 @@ uint16_t PCI_ReadConfig16(uint32_t bus_number, uint32_t function_number, uint32_
         Logging_Write(log_level_error, "BUG: PCI_ReadConfig16 called with unaligned address");
         return 0x00; // it's not happening (TODO: error code)
     }
-        
-    __dpmi_regs regs = {0};
 
-    regs.h.ah = PCI_FUNCTION_ID_BASE;
-    regs.h.al = PCI_READ_CONFIG_WORD;
-    regs.h.bh = bus_number;
-    regs.h.bl = function_number;
-    regs.x.di = offset;
+    if (gpu_io_backend->pci_read32)
+        return PCI_ReadConfig32(bus_number, function_number, offset & ~3) >> ((offset & 3) * 8);
 
-    __dpmi_int(INT_PCI_BIOS, &regs);
+    uint32_t value = 0;
 
-    if (!regs.h.ah)
-        return regs.x.cx;
-    else 
+    if (!PCI_HardwareRead(bus_number, function_number, offset, 2, &value))
     {
         Logging_Write(log_level_error, "FAILED to read PCI bus %lu function %lu offset %08lX info (16bit)\n", bus_number, function_number, offset);
         return 0x00;
     }
+
+    GPU_TRACE(trace_op_pci_read, 2, PCI_TRACE_ADDRESS(bus_number, function_number, offset), value);
+    return value;
 }
 
 /* Read the config dword for the current device */
@@ -127,50 +330,160 @@ uint32_t PCI_ReadConfig32(uint32_t bus_number, uint32_t function_number, uint32_
         Logging_Write(log_level_error, "BUG: PCI_ReadConfig32 called with unaligned address");
         return 0x00; // it's not happening (TODO: error code)
     }
-        
-    __dpmi_regs regs = {0};
 
-    regs.h.ah = PCI_FUNCTION_ID_BASE;
-    regs.h.al = PCI_READ_CONFIG_DWORD;
-    regs.h.bh = bus_number;
-    regs.h.bl = function_number;
-    regs.x.di = offset;
-
-    __dpmi_int(INT_PCI_BIOS, &regs);
+    uint32_t value = 0;
 
-    if (!regs.h.ah)
-        return regs.d.ecx;
-    else 
+    if (gpu_io_backend->pci_read32)
+        value = gpu_io_backend->pci_read32(bus_number, function_number, offset);
+    else if (!PCI_HardwareRead(bus_number, function_number, offset, 4, &value))
     {
         Logging_Write(log_level_error, "FAILED to read PCI bus %lu function %lu offset %08lX info (32bit)\n", bus_number, function_number, offset);
         return 0x00;
-    } 
+    }
+
+    GPU_TRACE(trace_op_pci_read, 4, PCI_TRACE_ADDRESS(bus_number, function_number, offset), value);
+    return value;
+}
+
+//
+// Config write journal
+//
+
+/* Put the config space back, then let the signal do what it would have done anyway */
+static void PCI_JournalSignal(int signal_number)
+{
+    void (*previous)(int) = SIG_DFL;
+
+    for (uint32_t i = 0; i < PCI_JOURNAL_NUM_SIGNALS; i++)
+    {
+        if (pci_journal_signals[i] == signal_number)
+            previous = pci_journal_previous_handlers[i];
+    }
+
+    // it wasn't going to stop us before either
+    if (previous == SIG_IGN)
+        return;
+
+    PCI_JournalRestore();
+
+    // chain to whoever had it before (e.g. the debugger stub), while the exception state is still the crash's
+    if (previous != SIG_DFL
+    && previous != SIG_ERR)
+    {
+        previous(signal_number);
+        return;
+    }
+
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+/* Nothing is journaled until this is called, so -bootonly can leave the card the way init set it up */
+void PCI_JournalEnable(bool enabled)
+{
+    static bool handlers_installed = false;
+
+    pci_journal.enabled = enabled;
+
+    if (!enabled
+    || handlers_installed)
+        return;
+
+    atexit(PCI_JournalRestore);
+
+    for (uint32_t i = 0; i < PCI_JOURNAL_NUM_SIGNALS; i++)
+    {
+        // PCI_JournalSignal passes the signal on to these
+        pci_journal_previous_handlers[i] = signal(pci_journal_signals[i], PCI_JournalSignal);
+    }
+
+    handlers_installed = true;
+}
+
+/* Called before every write. Only the first write to a dword matters: that's the value to go back to */
+void PCI_JournalRecord(uint32_t bus_number, uint32_t function_number, uint32_t offset)
+{
+    if (!pci_journal.enabled
+    || pci_journal.restoring)
+        return;
+
+    offset &= ~3;
+
+    for (uint32_t i = 0; i < pci_journal.count; i++)
+    {
+        pci_journal_entry_t* entry = &pci_journal.entries[i];
+
+        if (entry->bus_number == bus_number
+        && entry->function_number == function_number
+        && entry->offset == offset)
+            return;
+    }
+
+    if (pci_journal.count >= PCI_JOURNAL_MAX_ENTRIES)
+    {
+        Logging_Write(log_level_warning, "PCI journal is full, %02lx:%02lx.%lx offset %02lx won't be restored\n",
+            bus_number, function_number >> 3, function_number & 7, offset);
+        return;
+    }
+
+    pci_journal_entry_t* entry = &pci_journal.entries[pci_journal.count];
+
+    entry->bus_number = bus_number;
+    entry->function_number = function_number;
+    entry->offset = offset;
+    entry->original = PCI_ReadConfig32(bus_number, function_number, offset);
+    pci_journal.count++;
+}
+
+/* Newest first, so anything that depended on an earlier write is undone before it. Safe to call more than once */
+void PCI_JournalRestore()
+{
+    if (pci_journal.restoring
+    || !pci_journal.count)
+        return;
+
+    pci_journal.restoring = true;
+
+    uint32_t restored = pci_journal.count;
+
+    while (pci_journal.count)
+    {
+        pci_journal_entry_t* entry = &pci_journal.entries[--pci_journal.count];
+
+        // the status half of the command dword is write-1-to-clear, so only the command register goes back
+        if (entry->offset == PCI_CFG_OFFSET_COMMAND)
+            PCI_WriteConfig16(entry->bus_number, entry->function_number, PCI_CFG_OFFSET_COMMAND, entry->original & 0xFFFF);
+        else
+            PCI_WriteConfig32(entry->bus_number, entry->function_number, entry->offset, entry->original);
+    }
+
+    pci_journal.restoring = false;
+    Logging_Write(log_level_debug, "PCI journal: restored %lu config dwords\n", restored);
 }
 
 bool PCI_WriteConfig8(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint8_t value)
 {
-    __dpmi_regs regs = {0};
+    PCI_JournalRecord(bus_number, function_number, offset);
 
-    regs.h.ah = PCI_FUNCTION_ID_BASE;
-    regs.h.al = PCI_WRITE_CONFIG_BYTE;
-    regs.h.bh = bus_number;
-    regs.h.bl = function_number;
-    regs.h.cl = value;
-    regs.x.di = offset;
+    if (gpu_io_backend->pci_write32)
+    {
+        uint32_t shift = (offset & 3) * 8;
+        uint32_t dword = PCI_ReadConfig32(bus_number, function_number, offset & ~3);
 
-    __dpmi_int(INT_PCI_BIOS, &regs);
+        return PCI_WriteConfig32(bus_number, function_number, offset & ~3, (dword & ~(0xFFu << shift)) | ((uint32_t)value << shift));
+    }
 
-    if (!regs.h.ah)
-        return false;
-    else 
+    GPU_TRACE(trace_op_pci_write, 1, PCI_TRACE_ADDRESS(bus_number, function_number, offset), value);
+
+    if (!PCI_HardwareWrite(bus_number, function_number, offset, 1, value))
     {
         //todo fatal error code
         Logging_Write(log_level_error, "FAILED to write PCI bus %lu function %lu offset %08lX info (8bit)\n", bus_number, function_number, offset);
         return true;
     }
-    
-    return false; // failsafe, should never happen
 
+    PCI_SnapshotRefresh(bus_number, function_number, offset);
+    return false;
 }
 
 bool PCI_WriteConfig16(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint16_t value)
@@ -181,28 +494,27 @@ bool PCI_WriteConfig16(uint32_t bus_number, uint32_t function_number, uint32_t o
         Logging_Write(log_level_error, "BUG: PCI_WriteConfig16 called with unaligned address!\n");
         return 0x00; // it's not happening (TODO: error code)
     }
-        
-    __dpmi_regs regs = {0};
 
-    regs.h.ah = PCI_FUNCTION_ID_BASE;
-    regs.h.al = PCI_WRITE_CONFIG_WORD;
-    regs.h.bh = bus_number;
-    regs.h.bl = function_number;
-    regs.x.cx = value;
+    PCI_JournalRecord(bus_number, function_number, offset);
 
-    regs.x.di = offset;
+    if (gpu_io_backend->pci_write32)
+    {
+        uint32_t shift = (offset & 3) * 8;
+        uint32_t dword = PCI_ReadConfig32(bus_number, function_number, offset & ~3);
 
-    __dpmi_int(INT_PCI_BIOS, &regs);
+        return PCI_WriteConfig32(bus_number, function_number, offset & ~3, (dword & ~(0xFFFFu << shift)) | ((uint32_t)value << shift));
+    }
 
-    if (!regs.h.ah)
-        return false; 
-    else 
+    GPU_TRACE(trace_op_pci_write, 2, PCI_TRACE_ADDRESS(bus_number, function_number, offset), value);
+
+    if (!PCI_HardwareWrite(bus_number, function_number, offset, 2, value))
     {
         Logging_Write(log_level_error, "FAILED to write PCI bus %lu function %lu offset %08lX info (16bit)\n", bus_number, function_number, offset);
         return true;
     }
 
-    return false; // failsafe, should never happen
+    PCI_SnapshotRefresh(bus_number, function_number, offset);
+    return false;
 }
 
 /* Read the config dword for the current device */
@@ -214,25 +526,19 @@ bool PCI_WriteConfig32(uint32_t bus_number, uint32_t function_number, uint32_t o
         Logging_Write(log_level_error, "BUG: PCI_WriteConfig32 called with unaligned address!\n");
         return 0x00; // it's not happening (TODO: error code)
     }
-        
-    __dpmi_regs regs = {0};
 
-    regs.h.ah = PCI_FUNCTION_ID_BASE;
-    regs.h.al = PCI_WRITE_CONFIG_DWORD;
-    regs.h.bh = bus_number;
-    regs.h.bl = function_number;
-    regs.x.di = offset;
-    regs.d.ecx = value; 
+    PCI_JournalRecord(bus_number, function_number, offset);
 
-    __dpmi_int(INT_PCI_BIOS, &regs);
+    GPU_TRACE(trace_op_pci_write, 4, PCI_TRACE_ADDRESS(bus_number, function_number, offset), value);
 
-    if (!regs.h.ah)
-        return false;
-    else 
+    if (gpu_io_backend->pci_write32)
+        gpu_io_backend->pci_write32(bus_number, function_number, offset, value);
+    else if (!PCI_HardwareWrite(bus_number, function_number, offset, 4, value))
     {
         Logging_Write(log_level_error, "FAILED to write PCI bus %lu function %lu offset %08lX info (32bit)\n", bus_number, function_number, offset);
         return true;
     }
 
-    return false; // failsafe, should never happen
-}
\ No newline at end of file
+    PCI_SnapshotRefresh(bus_number, function_number, offset);
+    return false;
+}
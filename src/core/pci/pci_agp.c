@@ -0,0 +1,164 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    pci_agp.c: AGP mode negotiation between the host bridge (target) and the GPU (master)
+*/
+
+#include "gpuplay.h"
+#include "util/util.h"
+
+#include <stdint.h>
+
+agp_state_t agp_state = {0};
+
+/* Write a command register and keep the bridge's snapshot in step. The GPU's own snapshot is refreshed by PCI_WriteConfig32 */
+static void AGP_WriteCommand(const pci_config_snapshot_t* snapshot, uint8_t capability, uint32_t command)
+{
+    uint32_t offset = capability + PCI_AGP_OFFSET_COMMAND;
+
+    PCI_WriteConfig32(snapshot->bus_number, snapshot->function_number, offset, command);
+
+    if (snapshot == &agp_state.bridge)
+        agp_state.bridge.dwords[offset >> 2] = PCI_ReadConfig32(snapshot->bus_number, snapshot->function_number, offset);
+}
+
+/* Find the AGP capability on the GPU and on the host bridge. Cheap to call again */
+bool AGP_Init()
+{
+    if (agp_state.present
+    && agp_state.device == gpu_active_device)
+        return true;
+
+    // set up for another GPU: leave that one the way we found it
+    AGP_Restore();
+    memset(&agp_state, 0, sizeof(agp_state_t));
+
+    pci_config_snapshot_t* device = PCI_CurrentConfig();
+    agp_state.device_capability = PCI_FindCapability(device, PCI_CAP_ID_AGP);
+
+    if (!agp_state.device_capability)
+    {
+        Logging_Write(log_level_warning, "AGP: %s has no AGP capability (PCI card?)\n", current_device.device_info.name);
+        return false;
+    }
+
+    if (!PCI_Enumerate())
+        return false;
+
+    for (uint32_t i = 0; i < pci_devices.count; i++)
+    {
+        pci_device_entry_t* entry = &pci_devices.entries[i];
+
+        if ((entry->class_code >> 8) != PCI_CLASS_HOST_BRIDGE
+        || !PCI_SnapshotCapture(&agp_state.bridge, entry->bus_number, entry->function_number))
+            continue;
+
+        agp_state.bridge_capability = PCI_FindCapability(&agp_state.bridge, PCI_CAP_ID_AGP);
+
+        if (agp_state.bridge_capability)
+            break;
+    }
+
+    if (!agp_state.bridge_capability)
+    {
+        Logging_Write(log_level_warning, "AGP: no host bridge with an AGP capability\n");
+        return false;
+    }
+
+    agp_state.bridge_status = PCI_Snapshot32(&agp_state.bridge, agp_state.bridge_capability + PCI_AGP_OFFSET_STATUS);
+    agp_state.device_status = PCI_Snapshot32(device, agp_state.device_capability + PCI_AGP_OFFSET_STATUS);
+    agp_state.original_bridge_command = PCI_Snapshot32(&agp_state.bridge, agp_state.bridge_capability + PCI_AGP_OFFSET_COMMAND);
+    agp_state.original_device_command = PCI_Snapshot32(device, agp_state.device_capability + PCI_AGP_OFFSET_COMMAND);
+    agp_state.device = gpu_active_device;
+    agp_state.present = true;
+
+    Logging_Write(log_level_message, "AGP: host bridge %04x:%04x at %02lx:%02lx.%lx, bridge status %08lx, GPU status %08lx, common modes %03lx\n",
+        agp_state.bridge.decoded.vendor_id, agp_state.bridge.decoded.device_id,
+        agp_state.bridge.bus_number, agp_state.bridge.function_number >> 3, agp_state.bridge.function_number & 7,
+        agp_state.bridge_status, agp_state.device_status, AGP_CommonModes());
+
+    return true;
+}
+
+uint32_t AGP_CommonModes()
+{
+    if (!agp_state.present)
+        return 0;
+
+    return agp_state.bridge_status & agp_state.device_status & (PCI_AGP_RATE_MASK | PCI_AGP_FAST_WRITES | PCI_AGP_SIDEBAND);
+}
+
+/*
+    Switch to one rate (PCI_AGP_RATE_*), with or without fast writes and sideband addressing.
+    AGP is turned off on both sides first, then the target is programmed before the master as the spec asks.
+    The master's request depth comes from what the target says it can queue.
+*/
+bool AGP_Configure(uint32_t rate, bool fast_writes, bool sideband)
+{
+    if (!AGP_Init())
+        return false;
+
+    uint32_t common = AGP_CommonModes();
+
+    // exactly one rate bit
+    if (!rate
+    || (rate & (rate - 1))
+    || !(common & rate)
+    || (fast_writes && !(common & PCI_AGP_FAST_WRITES))
+    || (sideband && !(common & PCI_AGP_SIDEBAND)))
+    {
+        Logging_Write(log_level_error, "AGP: mode %lux%s%s isn't supported by both sides (common modes %03lx)\n", rate,
+            (fast_writes) ? " FW" : "", (sideband) ? " SBA" : "", common);
+        return false;
+    }
+
+    uint32_t command = rate | PCI_AGP_ENABLE;
+
+    if (fast_writes)
+        command |= PCI_AGP_FAST_WRITES;
+
+    if (sideband)
+        command |= PCI_AGP_SIDEBAND;
+
+    pci_config_snapshot_t* device = &agp_state.device->pci_config;
+
+    agp_state.modified = true;
+
+    AGP_WriteCommand(device, agp_state.device_capability, 0);
+    AGP_WriteCommand(&agp_state.bridge, agp_state.bridge_capability, 0);
+    AGP_WriteCommand(&agp_state.bridge, agp_state.bridge_capability, command);
+    AGP_WriteCommand(device, agp_state.device_capability, command | (agp_state.bridge_status & PCI_AGP_RQ_MASK));
+
+    uint32_t readback = PCI_Snapshot32(device, agp_state.device_capability + PCI_AGP_OFFSET_COMMAND);
+
+    if ((readback & (PCI_AGP_RATE_MASK | PCI_AGP_ENABLE)) != (rate | PCI_AGP_ENABLE))
+    {
+        Logging_Write(log_level_error, "AGP: GPU didn't take command %08lx (reads back %08lx)\n", command, readback);
+        return false;
+    }
+
+    Logging_Write(log_level_debug, "AGP: now %lux%s%s\n", rate, (fast_writes) ? " FW" : "", (sideband) ? " SBA" : "");
+    return true;
+}
+
+/* Put back whatever the BIOS had set up */
+void AGP_Restore()
+{
+    if (!agp_state.present
+    || !agp_state.modified)
+        return;
+
+    pci_config_snapshot_t* device = &agp_state.device->pci_config;
+
+    AGP_WriteCommand(device, agp_state.device_capability, 0);
+    AGP_WriteCommand(&agp_state.bridge, agp_state.bridge_capability, 0);
+    AGP_WriteCommand(&agp_state.bridge, agp_state.bridge_capability, agp_state.original_bridge_command);
+    AGP_WriteCommand(device, agp_state.device_capability, agp_state.original_device_command);
+
+    agp_state.modified = false;
+    Logging_Write(log_level_debug, "AGP: restored command %08lx\n", agp_state.original_device_command);
+}
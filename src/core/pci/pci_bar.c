@@ -0,0 +1,244 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    pci_bar.c: BAR sizing and exact-size physical mappings
+*/
+
+#include "gpuplay.h"
+#include "util/util.h"
+#include <core/trace/gpu_trace.h>
+
+#include <stdint.h>
+
+#ifdef __DJGPP__
+#include "dos.h"
+#include "dpmi.h"
+#endif
+
+/*
+    Write probe_value to a BAR and see which address bits stuck, then put the original back.
+    Decoding is switched off meanwhile so the device never answers at the all-ones address, and interrupts are off
+    so nothing gets to touch the device while it isn't decoding. Only the raw config cycles go inside that window;
+    the journal, trace and snapshot are dealt with on either side of it.
+*/
+static uint32_t PCI_ProbeBarRegister(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t probe_value, uint32_t* original)
+{
+    *original = PCI_ReadConfig32(bus_number, function_number, offset);
+    uint16_t command = PCI_ReadConfig16(bus_number, function_number, PCI_CFG_OFFSET_COMMAND);
+    uint16_t decode = PCI_CFG_OFFSET_COMMAND_IO_ENABLED | PCI_CFG_OFFSET_COMMAND_MEM_ENABLED;
+    uint32_t readback = 0;
+
+    // nothing else can get at the simulated config space, so the wrappers are fine there
+    if (gpu_io_backend->pci_read32)
+    {
+        if (command & decode)
+            PCI_WriteConfig16(bus_number, function_number, PCI_CFG_OFFSET_COMMAND, command & ~decode);
+
+        PCI_WriteConfig32(bus_number, function_number, offset, probe_value);
+        readback = PCI_ReadConfig32(bus_number, function_number, offset);
+        PCI_WriteConfig32(bus_number, function_number, offset, *original);
+
+        if (command & decode)
+            PCI_WriteConfig16(bus_number, function_number, PCI_CFG_OFFSET_COMMAND, command);
+
+        return readback;
+    }
+
+    if (command & decode)
+        PCI_JournalRecord(bus_number, function_number, PCI_CFG_OFFSET_COMMAND);
+
+    PCI_JournalRecord(bus_number, function_number, offset);
+
+#ifdef __DJGPP__
+    int interrupts_were_enabled = disable();
+#endif
+
+    if (command & decode)
+        PCI_HardwareWrite(bus_number, function_number, PCI_CFG_OFFSET_COMMAND, 2, command & ~decode);
+
+    PCI_HardwareWrite(bus_number, function_number, offset, 4, probe_value);
+
+    // a refused read counts as nothing writable
+    if (!PCI_HardwareRead(bus_number, function_number, offset, 4, &readback))
+        readback = 0;
+
+    PCI_HardwareWrite(bus_number, function_number, offset, 4, *original);
+
+    if (command & decode)
+        PCI_HardwareWrite(bus_number, function_number, PCI_CFG_OFFSET_COMMAND, 2, command);
+
+#ifdef __DJGPP__
+    if (interrupts_were_enabled)
+        enable();
+#endif
+
+    if (command & decode)
+        GPU_TRACE(trace_op_pci_write, 2, PCI_TRACE_ADDRESS(bus_number, function_number, PCI_CFG_OFFSET_COMMAND), command & ~decode);
+
+    GPU_TRACE(trace_op_pci_write, 4, PCI_TRACE_ADDRESS(bus_number, function_number, offset), probe_value);
+    GPU_TRACE(trace_op_pci_read, 4, PCI_TRACE_ADDRESS(bus_number, function_number, offset), readback);
+    GPU_TRACE(trace_op_pci_write, 4, PCI_TRACE_ADDRESS(bus_number, function_number, offset), *original);
+
+    if (command & decode)
+        GPU_TRACE(trace_op_pci_write, 2, PCI_TRACE_ADDRESS(bus_number, function_number, PCI_CFG_OFFSET_COMMAND), command);
+
+    // what the wrappers would have done after each write
+    if (command & decode)
+        PCI_SnapshotRefresh(bus_number, function_number, PCI_CFG_OFFSET_COMMAND);
+
+    PCI_SnapshotRefresh(bus_number, function_number, offset);
+    return readback;
+}
+
+/* Size one BAR the way the spec says to: write all ones and see what comes back */
+bool PCI_ProbeBar(uint32_t bus_number, uint32_t function_number, uint32_t bar, pci_bar_t* info)
+{
+    uint32_t offset = PCI_CFG_OFFSET_BAR0 + (bar << 2);
+
+    memset(info, 0, sizeof(pci_bar_t));
+
+    if (bar >= PCI_NUM_BARS)
+        return false;
+
+    uint32_t original;
+    uint32_t readback = PCI_ProbeBarRegister(bus_number, function_number, offset, 0xFFFFFFFF, &original);
+
+    // nothing writable: BAR not implemented
+    if (!readback
+    || readback == 0xFFFFFFFF)
+        return false;
+
+    info->io = (readback & PCI_BAR_IO);
+
+    if (info->io)
+    {
+        // I/O BARs are allowed to leave the top 16 bits reading as zero
+        info->base = original & PCI_BAR_IO_ADDRESS_MASK;
+        info->size = ~((readback & PCI_BAR_IO_ADDRESS_MASK) | 0xFFFF0000) + 1;
+    }
+    else
+    {
+        info->base = original & PCI_BAR_MEM_ADDRESS_MASK;
+        info->size = ~(readback & PCI_BAR_MEM_ADDRESS_MASK) + 1;
+        info->prefetchable = (readback & PCI_BAR_MEM_PREFETCHABLE);
+        info->is_64bit = ((readback & PCI_BAR_MEM_TYPE_MASK) == PCI_BAR_MEM_TYPE_64);
+    }
+
+    return (info->size != 0);
+}
+
+/* The expansion ROM BAR has its own layout: enable bit in bit 0, and at least 2KB of address bits below the size */
+bool PCI_ProbeRomBar(uint32_t bus_number, uint32_t function_number, pci_bar_t* info)
+{
+    memset(info, 0, sizeof(pci_bar_t));
+
+    // probe with the enable bit clear, so the ROM never decodes at the all-ones address
+    uint32_t original;
+    uint32_t readback = PCI_ProbeBarRegister(bus_number, function_number, PCI_CFG_OFFSET_EXPANSION_ROM_BASE, PCI_ROM_BAR_ADDRESS_MASK, &original)
+        & PCI_ROM_BAR_ADDRESS_MASK;
+
+    if (!readback)
+        return false;
+
+    info->base = original & PCI_ROM_BAR_ADDRESS_MASK;
+    info->size = ~readback + 1;
+    return true;
+}
+
+/* Size every BAR on a type-0 function. Returns how many are implemented */
+uint32_t PCI_ProbeBars(uint32_t bus_number, uint32_t function_number, pci_bar_t* bars)
+{
+    uint32_t num_present = 0;
+
+    for (uint32_t bar = 0; bar < PCI_NUM_BARS; bar++)
+    {
+        if (!PCI_ProbeBar(bus_number, function_number, bar, &bars[bar]))
+            continue;
+
+        num_present++;
+
+        Logging_Write(log_level_debug, "PCI BAR%lu: %s %08lx, %lu KB%s%s\n", bar, (bars[bar].io) ? "I/O" : "memory",
+            bars[bar].base, bars[bar].size >> 10, (bars[bar].prefetchable) ? ", prefetchable" : "", (bars[bar].is_64bit) ? ", 64-bit" : "");
+
+        // we only ever map below 4GB, so the upper half just gets skipped
+        if (bars[bar].is_64bit
+        && bar + 1 < PCI_NUM_BARS)
+            memset(&bars[++bar], 0, sizeof(pci_bar_t));
+    }
+
+    return num_present;
+}
+
+#ifdef __DJGPP__
+
+/*
+    Map a memory BAR at exactly the size it decodes and give it a selector with a matching limit.
+    Returns the selector, or 0 if it couldn't be mapped. linear_address can be NULL
+*/
+int32_t PCI_MapBar(const pci_bar_t* bar, uint32_t* linear_address)
+{
+    if (!bar->size
+    || bar->io)
+        return 0;
+
+    __dpmi_meminfo meminfo = {0};
+
+    meminfo.address = bar->base;
+    meminfo.size = bar->size;
+
+    if (__dpmi_physical_address_mapping(&meminfo) == -1)
+    {
+        Logging_Write(log_level_error, "Failed to map %lu KB at physical address %08lx\n", bar->size >> 10, bar->base);
+        return 0;
+    }
+
+    int32_t selector = __dpmi_allocate_ldt_descriptors(1);
+
+    if (selector == -1)
+    {
+        Logging_Write(log_level_error, "Failed to allocate a selector for physical address %08lx\n", bar->base);
+        __dpmi_free_physical_address_mapping(&meminfo);
+        return 0;
+    }
+
+    __dpmi_set_segment_base_address(selector, meminfo.address);
+    __dpmi_set_segment_limit(selector, bar->size - 1);
+
+    if (linear_address)
+        *linear_address = meminfo.address;
+
+    return selector;
+}
+
+/* Undo PCI_MapBar */
+void PCI_UnmapBar(int32_t selector, uint32_t linear_address)
+{
+    __dpmi_meminfo meminfo = {0};
+
+    if (selector)
+        __dpmi_free_ldt_descriptor(selector);
+
+    meminfo.address = linear_address;
+
+    if (linear_address)
+        __dpmi_free_physical_address_mapping(&meminfo);
+}
+
+#else
+
+// No physical mappings outside DOS
+int32_t PCI_MapBar(const pci_bar_t* bar, uint32_t* linear_address)
+{
+    Logging_Write(log_level_error, "BARs can only be mapped under DOS\n");
+    return 0;
+}
+
+void PCI_UnmapBar(int32_t selector, uint32_t linear_address)
+{
+}
+
+#endif
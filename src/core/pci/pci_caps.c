@@ -0,0 +1,106 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    pci_caps.c: Capability list walker, with decoding for the capabilities these cards have (AGP, PM, MSI)
+*/
+
+#include "gpuplay.h"
+#include "util/util.h"
+
+#include <stdint.h>
+
+/* Follow CAPABILITIES_PTR through the snapshot. Returns how many capabilities were found */
+uint32_t PCI_WalkCapabilities(const pci_config_snapshot_t* snapshot, pci_capability_t* capabilities, uint32_t max_capabilities)
+{
+    if (!snapshot->valid
+    || !(snapshot->decoded.status & PCI_CFG_OFFSET_STATUS_CAPABILITIES))
+        return 0;
+
+    uint32_t count = 0;
+    uint8_t offset = snapshot->decoded.capabilities_ptr & PCI_CAP_POINTER_MASK;
+
+    // a broken list can point back at itself, so give up after as many entries as could possibly fit
+    for (uint32_t walked = 0; walked < PCI_MAX_CAPABILITIES && count < max_capabilities; walked++)
+    {
+        if (offset < PCI_CAP_MIN_OFFSET)
+            break;
+
+        capabilities[count].id = PCI_Snapshot8(snapshot, offset + PCI_CAP_OFFSET_ID);
+        capabilities[count].offset = offset;
+        count++;
+
+        offset = PCI_Snapshot8(snapshot, offset + PCI_CAP_OFFSET_NEXT) & PCI_CAP_POINTER_MASK;
+    }
+
+    return count;
+}
+
+/* Offset of the first capability with this ID, or 0 */
+uint8_t PCI_FindCapability(const pci_config_snapshot_t* snapshot, uint8_t id)
+{
+    pci_capability_t capabilities[PCI_MAX_CAPABILITIES];
+    uint32_t count = PCI_WalkCapabilities(snapshot, capabilities, PCI_MAX_CAPABILITIES);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (capabilities[i].id == id)
+            return capabilities[i].offset;
+    }
+
+    return 0;
+}
+
+static void PCI_PrintAGPModes(const char* name, uint32_t value)
+{
+    Logging_Write(log_level_message, "[PCI CAP]   %s %08lx:%s%s%s%s%s%s, RQ %lu\n", name, value,
+        (value & PCI_AGP_RATE_1X) ? " 1x" : "", (value & PCI_AGP_RATE_2X) ? " 2x" : "", (value & PCI_AGP_RATE_4X) ? " 4x" : "",
+        (value & PCI_AGP_FAST_WRITES) ? " FW" : "", (value & PCI_AGP_SIDEBAND) ? " SBA" : "", (value & PCI_AGP_ENABLE) ? " enabled" : "",
+        ((value & PCI_AGP_RQ_MASK) >> PCI_AGP_RQ_SHIFT) + 1);
+}
+
+void PCI_PrintCapabilities(const pci_config_snapshot_t* snapshot)
+{
+    pci_capability_t capabilities[PCI_MAX_CAPABILITIES];
+    uint32_t count = PCI_WalkCapabilities(snapshot, capabilities, PCI_MAX_CAPABILITIES);
+
+    if (!count)
+    {
+        Logging_Write(log_level_message, "[PCI CAP] No capabilities\n");
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint8_t offset = capabilities[i].offset;
+        uint16_t control = 0;
+        uint8_t version = 0;
+
+        switch (capabilities[i].id)
+        {
+            case PCI_CAP_ID_PM:
+                Logging_Write(log_level_message, "[PCI CAP] %02x: Power Management, PMC %04x, state D%d\n", offset,
+                    PCI_Snapshot16(snapshot, offset + PCI_PM_OFFSET_PMC), PCI_Snapshot16(snapshot, offset + PCI_PM_OFFSET_PMCSR) & PCI_PM_PMCSR_STATE_MASK);
+                break;
+            case PCI_CAP_ID_AGP:
+                version = PCI_Snapshot8(snapshot, offset + PCI_AGP_OFFSET_VERSION);
+                Logging_Write(log_level_message, "[PCI CAP] %02x: AGP %d.%d\n", offset, version >> 4, version & 0x0F);
+                PCI_PrintAGPModes("Status ", PCI_Snapshot32(snapshot, offset + PCI_AGP_OFFSET_STATUS));
+                PCI_PrintAGPModes("Command", PCI_Snapshot32(snapshot, offset + PCI_AGP_OFFSET_COMMAND));
+                break;
+            case PCI_CAP_ID_MSI:
+                control = PCI_Snapshot16(snapshot, offset + PCI_MSI_OFFSET_CONTROL);
+                Logging_Write(log_level_message, "[PCI CAP] %02x: MSI, %s, %d vectors requested, %s addresses\n", offset,
+                    (control & PCI_MSI_CONTROL_ENABLE) ? "enabled" : "disabled",
+                    1 << ((control >> PCI_MSI_CONTROL_MMC_SHIFT) & PCI_MSI_CONTROL_MMC_MASK),
+                    (control & PCI_MSI_CONTROL_64BIT) ? "64-bit" : "32-bit");
+                break;
+            default:
+                Logging_Write(log_level_message, "[PCI CAP] %02x: ID %02x\n", offset, capabilities[i].id);
+                break;
+        }
+    }
+}
@@ -0,0 +1,135 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    pci_enum.c: Enumerates every PCI function once into a table that detection (and -list) work from
+*/
+
+#include "gpuplay.h"
+#include "util/util.h"
+
+#include <stdint.h>
+
+pci_device_table_t pci_devices = {0};
+
+/* Read the parts of the header we keep for one function */
+static void PCI_EnumerateFunction(uint32_t bus_number, uint32_t function_number, uint16_t vendor_id)
+{
+    if (pci_devices.count >= PCI_MAX_DEVICES)
+    {
+        Logging_Write(log_level_warning, "More than %d PCI functions, ignoring %02lx:%02lx.%lx\n",
+            PCI_MAX_DEVICES, bus_number, function_number >> 3, function_number & 7);
+        return;
+    }
+
+    pci_device_entry_t* entry = &pci_devices.entries[pci_devices.count++];
+    uint32_t class_revision = PCI_ReadConfig32(bus_number, function_number, PCI_CFG_OFFSET_REVISION);
+
+    entry->bus_number = bus_number;
+    entry->function_number = function_number;
+    entry->vendor_id = vendor_id;
+    entry->device_id = PCI_ReadConfig16(bus_number, function_number, PCI_CFG_OFFSET_DEVICE_ID);
+    entry->revision = class_revision & 0xFF;
+    entry->class_code = class_revision >> 8;
+    entry->header_type = PCI_ReadConfig8(bus_number, function_number, PCI_CFG_OFFSET_HEADER_TYPE);
+
+    // bridges only have two BARs, the rest of that space is bus numbers and windows
+    uint32_t num_bars = ((entry->header_type & PCI_HEADER_TYPE_MASK) == PCI_HEADER_TYPE_BRIDGE) ? 2 :
+        ((entry->header_type & PCI_HEADER_TYPE_MASK) == PCI_HEADER_TYPE_NORMAL) ? PCI_NUM_BARS : 0;
+
+    for (uint32_t bar = 0; bar < num_bars; bar++)
+        entry->bars[bar] = PCI_ReadConfig32(bus_number, function_number, PCI_CFG_OFFSET_BAR0 + (bar << 2));
+}
+
+/* Walk every bus/device/function once. Later calls do nothing */
+bool PCI_Enumerate()
+{
+    if (pci_devices.enumerated)
+        return true;
+
+    pci_devices.count = 0;
+
+    // the simulated backend has a single device, and it answers at every address
+    uint32_t last_bus = (gpu_io_backend->pci_read32) ? 0 : pci_last_bus;
+    uint32_t last_device = (gpu_io_backend->pci_read32) ? 0 : PCI_MAX_DEVICE_NUMBER;
+
+    for (uint32_t bus_number = 0; bus_number <= last_bus; bus_number++)
+    {
+        for (uint32_t device = 0; device <= last_device; device++)
+        {
+            for (uint32_t function = 0; function < PCI_MAX_FUNCTIONS; function++)
+            {
+                uint32_t function_number = (device << 3) | function;
+                uint16_t vendor_id = PCI_ReadConfig16(bus_number, function_number, PCI_CFG_OFFSET_VENDOR_ID);
+
+                if (vendor_id == 0xFFFF
+                || vendor_id == 0x0000)
+                {
+                    // no function 0 means no device
+                    if (!function)
+                        break;
+
+                    continue;
+                }
+
+                PCI_EnumerateFunction(bus_number, function_number, vendor_id);
+
+                // only multi-function devices have anything past function 0
+                if (!function
+                && !(pci_devices.entries[pci_devices.count - 1].header_type & PCI_HEADER_TYPE_MULTI_FUNCTION))
+                    break;
+            }
+        }
+    }
+
+    pci_devices.enumerated = true;
+    Logging_Write(log_level_debug, "PCI enumeration found %lu functions on %lu buses\n", pci_devices.count, last_bus + 1);
+    return true;
+}
+
+/* Find the nth function in the table with this vendor and device ID */
+pci_device_entry_t* PCI_FindDevice(uint32_t vendor_id, uint32_t device_id, uint32_t index)
+{
+    for (uint32_t i = 0; i < pci_devices.count; i++)
+    {
+        if (pci_devices.entries[i].vendor_id == vendor_id
+        && pci_devices.entries[i].device_id == device_id
+        && !index--)
+            return &pci_devices.entries[i];
+    }
+
+    return NULL;
+}
+
+/* Print the table. Functions GPUPlay supports get their name next to them */
+void PCI_PrintDeviceTable()
+{
+    PCI_Enumerate();
+
+    Logging_Write(log_level_message, "PCI devices (%lu functions):\n", pci_devices.count);
+    Logging_Write(log_level_message, "Bus:Dv.F Vend:Dev  Class    Rev Hdr BARs\n");
+
+    for (uint32_t i = 0; i < pci_devices.count; i++)
+    {
+        pci_device_entry_t* entry = &pci_devices.entries[i];
+        const char* name = "";
+
+        for (uint32_t device = 0; supported_devices[device].vendor_id; device++)
+        {
+            if (supported_devices[device].vendor_id == entry->vendor_id
+            && supported_devices[device].device_id == entry->device_id)
+                name = supported_devices[device].name;
+        }
+
+        Logging_Write(log_level_message, " %02x:%02x.%x %04x:%04x %02lx.%02lx.%02lx %02x  %02x  %08lx %08lx %08lx %08lx %08lx %08lx %s\n",
+            entry->bus_number, entry->function_number >> 3, entry->function_number & 7,
+            entry->vendor_id, entry->device_id,
+            entry->class_code >> 16, (entry->class_code >> 8) & 0xFF, entry->class_code & 0xFF,
+            entry->revision, entry->header_type,
+            entry->bars[0], entry->bars[1], entry->bars[2], entry->bars[3], entry->bars[4], entry->bars[5],
+            name);
+    }
+}
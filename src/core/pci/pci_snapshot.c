@@ -0,0 +1,195 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    pci_snapshot.c: Whole config space snapshots, so dumps and tests don't go back to the bus for every field
+*/
+
+#include "gpuplay.h"
+#include "util/util.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Pull the type-0 header fields out of the raw image */
+static void PCI_SnapshotDecode(pci_config_snapshot_t* snapshot)
+{
+    pci_config_decoded_t* decoded = &snapshot->decoded;
+
+    decoded->vendor_id = PCI_Snapshot16(snapshot, PCI_CFG_OFFSET_VENDOR_ID);
+    decoded->device_id = PCI_Snapshot16(snapshot, PCI_CFG_OFFSET_DEVICE_ID);
+    decoded->command = PCI_Snapshot16(snapshot, PCI_CFG_OFFSET_COMMAND);
+    decoded->status = PCI_Snapshot16(snapshot, PCI_CFG_OFFSET_STATUS);
+    decoded->revision = PCI_Snapshot8(snapshot, PCI_CFG_OFFSET_REVISION);
+    decoded->class_code = PCI_Snapshot32(snapshot, PCI_CFG_OFFSET_REVISION) >> 8;
+    decoded->cache_line_size = PCI_Snapshot8(snapshot, PCI_CFG_OFFSET_CACHE_LINE_SIZE);
+    decoded->latency_timer = PCI_Snapshot8(snapshot, PCI_CFG_OFFSET_LATENCY_TIMER);
+    decoded->header_type = PCI_Snapshot8(snapshot, PCI_CFG_OFFSET_HEADER_TYPE);
+    decoded->bist = PCI_Snapshot8(snapshot, PCI_CFG_OFFSET_BIST);
+
+    for (uint32_t bar = 0; bar < PCI_NUM_BARS; bar++)
+        decoded->bars[bar] = PCI_Snapshot32(snapshot, PCI_CFG_OFFSET_BAR0 + (bar << 2));
+
+    decoded->cardbus_cis_ptr = PCI_Snapshot32(snapshot, PCI_CFG_OFFSET_CARDBUS_CIS_PTR);
+    decoded->subsystem_vendor_id = PCI_Snapshot16(snapshot, PCI_CFG_OFFSET_SUBSYSTEM_VENDOR_ID);
+    decoded->subsystem_id = PCI_Snapshot16(snapshot, PCI_CFG_OFFSET_SUBSYSTEM_ID);
+    decoded->rom_bar = PCI_Snapshot32(snapshot, PCI_CFG_OFFSET_EXPANSION_ROM_BASE);
+    decoded->capabilities_ptr = PCI_Snapshot8(snapshot, PCI_CFG_OFFSET_CAPABILITIES_PTR);
+    decoded->interrupt_line = PCI_Snapshot8(snapshot, PCI_CFG_OFFSET_INTERRUPT_LINE);
+    decoded->interrupt_pin = PCI_Snapshot8(snapshot, PCI_CFG_OFFSET_INTERRUPT_PIN);
+    decoded->minimum_grant = PCI_Snapshot8(snapshot, PCI_CFG_OFFSET_MINIMUM_GRANT);
+    decoded->maximum_latency = PCI_Snapshot8(snapshot, PCI_CFG_OFFSET_MAXIMUM_LATENCY);
+}
+
+/* Read all 256 bytes as 64 dwords. Whatever mechanism is selected, dword reads are the cheapest per byte */
+bool PCI_SnapshotCapture(pci_config_snapshot_t* snapshot, uint32_t bus_number, uint32_t function_number)
+{
+    snapshot->bus_number = bus_number;
+    snapshot->function_number = function_number;
+
+    for (uint32_t dword = 0; dword < (PCI_CONFIG_SPACE_SIZE >> 2); dword++)
+        snapshot->dwords[dword] = PCI_ReadConfig32(bus_number, function_number, dword << 2);
+
+    PCI_SnapshotDecode(snapshot);
+
+    // nothing answered
+    snapshot->valid = (snapshot->decoded.vendor_id != 0xFFFF);
+    return snapshot->valid;
+}
+
+pci_config_snapshot_t* PCI_CurrentConfig()
+{
+    pci_config_snapshot_t* snapshot = &current_device.pci_config;
+
+    if (!snapshot->valid
+    || snapshot->bus_number != current_device.bus_number
+    || snapshot->function_number != current_device.function_number)
+        PCI_SnapshotCapture(snapshot, current_device.bus_number, current_device.function_number);
+
+    return snapshot;
+}
+
+/* Called after every config write. Re-reads the one dword rather than trusting the written value, since read-only bits won't have changed */
+void PCI_SnapshotRefresh(uint32_t bus_number, uint32_t function_number, uint32_t offset)
+{
+    if (offset >= PCI_CONFIG_SPACE_SIZE)
+        return;
+
+    // the write might be for any of the GPUs, not just the active one
+    for (uint32_t device = 0; device < GPU_MAX_DEVICES; device++)
+    {
+        pci_config_snapshot_t* snapshot = &gpu_devices[device].pci_config;
+
+        if (!snapshot->valid
+        || snapshot->bus_number != bus_number
+        || snapshot->function_number != function_number)
+            continue;
+
+        snapshot->dwords[offset >> 2] = PCI_ReadConfig32(bus_number, function_number, offset & ~3);
+        PCI_SnapshotDecode(snapshot);
+        return;
+    }
+}
+
+void PCI_SnapshotPrint(const pci_config_snapshot_t* snapshot)
+{
+    const pci_config_decoded_t* decoded = &snapshot->decoded;
+
+    Logging_Write(log_level_message, "[PCI CFG] PCI ID %04x:%04x (bus %02lx device %02lx function %lx)\n", decoded->vendor_id, decoded->device_id,
+        snapshot->bus_number, snapshot->function_number >> 3, snapshot->function_number & 7);
+    Logging_Write(log_level_message, "[PCI CFG] Command Register %04x\n", decoded->command);
+    Logging_Write(log_level_message, "[PCI CFG] Status Register %04x\n", decoded->status);
+    Logging_Write(log_level_message, "[PCI CFG] Revision %02x\n", decoded->revision);
+    Logging_Write(log_level_message, "[PCI CFG] Class ID: %06lx\n", decoded->class_code);
+    Logging_Write(log_level_message, "[PCI CFG] Cache Line Size %02x\n", decoded->cache_line_size);
+    Logging_Write(log_level_message, "[PCI CFG] Latency Timer %02x\n", decoded->latency_timer);
+    Logging_Write(log_level_message, "[PCI CFG] Header Type %02x (should be 0)\n", decoded->header_type);
+    Logging_Write(log_level_message, "[PCI CFG] BIST %02x\n", decoded->bist);
+
+    for (uint32_t bar = 0; bar < PCI_NUM_BARS; bar++)
+        Logging_Write(log_level_message, "[PCI CFG] BAR%lu %08lx\n", bar, decoded->bars[bar]);
+
+    Logging_Write(log_level_message, "[PCI CFG] CardBus CIS Pointer %08lx\n", decoded->cardbus_cis_ptr);
+    Logging_Write(log_level_message, "[PCI CFG] Subsystem ID %04x:%04x\n", decoded->subsystem_vendor_id, decoded->subsystem_id);
+    Logging_Write(log_level_message, "[PCI CFG] ROM BAR %08lx\n", decoded->rom_bar);
+    Logging_Write(log_level_message, "[PCI CFG] Capabilities Pointer %02x\n", decoded->capabilities_ptr);
+    Logging_Write(log_level_message, "[PCI CFG] Interrupt Line %02x\n", decoded->interrupt_line);
+    Logging_Write(log_level_message, "[PCI CFG] Interrupt Pin %02x\n", decoded->interrupt_pin);
+    Logging_Write(log_level_message, "[PCI CFG] Minimum Grant %02x\n", decoded->minimum_grant);
+    Logging_Write(log_level_message, "[PCI CFG] Maximum Latency %02x\n", decoded->maximum_latency);
+
+    // the rest (capabilities, vendor-specific registers) only makes sense raw
+    for (uint32_t offset = 0; offset < PCI_CONFIG_SPACE_SIZE; offset += 0x10)
+    {
+        Logging_Write(log_level_debug, "[PCI CFG] %02lx: %08lx %08lx %08lx %08lx\n", offset,
+            PCI_Snapshot32(snapshot, offset), PCI_Snapshot32(snapshot, offset + 4),
+            PCI_Snapshot32(snapshot, offset + 8), PCI_Snapshot32(snapshot, offset + 12));
+    }
+}
+
+/* The raw 256 bytes and nothing else, so two runs can be compared with any binary diff tool */
+bool PCI_SnapshotSave(const pci_config_snapshot_t* snapshot, const char* file_name)
+{
+    FILE* stream = fopen(file_name, "wb");
+
+    if (!stream)
+    {
+        Logging_Write(log_level_error, "Failed to open %s for writing\n", file_name);
+        return false;
+    }
+
+    bool success = (fwrite(snapshot->bytes, PCI_CONFIG_SPACE_SIZE, 1, stream) == 1);
+    fclose(stream);
+
+    if (!success)
+        Logging_Write(log_level_error, "Failed to write PCI config snapshot to %s\n", file_name);
+
+    return success;
+}
+
+bool PCI_SnapshotLoad(pci_config_snapshot_t* snapshot, const char* file_name)
+{
+    FILE* stream = fopen(file_name, "rb");
+
+    if (!stream)
+        return false;
+
+    snapshot->valid = (fread(snapshot->bytes, PCI_CONFIG_SPACE_SIZE, 1, stream) == 1);
+    fclose(stream);
+
+    // where it came from isn't recorded in the file
+    snapshot->bus_number = snapshot->function_number = 0;
+
+    if (snapshot->valid)
+        PCI_SnapshotDecode(snapshot);
+
+    return snapshot->valid;
+}
+
+/* Log every dword that differs. Returns the number of bytes that changed */
+uint32_t PCI_SnapshotCompare(const pci_config_snapshot_t* before, const pci_config_snapshot_t* after)
+{
+    uint32_t changed = 0;
+
+    for (uint32_t offset = 0; offset < PCI_CONFIG_SPACE_SIZE; offset += 4)
+    {
+        uint32_t old_value = PCI_Snapshot32(before, offset);
+        uint32_t new_value = PCI_Snapshot32(after, offset);
+
+        if (old_value == new_value)
+            continue;
+
+        for (uint32_t byte = 0; byte < 4; byte++)
+        {
+            if (before->bytes[offset + byte] != after->bytes[offset + byte])
+                changed++;
+        }
+
+        Logging_Write(log_level_message, "[PCI CFG] %02lx: %08lx -> %08lx\n", offset, old_value, new_value);
+    }
+
+    return changed;
+}
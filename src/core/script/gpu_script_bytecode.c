@@ -0,0 +1,723 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_script_bytecode.c: Compiles scripts to a packed instruction stream and caches it next to the source.
+    Register and VRAM writes run straight from the stream. Everything else keeps its text and goes through Script_RunCommand
+
+    Blocks are compiled to jumps:
+        for <variable> <start> <end> [step] ... end      <end> is exclusive, step can be negative (e.g. -1)
+        repeat <count> ... end
+        if <condition> ... [else ...] end               <condition> is the rest of the line, e.g. if $x == 5
+*/
+
+#include "util/util.h"
+#include <gpuplay.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+
+#define SCRIPT_BYTECODE_INITIAL_SIZE    0x1000
+
+// Access size of each opcode
+static const uint8_t script_opcode_widths[] =
+{
+	0,      // script_op_text
+	1,      // script_op_write_mmio8
+	4,      // script_op_write_mmio32
+	1,      // script_op_write_vram8
+	2,      // script_op_write_vram16
+	4,      // script_op_write_vram32
+	0,      // script_op_flush
+	0,      // script_op_barrier
+	0,      // script_op_for
+	0,      // script_op_repeat
+	0,      // script_op_next
+	0,      // script_op_if
+	0,      // script_op_jump
+};
+
+// A block that hasn't seen its end yet
+typedef struct script_block_s
+{
+	gpu_script_opcode opcode;		// for/repeat/if, or jump once an if has seen its else
+	uint32_t offset;				// Of the instruction whose address gets filled in at the end
+	uint32_t line;
+} script_block_t;
+
+// A loop that is running
+typedef struct script_loop_s
+{
+	uint32_t* variable;				// NULL for repeat
+	uint32_t end;
+	int32_t step;
+	uint32_t remaining;				// repeat
+	const uint8_t* body;
+} script_loop_t;
+
+typedef struct script_emitter_s
+{
+	uint8_t* code;
+	uint32_t size;
+	uint32_t capacity;
+	uint32_t num_instructions;
+	uint32_t line;
+	script_block_t blocks[GPU_SCRIPT_MAX_DEPTH];
+	uint32_t num_blocks;
+} script_emitter_t;
+
+static bool Script_CompileError(script_emitter_t* emitter, const char* fmt, ...)
+{
+	char message[MAX_STR];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(message, sizeof(message), fmt, ap);
+	va_end(ap);
+
+	Logging_Write(log_level_error, "Script line %lu: %s\n", emitter->line, message);
+	return false;
+}
+
+static bool Script_Emit(script_emitter_t* emitter, gpu_script_instruction_t* instruction, const char* text)
+{
+	uint32_t text_length = (text) ? strlen(text) + 1 : 0;
+
+	instruction->text_size = (text_length + 3) & ~3;
+
+	uint32_t size = sizeof(gpu_script_instruction_t) + instruction->text_size;
+
+	if (emitter->size + size > emitter->capacity)
+	{
+		uint32_t capacity = emitter->capacity * 2;
+		uint8_t* code = realloc(emitter->code, capacity);
+
+		if (!code)
+		{
+			Logging_Write(log_level_error, "Out of memory compiling script (%lu bytes so far)\n", emitter->size);
+			return false;
+		}
+
+		emitter->code = code;
+		emitter->capacity = capacity;
+	}
+
+	uint8_t* destination = emitter->code + emitter->size;
+
+	memcpy(destination, instruction, sizeof(gpu_script_instruction_t));
+	memset(destination + sizeof(gpu_script_instruction_t), 0, instruction->text_size);
+
+	if (text)
+		memcpy(destination + sizeof(gpu_script_instruction_t), text, text_length);
+
+	emitter->size += size;
+	emitter->num_instructions++;
+	return true;
+}
+
+static void Script_PatchAddress(script_emitter_t* emitter, uint32_t offset, uint32_t address)
+{
+	((gpu_script_instruction_t*)(emitter->code + offset))->address = address;
+}
+
+/* for, repeat and if keep their text; the bounds and condition are evaluated when they run */
+static bool Script_CompileBlockStart(script_emitter_t* emitter, gpu_script_args_t* args, gpu_script_opcode opcode)
+{
+	uint32_t num_parameters = (opcode == script_op_for) ? 3 : 1;
+
+	if (args->argc - 1 < num_parameters)
+		return Script_CompileError(emitter, "%s needs at least %lu parameter(s)", args->argv[0], num_parameters);
+
+	// the condition of an if is the rest of the line, but each loop bound is one argument. "for i 0 $n - 1" would quietly lose the "- 1"
+	if (opcode == script_op_for
+	&& args->argc - 1 > 4)
+		return Script_CompileError(emitter, "for takes <variable> <start> <end> [step]. Put expressions in parentheses, e.g. for i 0 ($n - 1)");
+
+	if (opcode == script_op_repeat
+	&& args->argc - 1 > 1)
+		return Script_CompileError(emitter, "repeat takes one count. Put an expression in parentheses, e.g. repeat ($n * 2)");
+
+	if (opcode == script_op_for
+	&& !Script_IsVariableName(args->argv[1]))
+		return Script_CompileError(emitter, "%s isn't a valid variable name", args->argv[1]);
+
+	if (emitter->num_blocks >= GPU_SCRIPT_MAX_DEPTH)
+		return Script_CompileError(emitter, "blocks nested more than %d deep", GPU_SCRIPT_MAX_DEPTH);
+
+	script_block_t* block = &emitter->blocks[emitter->num_blocks++];
+	gpu_script_instruction_t instruction = {0};
+
+	block->opcode = opcode;
+	block->offset = emitter->size;
+	block->line = emitter->line;
+
+	instruction.opcode = opcode;
+	return Script_Emit(emitter, &instruction, args->text);
+}
+
+static bool Script_CompileElse(script_emitter_t* emitter)
+{
+	if (!emitter->num_blocks
+	|| emitter->blocks[emitter->num_blocks - 1].opcode != script_op_if)
+		return Script_CompileError(emitter, "else without an if");
+
+	script_block_t* block = &emitter->blocks[emitter->num_blocks - 1];
+
+	// the end of the if part skips the else part, and a false condition lands just after that
+	gpu_script_instruction_t instruction = { .opcode = script_op_jump };
+	uint32_t jump_offset = emitter->size;
+
+	if (!Script_Emit(emitter, &instruction, NULL))
+		return false;
+
+	Script_PatchAddress(emitter, block->offset, emitter->size);
+
+	block->opcode = script_op_jump;
+	block->offset = jump_offset;
+	return true;
+}
+
+static bool Script_CompileEnd(script_emitter_t* emitter)
+{
+	if (!emitter->num_blocks)
+		return Script_CompileError(emitter, "end without a for, repeat or if");
+
+	script_block_t* block = &emitter->blocks[--emitter->num_blocks];
+
+	if (block->opcode == script_op_for
+	|| block->opcode == script_op_repeat)
+	{
+		gpu_script_instruction_t instruction = { .opcode = script_op_next };
+
+		if (!Script_Emit(emitter, &instruction, NULL))
+			return false;
+	}
+
+	// a loop that doesn't run at all, a false if, or the end of an if part all go to just after the block
+	Script_PatchAddress(emitter, block->offset, emitter->size);
+	return true;
+}
+
+/* One line. Blank lines and comments produce nothing */
+static bool Script_CompileLine(script_emitter_t* emitter, const char* line)
+{
+	gpu_script_args_t args;
+
+	if (!Script_Tokenize(line, &args)
+	|| !strncmp(args.argv[0], "//", 2))
+		return true;
+
+	const char* keyword = args.argv[0];
+
+	if (!strcmp(keyword, "for"))
+		return Script_CompileBlockStart(emitter, &args, script_op_for);
+	else if (!strcmp(keyword, "repeat"))
+		return Script_CompileBlockStart(emitter, &args, script_op_repeat);
+	else if (!strcmp(keyword, "if"))
+		return Script_CompileBlockStart(emitter, &args, script_op_if);
+	else if (!strcmp(keyword, "else"))
+		return Script_CompileElse(emitter);
+	else if (!strcmp(keyword, "end"))
+		return Script_CompileEnd(emitter);
+
+	gpu_script_instruction_t instruction = {0};
+	gpu_script_command_t* command = Script_FindCommand(keyword);
+
+	// only lines that would certainly have run get an opcode; the rest fail at run time with the usual messages.
+	// $variables change while the script runs, but an (expression) of constants can be worked out now
+	bool compiled = (command
+		&& command->opcode != script_op_text
+		&& command->function
+		&& args.argc - 1 >= command->num_parameters
+		&& !strchr(args.text, '$')
+		&& Script_EvaluateArgs(&args));
+
+	for (uint32_t parameter = 1; compiled && parameter <= command->num_parameters; parameter++)
+	{
+		if (!args.is_number[parameter])
+			compiled = false;
+	}
+
+	if (!compiled)
+		return Script_Emit(emitter, &instruction, args.text);
+
+	instruction.opcode = command->opcode;
+	instruction.width = script_opcode_widths[command->opcode];
+	instruction.address = (args.argc > 1) ? args.values[1] : 0;
+	instruction.value = (args.argc > 2) ? args.values[2] : 0;
+	return Script_Emit(emitter, &instruction, NULL);
+}
+
+/* Returns a malloc'd instruction stream, or NULL if we ran out of memory or the blocks don't match up */
+uint8_t* Script_Compile(const char* source, uint32_t source_size, uint32_t* code_size, uint32_t* num_instructions)
+{
+	script_emitter_t emitter = {0};
+	const char* end = source + source_size;
+	char line[MAX_STR];
+
+	// allocated up front so an empty script is still a valid (empty) stream
+	emitter.capacity = SCRIPT_BYTECODE_INITIAL_SIZE;
+	emitter.code = malloc(emitter.capacity);
+
+	if (!emitter.code)
+	{
+		Logging_Write(log_level_error, "Out of memory compiling script\n");
+		return NULL;
+	}
+
+	for (const char* str = source; str < end; )
+	{
+		const char* line_end = memchr(str, '\n', end - str);
+		uint32_t length = ((line_end) ? line_end : end) - str;
+
+		// same limit fgets had
+		if (length > MAX_STR - 1)
+			length = MAX_STR - 1;
+
+		memcpy(line, str, length);
+		line[length] = '\0';
+		emitter.line++;
+
+		if (!Script_CompileLine(&emitter, line))
+		{
+			free(emitter.code);
+			return NULL;
+		}
+
+		str = (line_end) ? line_end + 1 : end;
+	}
+
+	if (emitter.num_blocks)
+	{
+		script_block_t* block = &emitter.blocks[emitter.num_blocks - 1];
+
+		emitter.line = block->line;
+		Script_CompileError(&emitter, "block has no end");
+		free(emitter.code);
+		return NULL;
+	}
+
+	*code_size = emitter.size;
+	*num_instructions = emitter.num_instructions;
+	return emitter.code;
+}
+
+static bool script_abort = false;
+
+/* For commands whose failure makes the rest of the script pointless, like a wait that timed out */
+void Script_Abort()
+{
+	script_abort = true;
+}
+
+/* The interpreter loop. No strings are touched unless an instruction is text */
+bool Script_Execute(const uint8_t* code, uint32_t code_size)
+{
+	const uint8_t* end = code + code_size;
+	const uint8_t* ip = code;
+	script_loop_t loops[GPU_SCRIPT_MAX_DEPTH];
+	uint32_t num_loops = 0;
+
+	script_abort = false;
+
+	while (ip + sizeof(gpu_script_instruction_t) <= end)
+	{
+		const gpu_script_instruction_t* instruction = (const gpu_script_instruction_t*)ip;
+		ip += sizeof(gpu_script_instruction_t) + instruction->text_size;
+
+		switch (instruction->opcode)
+		{
+			case script_op_write_mmio8:
+				mmio_write8(instruction->address, instruction->value);
+				break;
+			case script_op_write_mmio32:
+				mmio_write32(instruction->address, instruction->value);
+				break;
+			case script_op_write_vram8:
+				nv_dfb_write8(instruction->address, instruction->value);
+				break;
+			case script_op_write_vram16:
+				nv_dfb_write16(instruction->address, instruction->value);
+				break;
+			case script_op_write_vram32:
+				nv_dfb_write32(instruction->address, instruction->value);
+				break;
+			case script_op_flush:
+				GPU_FlushWrites();
+				break;
+			case script_op_barrier:
+				GPU_WriteBarrier();
+				break;
+			case script_op_for:
+			case script_op_repeat:
+			{
+				// the bounds are worked out once, when the loop starts
+				const char* text = (const char*)(instruction + 1);
+				script_loop_t* loop = &loops[num_loops];
+				gpu_script_args_t args;
+				bool runs;
+
+				if (num_loops >= GPU_SCRIPT_MAX_DEPTH
+				|| !Script_Tokenize(text, &args)
+				|| !Script_EvaluateArgs(&args))
+				{
+					Logging_Write(log_level_error, "Can't start %s, stopping\n", text);
+					return false;
+				}
+
+				if (instruction->opcode == script_op_for)
+				{
+					loop->variable = Script_GetVariable(args.argv[1], true);
+					loop->end = args.values[3];
+					loop->step = (args.argc > 4) ? (int32_t)args.values[4] : 1;
+
+					if (!loop->variable
+					|| !loop->step)
+					{
+						Logging_Write(log_level_error, "Can't start %s, stopping\n", text);
+						return false;
+					}
+
+					*loop->variable = args.values[2];
+					runs = (loop->step > 0) ? (*loop->variable < loop->end) : (*loop->variable > loop->end);
+				}
+				else
+				{
+					loop->variable = NULL;
+					loop->remaining = args.values[1];
+					runs = (loop->remaining != 0);
+				}
+
+				if (!runs)
+				{
+					ip = code + instruction->address;
+					break;
+				}
+
+				loop->body = ip;
+				num_loops++;
+				break;
+			}
+			case script_op_next:
+			{
+				// the compiler never emits one outside a loop, but the cache could be damaged
+				if (!num_loops)
+				{
+					Logging_Write(log_level_error, "Script loop end without a loop at %lu, stopping\n", (uint32_t)((const uint8_t*)instruction - code));
+					return false;
+				}
+
+				script_loop_t* loop = &loops[num_loops - 1];
+				bool again;
+
+				if (loop->variable)
+				{
+					*loop->variable += loop->step;
+					again = (loop->step > 0) ? (*loop->variable < loop->end) : (*loop->variable > loop->end);
+				}
+				else
+					again = (--loop->remaining != 0);
+
+				if (again)
+					ip = loop->body;
+				else
+					num_loops--;
+
+				break;
+			}
+			case script_op_if:
+			{
+				// everything after the if is one expression, so "if $x == 5" means what it says
+				const char* text = (const char*)(instruction + 1);
+				gpu_script_args_t args;
+				uint32_t condition = 0;
+
+				if (!Script_Tokenize(text, &args)
+				|| !Script_Evaluate(Script_ArgvRest(&args, 1), &condition))
+				{
+					Logging_Write(log_level_error, "Can't evaluate %s, stopping\n", text);
+					return false;
+				}
+
+				if (!condition)
+					ip = code + instruction->address;
+
+				break;
+			}
+			case script_op_jump:
+				ip = code + instruction->address;
+				break;
+			case script_op_text:
+			{
+				// Script_RunCommand trims in place, so it gets a copy
+				char line_buf[MAX_STR];
+
+				strncpy(line_buf, (const char*)(instruction + 1), MAX_STR - 1);
+				line_buf[MAX_STR - 1] = '\0';
+				Script_RunCommand(line_buf);
+
+				// only a command can ask to stop
+				if (script_abort)
+				{
+					Logging_Write(log_level_error, "Stopping the script after %s\n", (const char*)(instruction + 1));
+					return false;
+				}
+
+				break;
+			}
+			default:
+				Logging_Write(log_level_error, "Bad script opcode %02x at %lu, stopping\n", instruction->opcode, (uint32_t)((const uint8_t*)instruction - code));
+				return false;
+		}
+	}
+
+	return true;
+}
+
+/* Changes to the command table (a new opcode, a renamed command) change how a script compiles */
+static uint32_t Script_CommandsCRC32()
+{
+	uint32_t crc = 0;
+
+	for (gpu_script_command_t* command = commands; command->name_abbrev; command++)
+	{
+		uint8_t opcode = command->opcode;
+
+		crc = Hash_CRC32(crc, command->name_abbrev, strlen(command->name_abbrev) + 1);
+		crc = Hash_CRC32(crc, command->name_full, strlen(command->name_full) + 1);
+		crc = Hash_CRC32(crc, &command->num_parameters, sizeof(command->num_parameters));
+		crc = Hash_CRC32(crc, &opcode, 1);
+	}
+
+	return crc;
+}
+
+/* foo.nvp -> foo.nvc, in the same directory */
+static void Script_CachePath(char* path, const char* file_name)
+{
+	strncpy(path, file_name, MAX_STR - 1);
+	path[MAX_STR - 1] = '\0';
+
+	char* extension = strrchr(path, '.');
+
+	if (extension
+	&& (strchr(extension, '\\') || strchr(extension, '/')))
+		extension = NULL;
+
+	if (!extension)
+		extension = path + strlen(path);
+
+	snprintf(extension, MAX_STR - (extension - path), "%s", GPU_SCRIPT_BYTECODE_EXTENSION);
+}
+
+static inline bool Script_OpcodeHasText(uint8_t opcode)
+{
+	return (opcode == script_op_text
+		|| opcode == script_op_for
+		|| opcode == script_op_repeat
+		|| opcode == script_op_if);
+}
+
+static inline bool Script_OpcodeJumps(uint8_t opcode)
+{
+	return (opcode == script_op_for
+		|| opcode == script_op_repeat
+		|| opcode == script_op_if
+		|| opcode == script_op_jump);
+}
+
+/*
+    Script_Execute trusts the stream completely, so a cache has to pass this first. Every instruction fits in the stream, text is NUL terminated
+    inside its instruction, and every jump lands on an instruction (or exactly at the end, which is how a block at the end of the script ends)
+*/
+static bool Script_ValidateCode(const uint8_t* code, uint32_t code_size)
+{
+	// instructions and their text are padded to 4, so one flag per dword marks where they start
+	uint8_t* starts = calloc((code_size >> 2) + 1, 1);
+	bool valid = true;
+
+	if (!starts)
+		return false;
+
+	for (uint32_t offset = 0; valid && offset < code_size; )
+	{
+		const gpu_script_instruction_t* instruction = (const gpu_script_instruction_t*)(code + offset);
+		const char* text = (const char*)(instruction + 1);
+
+		valid = ((offset & 3) == 0
+			&& code_size - offset >= sizeof(gpu_script_instruction_t)
+			&& instruction->opcode < script_op_count
+			&& code_size - offset - sizeof(gpu_script_instruction_t) >= instruction->text_size
+			&& (!Script_OpcodeHasText(instruction->opcode)
+				|| (instruction->text_size && memchr(text, '\0', instruction->text_size))));
+
+		if (!valid)
+			break;
+
+		starts[offset >> 2] = 1;
+		offset += sizeof(gpu_script_instruction_t) + instruction->text_size;
+	}
+
+	starts[code_size >> 2] = 1;
+
+	for (uint32_t offset = 0; valid && offset < code_size; )
+	{
+		const gpu_script_instruction_t* instruction = (const gpu_script_instruction_t*)(code + offset);
+
+		if (Script_OpcodeJumps(instruction->opcode)
+		&& (instruction->address > code_size
+			|| (instruction->address & 3)
+			|| !starts[instruction->address >> 2]))
+			valid = false;
+
+		offset += sizeof(gpu_script_instruction_t) + instruction->text_size;
+	}
+
+	free(starts);
+	return valid;
+}
+
+static uint8_t* Script_LoadCache(const char* path, const gpu_script_bytecode_header_t* expected, uint32_t* code_size)
+{
+	gpu_script_bytecode_header_t header = {0};
+	FILE* stream = fopen(path, "rb");
+
+	if (!stream)
+		return NULL;
+
+	if (fread(&header, sizeof(header), 1, stream) != 1
+	|| header.magic != GPU_SCRIPT_BYTECODE_MAGIC
+	|| header.version != GPU_SCRIPT_BYTECODE_VERSION
+	|| header.source_size != expected->source_size
+	|| header.source_mtime != expected->source_mtime
+	|| header.source_crc32 != expected->source_crc32
+	|| header.commands_crc32 != expected->commands_crc32)
+	{
+		fclose(stream);
+		return NULL;
+	}
+
+	// the header has to describe exactly what follows it, or the file was cut short (or is something else)
+	long code_start = ftell(stream);
+
+	if (fseek(stream, 0, SEEK_END)
+	|| ftell(stream) - code_start != (long)header.code_size
+	|| fseek(stream, code_start, SEEK_SET))
+	{
+		Logging_Write(log_level_warning, "Compiled script %s is the wrong size, recompiling\n", path);
+		fclose(stream);
+		return NULL;
+	}
+
+	uint8_t* code = malloc(header.code_size + 1);
+
+	if (!code
+	|| (header.code_size && fread(code, header.code_size, 1, stream) != 1))
+	{
+		free(code);
+		fclose(stream);
+		return NULL;
+	}
+
+	fclose(stream);
+
+	if (!Script_ValidateCode(code, header.code_size))
+	{
+		Logging_Write(log_level_warning, "Compiled script %s is damaged, recompiling\n", path);
+		free(code);
+		return NULL;
+	}
+
+	Logging_Write(log_level_debug, "Using compiled script %s (%lu instructions)\n", path, header.num_instructions);
+	*code_size = header.code_size;
+	return code;
+}
+
+static void Script_SaveCache(const char* path, gpu_script_bytecode_header_t* header, const uint8_t* code)
+{
+	FILE* stream = fopen(path, "wb");
+
+	// not fatal, it'll just be compiled again next time (read-only media, for example)
+	if (!stream)
+	{
+		Logging_Write(log_level_warning, "Couldn't write compiled script cache %s\n", path);
+		return;
+	}
+
+	bool success = (fwrite(header, sizeof(gpu_script_bytecode_header_t), 1, stream) == 1
+		&& (!header->code_size || fwrite(code, header->code_size, 1, stream) == 1));
+
+	fclose(stream);
+
+	if (!success)
+	{
+		Logging_Write(log_level_warning, "Failed to write compiled script cache %s\n", path);
+		remove(path);
+	}
+}
+
+uint8_t* Script_LoadCompiled(const char* file_name, uint32_t* code_size)
+{
+	struct stat source_stat;
+	FILE* stream = fopen(file_name, "rb");
+
+	if (!stream
+	|| stat(file_name, &source_stat))
+	{
+		if (stream)
+			fclose(stream);
+
+		Logging_Write(log_level_error, "Couldn't open script file %s\n", file_name);
+		return NULL;
+	}
+
+	char* source = malloc(source_stat.st_size + 1);
+
+	if (!source
+	|| (source_stat.st_size && fread(source, source_stat.st_size, 1, stream) != 1))
+	{
+		Logging_Write(log_level_error, "Couldn't read script file %s\n", file_name);
+		free(source);
+		fclose(stream);
+		return NULL;
+	}
+
+	fclose(stream);
+
+	gpu_script_bytecode_header_t header = {0};
+	char cache_path[MAX_STR];
+
+	header.magic = GPU_SCRIPT_BYTECODE_MAGIC;
+	header.version = GPU_SCRIPT_BYTECODE_VERSION;
+	header.source_size = source_stat.st_size;
+	header.source_mtime = source_stat.st_mtime;
+	header.source_crc32 = Hash_CRC32(0, source, source_stat.st_size);
+	header.commands_crc32 = Script_CommandsCRC32();
+
+	Script_CachePath(cache_path, file_name);
+
+	uint8_t* code = Script_LoadCache(cache_path, &header, code_size);
+
+	if (code)
+	{
+		free(source);
+		return code;
+	}
+
+	code = Script_Compile(source, header.source_size, &header.code_size, &header.num_instructions);
+	free(source);
+
+	if (!code)
+	{
+		Logging_Write(log_level_error, "Couldn't compile script file %s\n", file_name);
+		return NULL;
+	}
+
+	Logging_Write(log_level_message, "Compiled %s: %lu instructions (%lu bytes), cached as %s\n", file_name, header.num_instructions, header.code_size, cache_path);
+
+	Script_SaveCache(cache_path, &header, code);
+	*code_size = header.code_size;
+	return code;
+}
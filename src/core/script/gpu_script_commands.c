@@ -7,8 +7,8 @@
 
     gpu_script_commands.c: Implements the commands for the GPUScript parser
     Currently a basic command system with no real lexer or parser.
-    Basically, you can't read anything because that would require somewhere to put i.e. variables = a full interpreted language. Not yet. So the stopgap is that we at least allow to print to the console (which doesn't have any side effects requiring a variable system)
-    Although I might add a basic variable system to read to one of 10 variables as an intermediate step
+    Reads can go into variables (rm32 status 0x400100), which any argument can then use as $status, or in an expression like ($status & 1).
+    Loops and ifs are handled by the compiler (see gpu_script_bytecode.c)
     
     HEX notation only. Because it's easier...
 */
@@ -20,25 +20,25 @@
 #include "util/util.h"
 #include <gpuplay.h>
 #include <config/config.h>
+#include <core/timing/gpu_timing.h>
 #include <stdlib.h>
 
-// bad
-char** cmd_endptr;
+#define SCRIPT_TIMER_DEPTH          8           // How many timebegin blocks can be nested
 
-bool Command_WriteMMIO8()
+bool Command_WriteMMIO8(gpu_script_args_t* args)
 {
-    uint32_t offset = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(2), cmd_endptr, 16);
+    uint32_t offset = args->values[1];
+    uint32_t value = args->values[2];
 
     mmio_write8(offset, value);
     return true; 
 }
 
-bool Command_WriteMMIORange8()
+bool Command_WriteMMIORange8(gpu_script_args_t* args)
 {
-    uint32_t offset_start = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t offset_end = strtol(Command_Argv(2), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(3), cmd_endptr, 16);
+    uint32_t offset_start = args->values[1];
+    uint32_t offset_end = args->values[2];
+    uint32_t value = args->values[3];
 
     for (uint32_t offset = offset_start; offset < offset_end; offset++)
     {
@@ -48,64 +48,115 @@ bool Command_WriteMMIORange8()
     return true; 
 }
 
-bool Command_ReadMMIOConsole8()
+bool Command_ReadMMIOConsole8(gpu_script_args_t* args)
 {
-    uint32_t offset = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(2), cmd_endptr, 16);
+    uint32_t offset = args->values[1];
+    uint32_t value = args->values[2];
 
     Logging_Write(log_level_message, "Command_ReadMMIOConsole8: %02x = %02x\n", offset, value);
     return true; 
 }
 
 
-bool Command_WriteMMIO32()
+bool Command_WriteMMIO32(gpu_script_args_t* args)
 {
-    uint32_t offset = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(2), cmd_endptr, 16);
+    uint32_t offset = args->values[1];
+    uint32_t value = args->values[2];
  
-    Logging_Write(log_level_debug, "Command_WriteMMIO32 %s:%08x %s:%08x\n", Command_Argv(1), offset, Command_Argv(2), value);
+    Logging_Write(log_level_debug, "Command_WriteMMIO32 %s:%08x %s:%08x\n", args->argv[1], offset, args->argv[2], value);
 
     mmio_write32(offset, value);
     return true; 
 }
 
-bool Command_ReadMMIOConsole32()
+bool Command_ReadMMIOConsole32(gpu_script_args_t* args)
 {
-    uint32_t offset = strtol(Command_Argv(1), cmd_endptr, 16);
+    uint32_t offset = args->values[1];
     uint32_t value = mmio_read32(offset);
 
     Logging_Write(log_level_message, "Command_ReadMMIOConsole32: %08x = %08x\n", offset, value);
     return true; 
 }
 
-bool Command_WriteMMIORange32()
+bool Command_WriteMMIORange32(gpu_script_args_t* args)
 {
-    uint32_t offset_start = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t offset_end = strtol(Command_Argv(2), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(3), cmd_endptr, 16);
+    uint32_t offset_start = args->values[1];
+    uint32_t offset_end = args->values[2];
+    uint32_t value = args->values[3];
 
-    for (uint32_t offset = offset_start; offset < offset_end; offset += 4)
+    if (offset_end > offset_start)
+        mmio_fill32(offset_start, value, (offset_end - offset_start + 3) & ~3);
+
+    return true; 
+}
+
+// rmw32 <offset> <mask> <value>: replace the bits in mask. Non-readable (shadowed) registers don't get read from the bus
+bool Command_ReadModifyWriteMMIO32(gpu_script_args_t* args)
+{
+    uint32_t offset = args->values[1];
+    uint32_t mask = args->values[2];
+    uint32_t value = args->values[3];
+
+    uint32_t new_value = mmio_rmw32(offset, mask, value);
+
+    Logging_Write(log_level_debug, "Command_ReadModifyWriteMMIO32: %08x = %08x\n", offset, new_value);
+    return true; 
+}
+
+// shadow <offset> [end]: mark registers as non-readable, so reads come from the last value written
+bool Command_ShadowMMIO(gpu_script_args_t* args)
+{
+    uint32_t offset_start = args->values[1];
+    uint32_t offset_end = (args->argc > 2) ? args->values[2] : offset_start + 4;
+
+    if (offset_end <= offset_start)
+        return false; 
+
+    GPU_ShadowMark(gpu_shadow_space_mmio, offset_start, offset_end - offset_start, true);
+    return true; 
+}
+
+bool Command_UnshadowMMIO(gpu_script_args_t* args)
+{
+    uint32_t offset_start = args->values[1];
+    uint32_t offset_end = (args->argc > 2) ? args->values[2] : offset_start + 4;
+
+    if (offset_end <= offset_start)
+        return false; 
+
+    GPU_ShadowMark(gpu_shadow_space_mmio, offset_start, offset_end - offset_start, false);
+    return true; 
+}
+
+bool Command_ReadShadowConsole32(gpu_script_args_t* args)
+{
+    uint32_t offset = args->values[1];
+    uint32_t value = 0;
+
+    if (!GPU_ShadowGet(gpu_shadow_space_mmio, offset, &value))
     {
-        mmio_write32(offset, value);
+        Logging_Write(log_level_message, "Command_ReadShadowConsole32: %08x = (unknown)\n", offset);
+        return true; 
     }
 
+    Logging_Write(log_level_message, "Command_ReadShadowConsole32: %08x = %08x\n", offset, value);
     return true; 
 }
 
-bool Command_WriteVRAM8()
+bool Command_WriteVRAM8(gpu_script_args_t* args)
 {
-    uint32_t offset = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(2), cmd_endptr, 16);
+    uint32_t offset = args->values[1];
+    uint32_t value = args->values[2];
 
     nv_dfb_write8(offset, value);
     return true; 
 }
 
-bool Command_WriteVRAMRange8()
+bool Command_WriteVRAMRange8(gpu_script_args_t* args)
 {
-    uint32_t offset_start = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t offset_end = strtol(Command_Argv(2), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(3), cmd_endptr, 16);
+    uint32_t offset_start = args->values[1];
+    uint32_t offset_end = args->values[2];
+    uint32_t value = args->values[3];
 
     for (uint32_t offset = offset_start; offset < offset_end; offset++)
     {
@@ -115,29 +166,29 @@ bool Command_WriteVRAMRange8()
     return true; 
 }
 
-bool Command_ReadVRAMConsole8()
+bool Command_ReadVRAMConsole8(gpu_script_args_t* args)
 {
-    uint32_t offset = strtol(Command_Argv(1), cmd_endptr, 16);
+    uint32_t offset = args->values[1];
     uint8_t value = nv_dfb_read8(offset);
 
     Logging_Write(log_level_message, "Command_ReadVRAMConsole8: %03x = %02x\n", offset, value);
     return true; 
 }
 
-bool Command_WriteVRAM16()
+bool Command_WriteVRAM16(gpu_script_args_t* args)
 {
-    uint32_t offset = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(2), cmd_endptr, 16);
+    uint32_t offset = args->values[1];
+    uint32_t value = args->values[2];
 
     nv_dfb_write16(offset, value);
     return true; 
 }
 
-bool Command_WriteVRAMRange16()
+bool Command_WriteVRAMRange16(gpu_script_args_t* args)
 {
-    uint32_t offset_start = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t offset_end = strtol(Command_Argv(2), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(3), cmd_endptr, 16);
+    uint32_t offset_start = args->values[1];
+    uint32_t offset_end = args->values[2];
+    uint32_t value = args->values[3];
 
     for (uint32_t offset = offset_start; offset < offset_end; offset += 2)
     {
@@ -147,81 +198,79 @@ bool Command_WriteVRAMRange16()
     return true; 
 }
 
-bool Command_ReadVRAMConsole16()
+bool Command_ReadVRAMConsole16(gpu_script_args_t* args)
 {
-    uint32_t offset = strtol(Command_Argv(1), cmd_endptr, 16);
+    uint32_t offset = args->values[1];
     uint16_t value = nv_dfb_read16(offset);
 
     Logging_Write(log_level_message, "Command_ReadVRAMConsole16: %04x = %04x\n", offset, value);
     return true; 
 }
 
-bool Command_WriteVRAM32()
+bool Command_WriteVRAM32(gpu_script_args_t* args)
 {   
-    uint32_t offset = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(2), cmd_endptr, 16);
+    uint32_t offset = args->values[1];
+    uint32_t value = args->values[2];
 
     nv_dfb_write32(offset, value);    
     return true; 
 }
 
-bool Command_WriteVRAMRange32()
+bool Command_WriteVRAMRange32(gpu_script_args_t* args)
 {
-    uint32_t offset_start = strtol(Command_Argv(1), cmd_endptr, 16);
-    uint32_t offset_end = strtol(Command_Argv(2), cmd_endptr, 16);
-    uint32_t value = strtol(Command_Argv(3), cmd_endptr, 16);
+    uint32_t offset_start = args->values[1];
+    uint32_t offset_end = args->values[2];
+    uint32_t value = args->values[3];
 
-    for (uint32_t offset = offset_start; offset < offset_end; offset += 4)
-    {
-        nv_dfb_write32(offset, value);
-    }
+    if (offset_end > offset_start)
+        nv_dfb_fill32(offset_start, value, (offset_end - offset_start + 3) & ~3);
     
     return true; 
 }
 
-bool Command_ReadVRAMConsole32()
+bool Command_ReadVRAMConsole32(gpu_script_args_t* args)
 {
-    uint32_t offset = strtol(Command_Argv(1), cmd_endptr, 16);
+    uint32_t offset = args->values[1];
     uint32_t value = nv_dfb_read32(offset);
 
     Logging_Write(log_level_message, "Command_ReadVRAMConsole32: %08x = %08x\n", offset, value);
     return true; 
 }
 
-bool Command_WriteRamin32()
+bool Command_WriteRamin32(gpu_script_args_t* args)
 {
     Logging_Write(log_level_warning, "RAMIN functions not available for this GPU architecture\n");
     return false; 
 }
 
-bool Command_WriteRaminRange32()
+bool Command_WriteRaminRange32(gpu_script_args_t* args)
 {
     Logging_Write(log_level_warning, "RAMIN functions not available for this GPU architecture\n");
     return false; 
 }
 
-bool Command_ReadRaminConsole32()
+bool Command_ReadRaminConsole32(gpu_script_args_t* args)
 {
     Logging_Write(log_level_warning, "RAMIN functions not available for this GPU architecture\n");
     return false; 
 } 
 
-bool Command_ReadCrtcConsole()
+bool Command_ReadCrtcConsole(gpu_script_args_t* args)
 {
     Logging_Write(log_level_warning, "CRTC functions not available for this GPU architecture\n");
     return false; 
 }
 
-bool Command_WriteCrtc()
+bool Command_WriteCrtc(gpu_script_args_t* args)
 {
     Logging_Write(log_level_warning, "CRTC functions not available for this GPU architecture\n");
     return false; 
 }
 
 
-bool Command_RunTest()
+bool Command_RunTest(gpu_script_args_t* args)
 {
-    const char* test_name = Command_Argv(1);
+    const char* test_name = args->argv[1];
 
     nv_config_test_entry_t* test = Test_Get(test_name);
 
@@ -236,35 +285,206 @@ bool Command_RunTest()
     return false; //shutup compiler even though this line cannot be reached under any circumstances
 }
 
+// <offset> <mask> <value> <timeout in us>. base is added to offset (e.g. an I/O BAR). A timeout stops the script
+bool Script_Wait32(gpu_script_args_t* args, gpu_poll_space space, uint32_t base)
+{
+    uint32_t offset = base + args->values[1];
+    uint32_t mask = args->values[2];
+    uint32_t match = args->values[3];
+    uint32_t timeout_us = args->values[4];
+    gpu_poll_result_t result;
+
+    if (match & ~mask)
+        Logging_Write(log_level_warning, "%s: value %08x has bits outside mask %08x, it can never match\n", args->argv[0], match, mask);
+
+    if (!GPU_Poll32(space, offset, mask, match, Timing_MicrosecondsToCycles(timeout_us), &result))
+    {
+        Logging_Write(log_level_error, "%s %08x: timed out after %lu us (%lu reads), last value %08x, wanted (value & %08x) == %08x\n",
+            args->argv[0], offset, timeout_us, result.iterations, result.value, mask, match);
+
+        Script_Abort();
+        return false; 
+    }
+
+    Logging_Write(log_level_message, "%s %08x: %08x after %lu reads, %llu cycles (%.3f us)\n",
+        args->argv[0], offset, result.value, result.iterations, result.cycles, Timing_CyclesToNs(result.cycles) / 1000.0);
+    return true; 
+}
+
+bool Command_WaitMMIO32(gpu_script_args_t* args)
+{
+    return Script_Wait32(args, gpu_poll_space_mmio, 0);
+}
+
+bool Command_WaitVRAM32(gpu_script_args_t* args)
+{
+    return Script_Wait32(args, gpu_poll_space_dfb, 0);
+}
+
+// set <variable> <value>
+bool Command_Set(gpu_script_args_t* args)
+{
+    uint32_t* variable = Script_GetVariable(args->argv[1], true);
+
+    if (!variable)
+        return false; 
+
+    *variable = args->values[2];
+    return true; 
+}
+
+// rm8/rm32/rv8/rv16/rv32 <variable> <offset>: read into a variable instead of the console
+static bool Command_ReadToVariable(gpu_script_args_t* args, uint32_t value)
+{
+    uint32_t* variable = Script_GetVariable(args->argv[1], true);
+
+    if (!variable)
+        return false; 
+
+    *variable = value;
+    Logging_Write(log_level_debug, "%s: %s = %08x\n", args->argv[0], args->argv[1], value);
+    return true; 
+}
+
+bool Command_ReadMMIO8(gpu_script_args_t* args)
+{
+    return Command_ReadToVariable(args, mmio_read8(args->values[2]));
+}
+
+bool Command_ReadMMIO32(gpu_script_args_t* args)
+{
+    return Command_ReadToVariable(args, mmio_read32(args->values[2]));
+}
+
+bool Command_ReadVRAM8(gpu_script_args_t* args)
+{
+    return Command_ReadToVariable(args, nv_dfb_read8(args->values[2]));
+}
+
+bool Command_ReadVRAM16(gpu_script_args_t* args)
+{
+    return Command_ReadToVariable(args, nv_dfb_read16(args->values[2]));
+}
+
+bool Command_ReadVRAM32(gpu_script_args_t* args)
+{
+    return Command_ReadToVariable(args, nv_dfb_read32(args->values[2]));
+}
+
+// Prints each argument and its value, e.g. pv $i ($base + $i * 4)
+bool Command_PrintValues(gpu_script_args_t* args)
+{
+    for (uint32_t argv = 1; argv < args->argc; argv++)
+        Logging_Write(log_level_message, "%s = %08x\n", args->argv[argv], args->values[argv]);
+
+    return true; 
+}
+
 // Prints a message.
-bool Command_Print()
+bool Command_Print(gpu_script_args_t* args)
 {
-    Logging_Write(log_level_message, Command_Argv(1));
+    Logging_Write(log_level_message, args->argv[1]);
     return true; 
 }
 
 // Prints a message on debug builds only.
-bool Command_PrintDebug()
+bool Command_PrintDebug(gpu_script_args_t* args)
 {
-    Logging_Write(log_level_debug, Command_Argv(1));
+    Logging_Write(log_level_debug, args->argv[1]);
     return true; 
 }
 
 // Prints a message on debug builds only.
-bool Command_PrintWarning()
+bool Command_PrintWarning(gpu_script_args_t* args)
 {
-    Logging_Write(log_level_warning, Command_Argv(1));
+    Logging_Write(log_level_warning, args->argv[1]);
     return true; 
 }
 
 // Prints a message on debug builds only.
-bool Command_PrintError()
+bool Command_PrintError(gpu_script_args_t* args)
+{
+    Logging_Write(log_level_error, args->argv[1]);
+    return true; 
+}
+
+// Drains the write queue.
+bool Command_Flush(gpu_script_args_t* args)
+{
+    GPU_FlushWrites();
+    return true; 
+}
+
+// Drains the write queue and waits for the writes to reach the card.
+bool Command_Barrier(gpu_script_args_t* args)
+{
+    GPU_WriteBarrier();
+    return true; 
+}
+
+// timebegin/timeend blocks
+static timing_scope_t script_timers[SCRIPT_TIMER_DEPTH];
+static char script_timer_names[SCRIPT_TIMER_DEPTH][MAX_STR];
+static uint32_t script_timer_depth = 0;
+
+// Starts timing everything up to the matching timeend.
+bool Command_TimeBegin(gpu_script_args_t* args)
+{
+    if (script_timer_depth >= SCRIPT_TIMER_DEPTH)
+    {
+        Logging_Write(log_level_error, "timebegin nested too deeply\n");
+        return false; 
+    }
+
+    // the name is optional
+    const char* name = (args->argc > 1) ? args->argv[1] : "block";
+
+    strncpy(script_timer_names[script_timer_depth], name, MAX_STR - 1);
+    script_timers[script_timer_depth] = Timing_ScopeBegin(script_timer_names[script_timer_depth]);
+    script_timer_depth++;
+    return true; 
+}
+
+bool Command_TimeEnd(gpu_script_args_t* args)
 {
-    Logging_Write(log_level_error, Command_Argv(1));
+    if (!script_timer_depth)
+    {
+        Logging_Write(log_level_error, "timeend without timebegin\n");
+        return false; 
+    }
+
+    GPU_FlushWrites();  // queued writes are part of the block
+    Timing_ScopeEnd(&script_timers[--script_timer_depth]);
+    return true; 
+}
+
+// Runs a command (the rest of the line) count times and prints a histogram of how long each run took.
+bool Command_Time(gpu_script_args_t* args)
+{
+    uint32_t count = args->values[1];
+    char command[MAX_STR] = {0};
+    timing_histogram_t histogram;
+
+    // Script_RunCommand overwrites the current command, so take a copy of what we're running
+    strncpy(command, Script_ArgvRest(args, 2), MAX_STR - 1);
+    Timing_HistogramReset(&histogram, command);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        char line_buf[MAX_STR];
+        strncpy(line_buf, command, MAX_STR);
+
+        uint64_t start = Timing_ReadTSC();
+        Script_RunCommand(line_buf);
+        GPU_FlushWrites();
+        Timing_HistogramAdd(&histogram, Timing_ReadTSC() - start);
+    }
+
+    Timing_HistogramReport(&histogram);
     return true; 
 }
 
-bool Command_PrintVersion()
+bool Command_PrintVersion(gpu_script_args_t* args)
 {
     Logging_Write(log_level_message, APP_SIGNON_STRING);
     return true; 
@@ -273,32 +493,50 @@ bool Command_PrintVersion()
 // Enumerates all supported commands.
 gpu_script_command_t commands[] =
 {    
-    { "wm8", "writemmio8", Command_WriteMMIO8, 2 },
+    { "wm8", "writemmio8", Command_WriteMMIO8, 2, script_op_write_mmio8 },
     { "rmc8", "readmmioconsole8", Command_ReadMMIOConsole8, 3 },
     { "wmrange8", "writemmiorange8", Command_WriteMMIORange8, 2 },
-    { "wm32", "writemmio32", Command_WriteMMIO32, 2},
+    { "wm32", "writemmio32", Command_WriteMMIO32, 2, script_op_write_mmio32 },
     { "wmrange32", "writemmiorange32", Command_WriteMMIORange32, 3 },
     { "rmc32", "readmmioconsole32", Command_ReadMMIOConsole32, 1 },
-    { "wv8", "writevram8", Command_WriteVRAM8, 2 },
+    { "rmw32", "readmodifywritemmio32", Command_ReadModifyWriteMMIO32, 3 },
+    { "wait32", "waitmmio32", Command_WaitMMIO32, 4 },
+    { "shadow", "shadowmmio", Command_ShadowMMIO, 1 },
+    { "unshadow", "unshadowmmio", Command_UnshadowMMIO, 1 },
+    { "rsc32", "readshadowconsole32", Command_ReadShadowConsole32, 1 },
+    { "wv8", "writevram8", Command_WriteVRAM8, 2, script_op_write_vram8 },
     { "rvc8", "readvramconsole8", Command_ReadVRAMConsole8, 1 },
     { "wvrange8", "writevramrange8", Command_WriteVRAMRange8, 3 },
-    { "wv16", "writevram16", Command_WriteVRAM16, 2 },
+    { "wv16", "writevram16", Command_WriteVRAM16, 2, script_op_write_vram16 },
     { "rvc16", "readvramconsole16", Command_ReadVRAMConsole16, 1 },
     { "wvrange16", "writevramrange16", Command_WriteVRAMRange16, 3 },
-    { "wv32", "writevram32", Command_WriteVRAM32, 2 },
-    { "rvc32", "readmmioconsole32", Command_ReadVRAMConsole32, 1 },
-    { "wvrange32", "writevramrange32", Command_WriteMMIORange32, 3 },
+    { "wv32", "writevram32", Command_WriteVRAM32, 2, script_op_write_vram32 },
+    { "rvc32", "readvramconsole32", Command_ReadVRAMConsole32, 1 },
+    { "wvrange32", "writevramrange32", Command_WriteVRAMRange32, 3 },
+    { "waitv32", "waitvram32", Command_WaitVRAM32, 4 },
     { "wr32", "writeramin32", Command_WriteRamin32, 2 },
     { "rrc32", "readraminconsole32", Command_ReadRaminConsole32 },
     { "wrrange32", "writeraminrange32", Command_WriteRaminRange32, 3 },
     { "rcrtcc", "readcrtcconsole", Command_ReadCrtcConsole, 1 },
     { "wcrtc", "writecrtc", Command_WriteCrtc, 2 },
     { "rt", "runtest", Command_RunTest, 1},
+    { "flush", "flushwrites", Command_Flush, 0, script_op_flush },
+    { "barrier", "writebarrier", Command_Barrier, 0, script_op_barrier },
+    { "time", "timecommand", Command_Time, 2 },
+    { "tb", "timebegin", Command_TimeBegin, 0 },
+    { "te", "timeend", Command_TimeEnd, 0 },
     { "print", "printmessage", Command_Print, 1 },
     { "printdebug", "printdebug", Command_PrintDebug, 1 },
     { "printwarning", "printwarning", Command_PrintWarning, 1 },
     { "printerror", "printerror", Command_PrintError, 1 },
     { "printversion", "printversion", Command_PrintVersion, 0 },
+    { "set", "setvariable", Command_Set, 2 },
+    { "rm8", "readmmio8", Command_ReadMMIO8, 2 },
+    { "rm32", "readmmio32", Command_ReadMMIO32, 2 },
+    { "rv8", "readvram8", Command_ReadVRAM8, 2 },
+    { "rv16", "readvram16", Command_ReadVRAM16, 2 },
+    { "rv32", "readvram32", Command_ReadVRAM32, 2 },
+    { "pv", "printvalues", Command_PrintValues, 1 },
     
     { NULL, NULL, NULL},            // Sentinel value for end of list.
 };
\ No newline at end of file
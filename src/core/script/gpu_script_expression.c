@@ -0,0 +1,356 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_script_expression.c: Script variables, and the expressions that use them.
+    Numbers are hex like everywhere else in GPUScript. Operators and precedence are C's, all unsigned 32-bit
+*/
+
+#include "util/util.h"
+#include <gpuplay.h>
+#include <ctype.h>
+
+typedef struct script_variable_s
+{
+	char name[GPU_SCRIPT_VARIABLE_NAME_SIZE];
+	uint32_t value;
+} script_variable_t;
+
+// A fixed table, so the pointers Script_GetVariable hands out (loops keep them) stay valid for the whole run
+static script_variable_t script_variables[GPU_SCRIPT_MAX_VARIABLES];
+static uint32_t script_num_variables = 0;
+
+typedef enum script_operator_e
+{
+	script_operator_logical_or,
+	script_operator_logical_and,
+	script_operator_or,
+	script_operator_xor,
+	script_operator_and,
+	script_operator_equal,
+	script_operator_not_equal,
+	script_operator_less_equal,
+	script_operator_greater_equal,
+	script_operator_shift_left,
+	script_operator_shift_right,
+	script_operator_less,
+	script_operator_greater,
+	script_operator_add,
+	script_operator_subtract,
+	script_operator_multiply,
+	script_operator_divide,
+	script_operator_modulo,
+} script_operator;
+
+typedef struct script_operator_info_s
+{
+	const char* symbol;
+	script_operator operator;
+	uint32_t precedence;		// Higher binds tighter
+} script_operator_info_t;
+
+// Two character operators come before the one character ones they start with
+static const script_operator_info_t script_operators[] =
+{
+	{ "||", script_operator_logical_or, 1 },
+	{ "&&", script_operator_logical_and, 2 },
+	{ "==", script_operator_equal, 6 },
+	{ "!=", script_operator_not_equal, 6 },
+	{ "<=", script_operator_less_equal, 7 },
+	{ ">=", script_operator_greater_equal, 7 },
+	{ "<<", script_operator_shift_left, 8 },
+	{ ">>", script_operator_shift_right, 8 },
+	{ "|", script_operator_or, 3 },
+	{ "^", script_operator_xor, 4 },
+	{ "&", script_operator_and, 5 },
+	{ "<", script_operator_less, 7 },
+	{ ">", script_operator_greater, 7 },
+	{ "+", script_operator_add, 9 },
+	{ "-", script_operator_subtract, 9 },
+	{ "*", script_operator_multiply, 10 },
+	{ "/", script_operator_divide, 10 },
+	{ "%", script_operator_modulo, 10 },
+};
+
+#define SCRIPT_NUM_OPERATORS	(sizeof(script_operators) / sizeof(script_operators[0]))
+
+typedef struct script_expression_s
+{
+	const char* expression;		// The whole thing, for error messages
+	const char* str;
+	bool failed;
+} script_expression_t;
+
+static inline bool Script_IsNameStart(char c)
+{
+	return (isalpha((uint8_t)c) || c == '_');
+}
+
+static inline bool Script_IsNameChar(char c)
+{
+	return (isalnum((uint8_t)c) || c == '_');
+}
+
+bool Script_IsVariableName(const char* name)
+{
+	if (!Script_IsNameStart(*name))
+		return false;
+
+	uint32_t length = 1;
+
+	while (Script_IsNameChar(name[length]))
+		length++;
+
+	return (!name[length] && length < GPU_SCRIPT_VARIABLE_NAME_SIZE);
+}
+
+static script_variable_t* Script_FindVariable(const char* name, uint32_t length)
+{
+	for (uint32_t i = 0; i < script_num_variables; i++)
+	{
+		if (!strncmp(script_variables[i].name, name, length)
+		&& !script_variables[i].name[length])
+			return &script_variables[i];
+	}
+
+	return NULL;
+}
+
+uint32_t* Script_GetVariable(const char* name, bool create)
+{
+	if (!Script_IsVariableName(name))
+	{
+		Logging_Write(log_level_warning, "%s isn't a valid variable name\n", name);
+		return NULL;
+	}
+
+	script_variable_t* variable = Script_FindVariable(name, strlen(name));
+
+	if (variable)
+		return &variable->value;
+
+	if (!create)
+		return NULL;
+
+	if (script_num_variables >= GPU_SCRIPT_MAX_VARIABLES)
+	{
+		Logging_Write(log_level_error, "Too many variables (%d) to add %s\n", GPU_SCRIPT_MAX_VARIABLES, name);
+		return NULL;
+	}
+
+	variable = &script_variables[script_num_variables++];
+	strcpy(variable->name, name);
+	variable->value = 0;
+	return &variable->value;
+}
+
+void Script_ClearVariables()
+{
+	script_num_variables = 0;
+}
+
+static void Script_ExpressionError(script_expression_t* expression, const char* message)
+{
+	// only the first one, the rest are usually knock-on effects
+	if (!expression->failed)
+		Logging_Write(log_level_warning, "Expression %s: %s at \"%s\"\n", expression->expression, message, expression->str);
+
+	expression->failed = true;
+}
+
+static void Script_SkipSpace(script_expression_t* expression)
+{
+	while (isspace((uint8_t)*expression->str))
+		expression->str++;
+}
+
+static uint32_t Script_ParseBinary(script_expression_t* expression, uint32_t min_precedence);
+
+static uint32_t Script_ParseUnary(script_expression_t* expression)
+{
+	Script_SkipSpace(expression);
+
+	char c = *expression->str;
+
+	if (c == '-' || c == '~' || c == '!')
+	{
+		expression->str++;
+
+		uint32_t value = Script_ParseUnary(expression);
+
+		if (c == '-')
+			return -value;
+		else if (c == '~')
+			return ~value;
+
+		return !value;
+	}
+
+	if (c == '(')
+	{
+		expression->str++;
+
+		uint32_t value = Script_ParseBinary(expression, 1);
+
+		Script_SkipSpace(expression);
+
+		if (*expression->str != ')')
+		{
+			Script_ExpressionError(expression, "missing )");
+			return 0;
+		}
+
+		expression->str++;
+		return value;
+	}
+
+	if (c == '$')
+	{
+		const char* name = ++expression->str;
+
+		while (Script_IsNameChar(*expression->str))
+			expression->str++;
+
+		script_variable_t* variable = Script_FindVariable(name, expression->str - name);
+
+		if (!variable)
+		{
+			expression->str = name;
+			Script_ExpressionError(expression, "unknown variable");
+			return 0;
+		}
+
+		return variable->value;
+	}
+
+	if (isxdigit((uint8_t)c))
+	{
+		char* end = NULL;
+		uint32_t value = strtoul(expression->str, &end, 16);
+
+		expression->str = end;
+		return value;
+	}
+
+	Script_ExpressionError(expression, (c) ? "expected a number or variable" : "unexpected end");
+	return 0;
+}
+
+static const script_operator_info_t* Script_MatchOperator(const char* str)
+{
+	for (uint32_t i = 0; i < SCRIPT_NUM_OPERATORS; i++)
+	{
+		if (!strncmp(str, script_operators[i].symbol, strlen(script_operators[i].symbol)))
+			return &script_operators[i];
+	}
+
+	return NULL;
+}
+
+/* Precedence climbing. Every operator is left associative */
+static uint32_t Script_ParseBinary(script_expression_t* expression, uint32_t min_precedence)
+{
+	uint32_t left = Script_ParseUnary(expression);
+
+	while (!expression->failed)
+	{
+		Script_SkipSpace(expression);
+
+		const script_operator_info_t* info = Script_MatchOperator(expression->str);
+
+		if (!info
+		|| info->precedence < min_precedence)
+			break;
+
+		expression->str += strlen(info->symbol);
+
+		uint32_t right = Script_ParseBinary(expression, info->precedence + 1);
+
+		switch (info->operator)
+		{
+			case script_operator_logical_or:
+				left = (left || right);
+				break;
+			case script_operator_logical_and:
+				left = (left && right);
+				break;
+			case script_operator_or:
+				left |= right;
+				break;
+			case script_operator_xor:
+				left ^= right;
+				break;
+			case script_operator_and:
+				left &= right;
+				break;
+			case script_operator_equal:
+				left = (left == right);
+				break;
+			case script_operator_not_equal:
+				left = (left != right);
+				break;
+			case script_operator_less_equal:
+				left = (left <= right);
+				break;
+			case script_operator_greater_equal:
+				left = (left >= right);
+				break;
+			case script_operator_shift_left:
+				left = (right < 32) ? left << right : 0;
+				break;
+			case script_operator_shift_right:
+				left = (right < 32) ? left >> right : 0;
+				break;
+			case script_operator_less:
+				left = (left < right);
+				break;
+			case script_operator_greater:
+				left = (left > right);
+				break;
+			case script_operator_add:
+				left += right;
+				break;
+			case script_operator_subtract:
+				left -= right;
+				break;
+			case script_operator_multiply:
+				left *= right;
+				break;
+			case script_operator_divide:
+			case script_operator_modulo:
+				if (!right)
+				{
+					Script_ExpressionError(expression, "division by zero");
+					return 0;
+				}
+
+				left = (info->operator == script_operator_divide) ? left / right : left % right;
+				break;
+		}
+	}
+
+	return left;
+}
+
+/* e.g. $x, or (0x600000 + $i * 4). Logs why if it can't be evaluated */
+bool Script_Evaluate(const char* expression, uint32_t* value)
+{
+	script_expression_t state = { expression, expression, false };
+
+	uint32_t result = Script_ParseBinary(&state, 1);
+
+	Script_SkipSpace(&state);
+
+	if (!state.failed
+	&& *state.str)
+		Script_ExpressionError(&state, "unexpected characters");
+
+	if (state.failed)
+		return false;
+
+	*value = result;
+	return true;
+}
@@ -15,44 +15,129 @@
 #include <gpuplay.h>
 #include <config/config.h>
 
-/* This is probably not threadsafe */
-char last_command[MAX_STR] = {0};
-/* This is so we can do stuff like strtok */
-char last_token[MAX_STR] = {0};
+#define SCRIPT_WHITESPACE       " \t\r\n"
 
-uint32_t Command_Argc()
+// The command running now, for Command_Argv and friends. Commands that run other commands (time) nest, so this is saved and restored
+static gpu_script_args_t* script_current_args = NULL;
+
+/* Split a trimmed line into arguments and decode the numbers, once. Returns false for an empty line */
+bool Script_Tokenize(const char* line, gpu_script_args_t* args)
 {
-    // restore the original last command so we can parse it
+	args->argc = 0;
+
+	strncpy(args->text, line, GPU_SCRIPT_LINE_SIZE - 1);
+	args->text[GPU_SCRIPT_LINE_SIZE - 1] = '\0';
+
+	// fgets leaves the line ending on
+	uint32_t length = strlen(args->text);
+
+	while (length
+	&& strchr(SCRIPT_WHITESPACE, args->text[length - 1]))
+		args->text[--length] = '\0';
+
+	memcpy(args->tokens, args->text, GPU_SCRIPT_LINE_SIZE);
+
+	char* str = args->tokens;
+
+	while (*str)
+	{
+		str += strspn(str, SCRIPT_WHITESPACE);
+
+		if (!*str)
+			break;
+
+		if (args->argc >= GPU_SCRIPT_MAX_ARGS)
+		{
+			Logging_Write(log_level_warning, "More than %d arguments, ignoring the rest: %s\n", GPU_SCRIPT_MAX_ARGS - 1, str);
+			break;
+		}
+
+		char* token = str;
+		uint32_t depth = 0;
 
-    strncpy(last_token, last_command, MAX_STR);
+		// an (expression) is one argument, spaces and all
+		while (*str
+		&& (depth || !strchr(SCRIPT_WHITESPACE, *str)))
+		{
+			if (*str == '(')
+				depth++;
+			else if (*str == ')' && depth)
+				depth--;
+
+			str++;
+		}
 
-	uint32_t amount = 0;
+		if (*str)
+			*str++ = '\0';
 
-	// skip the command name
+		// HEX notation only, as before. Unsigned, so values with the top bit set don't saturate
+		char* end = NULL;
+		uint32_t value = strtoul(token, &end, 16);
 
-	char* tok = strtok(NULL,  " ");
+		args->argv[args->argc] = token;
+		args->is_number[args->argc] = (end != token && !*end);
+		args->values[args->argc] = (args->is_number[args->argc]) ? value : 0;
+		args->argc++;
+	}
 
-	while (tok)
+	return (args->argc != 0);
+}
+
+/* Arguments that start with $ or ( are expressions, evaluated now rather than when the line was split, because a loop changes them */
+bool Script_EvaluateArgs(gpu_script_args_t* args)
+{
+	// the command name never is
+	for (uint32_t argv = 1; argv < args->argc; argv++)
 	{
-		amount++;
-		tok = strtok(NULL, " ");
+		if (args->argv[argv][0] != '$'
+		&& args->argv[argv][0] != '(')
+			continue;
+
+		if (!Script_Evaluate(args->argv[argv], &args->values[argv]))
+			return false;
+
+		args->is_number[argv] = true;
 	}
 
-	return amount; 
+	return true;
+}
+
+// Return everything from parameter "argv" to the end of the line, e.g. a command to run from inside another one.
+const char* Script_ArgvRest(const gpu_script_args_t* args, uint32_t argv)
+{
+	if (argv >= args->argc)
+		return STRING_EMPTY;
+
+	// tokens is a copy of text, so the argument starts at the same place in both
+	return args->text + (args->argv[argv] - args->tokens);
 }
 
-// Return parameter "argv" of command "command".
+uint32_t Command_Argc()
+{
+	if (!script_current_args
+	|| !script_current_args->argc)
+		return 0;
+
+	// parameters only, not the command name
+	return script_current_args->argc - 1;
+}
+
+// Return parameter "argv" of the command that is running.
 const char* Command_Argv(uint32_t argv)
 {
-    // restore the original last command so we can parse it
-    strncpy(last_token, last_command, MAX_STR);
+	if (!script_current_args
+	|| argv >= script_current_args->argc)
+		return STRING_EMPTY;
 
-	char* str = String_GetTokenSeparatedPart(last_token, " ", argv);
+	return script_current_args->argv[argv];
+}
 
-	if (!str)
+const char* Command_ArgvRest(uint32_t argv)
+{
+	if (!script_current_args)
 		return STRING_EMPTY;
 
-	return str; 
+	return Script_ArgvRest(script_current_args, argv);
 }
 
 void Script_RunCommand(char* line_buf)
@@ -62,7 +147,6 @@ void Script_RunCommand(char* line_buf)
 		return; 
 
 	// trim any whitespace
-	// todo: string_rtrim (after the test rectangle script is verified to work.)
 	char* line_buf_trimmed = String_LTrim(String_RTrim(line_buf, MAX_STR), MAX_STR);
 
 	// skip commented lines
@@ -70,78 +154,70 @@ void Script_RunCommand(char* line_buf)
 	&& line_buf_trimmed[1] == '/')
 		return; 
 
-	Logging_Write(log_level_debug, "Trimmed command string: %s\n", line_buf, line_buf_trimmed);
-
-	strncpy(last_command, line_buf_trimmed, MAX_STR);
+	Logging_Write(log_level_debug, "Trimmed command string: %s\n", line_buf_trimmed);
 
-	// this gets the command
-	char* command_name = strtok( line_buf_trimmed, " ");
+	gpu_script_args_t args;
 
-	int32_t script_command_id = 0;
-	gpu_script_command_t* script_command = &commands[script_command_id];
+	if (!Script_Tokenize(line_buf_trimmed, &args))
+		return;
 
-	bool command_valid = false; 
-
-	// just use a valid abbreviated name
-	while (script_command->name_abbrev)
+	// the expression already said what was wrong with it
+	if (!Script_EvaluateArgs(&args))
 	{
-		if (!strncmp(script_command->name_full, command_name, MAX_STR)
-		|| !strncmp(script_command->name_abbrev, command_name, MAX_STR))
-		{
-			command_valid = true; 
+		Logging_Write(log_level_warning, "Skipping %s\n", line_buf_trimmed);
+		return;
+	}
 
-			// command code uses Command_Argc and Command_Argv to get functions	
-			// don't terminate processing if a function pointer is not present though
-			if (!script_command->function)
-			{
-				Logging_Write(log_level_warning, "Command %s has no function!\n", script_command->name_full);
-				command_valid = false; 
+	const char* command_name = args.argv[0];
 
-			}
+	gpu_script_command_t* script_command = Script_FindCommand(command_name);
 
-			if (Command_Argc() < script_command->num_parameters)
-			{
-				Logging_Write(log_level_warning, "Command %s does not have enough parameters!\n", script_command->name_full);
-				command_valid = false; 
-			}
+	if (!script_command)
+	{
+		Logging_Write(log_level_warning, "Unknown command %s\n", command_name);
+		return;
+	}
 
-			if (command_valid)
-			{
-				if (!script_command->function())
-					Logging_Write(log_level_error, "Command %s failed to execute!\n", script_command->name_full);
+	// don't terminate processing if a function pointer is not present though
+	if (!script_command->function)
+	{
+		Logging_Write(log_level_warning, "Command %s has no function!\n", script_command->name_full);
+		return;
+	}
 
-				// keep command_valid true
-			}
+	if (args.argc - 1 < script_command->num_parameters)
+	{
+		Logging_Write(log_level_warning, "Command %s does not have enough parameters!\n", script_command->name_full);
+		return;
+	}
 
-		}
+	gpu_script_args_t* previous_args = script_current_args;
+	script_current_args = &args;
 
-		// increment command id
-		script_command_id++;
-		script_command = &commands[script_command_id];
-	}
+	if (!script_command->function(&args))
+		Logging_Write(log_level_error, "Command %s failed to execute!\n", script_command->name_full);
 
-	if (!command_valid)
-		Logging_Write(log_level_warning, "Unknown command %s\n", last_token);
+	script_current_args = previous_args;
 }
 
-void Script_Run()
+/* Compiled once, then run from the cached .nvc on later runs until the script changes */
+bool Script_Run()
 {
-	FILE* script_file = fopen(command_line.reg_script_file, "rb+");
-	char line_buf[MAX_STR] = {0};
+	uint32_t code_size = 0;
+	uint8_t* code = Script_LoadCompiled(command_line.reg_script_file, &code_size);
 
-	if (!script_file)
-	{
-		Logging_Write(log_level_error, "Couldn't open script file %s\n");
+	if (!code)
 		exit(7);
-	}
 
 	Logging_Write(log_level_message, "Running script file %s\n", command_line.reg_script_file);
 
-	while (!feof(script_file))
-	{
-		// start a new line
-		fgets(line_buf, MAX_STR, script_file);
+	Script_ClearVariables();
 
-		Script_RunCommand(line_buf);
-	}
-}
\ No newline at end of file
+	bool success = Script_Execute(code, code_size);
+
+	if (!success)
+		Logging_Write(log_level_error, "Script file %s stopped early\n", command_line.reg_script_file);
+
+	free(code);
+	return success;
+}
@@ -0,0 +1,163 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_script_registry.c: Command name lookup. Both names of every command go in one open-addressed hash table
+*/
+
+#include "util/util.h"
+#include <gpuplay.h>
+
+typedef struct script_registry_entry_s
+{
+	const char* name;				// NULL = empty slot
+	gpu_script_command_t* command;
+} script_registry_entry_t;
+
+static script_registry_entry_t* script_registry = NULL;
+static uint32_t script_registry_capacity = 0;		// Always a power of two
+static uint32_t script_registry_count = 0;
+static bool script_builtins_registered = false;
+
+/* FNV-1a */
+static uint32_t Script_HashName(const char* name)
+{
+	uint32_t hash = 0x811C9DC5;
+
+	while (*name)
+		hash = (hash ^ (uint8_t)*name++) * 0x01000193;
+
+	return hash;
+}
+
+/* The slot holding name, or the empty slot where it would go */
+static script_registry_entry_t* Script_FindSlot(script_registry_entry_t* table, uint32_t capacity, const char* name)
+{
+	uint32_t index = Script_HashName(name) & (capacity - 1);
+
+	while (table[index].name
+	&& strcmp(table[index].name, name))
+		index = (index + 1) & (capacity - 1);
+
+	return &table[index];
+}
+
+static bool Script_GrowRegistry()
+{
+	uint32_t capacity = (script_registry_capacity) ? script_registry_capacity * 2 : GPU_SCRIPT_REGISTRY_INITIAL_SIZE;
+	script_registry_entry_t* table = calloc(capacity, sizeof(script_registry_entry_t));
+
+	if (!table)
+	{
+		Logging_Write(log_level_error, "Out of memory growing the script command table to %lu entries\n", capacity);
+		return false;
+	}
+
+	for (uint32_t i = 0; i < script_registry_capacity; i++)
+	{
+		if (script_registry[i].name)
+			*Script_FindSlot(table, capacity, script_registry[i].name) = script_registry[i];
+	}
+
+	free(script_registry);
+	script_registry = table;
+	script_registry_capacity = capacity;
+	return true;
+}
+
+static bool Script_RegisterName(const char* name, gpu_script_command_t* command)
+{
+	// keep at least a quarter empty so probe chains stay short
+	if ((script_registry_count + 1) * 4 > script_registry_capacity * 3
+	&& !Script_GrowRegistry())
+		return false;
+
+	script_registry_entry_t* slot = Script_FindSlot(script_registry, script_registry_capacity, name);
+
+	// a command is allowed to have the same abbreviated and full name. Clashes with others were caught before we got here
+	if (slot->name)
+		return (slot->command == command);
+
+	slot->name = name;
+	slot->command = command;
+	script_registry_count++;
+	return true;
+}
+
+/* The built-in commands[] always go in first, whether the first call is a lookup or an architecture registering its own */
+void Script_InitCommands()
+{
+	if (script_builtins_registered)
+		return;
+
+	script_builtins_registered = true;
+
+	if (!Script_RegisterCommands(commands))
+		Logging_Write(log_level_warning, "Some built-in script commands clash and can't be used (see above)\n");
+}
+
+/* Add one command under both of its names. Nothing is added if either name is taken */
+bool Script_RegisterCommand(gpu_script_command_t* command)
+{
+	if (!command->name_abbrev
+	|| !command->name_full)
+		return false;
+
+	Script_InitCommands();
+
+	if (!script_registry
+	&& !Script_GrowRegistry())
+		return false;
+
+	gpu_script_command_t* existing_abbrev = Script_FindCommand(command->name_abbrev);
+	gpu_script_command_t* existing_full = Script_FindCommand(command->name_full);
+
+	if ((existing_abbrev && existing_abbrev != command)
+	|| (existing_full && existing_full != command))
+	{
+		gpu_script_command_t* existing = (existing_abbrev && existing_abbrev != command) ? existing_abbrev : existing_full;
+
+		Logging_Write(log_level_error, "Script command %s (%s) has the same name as %s (%s), not registering it\n",
+			command->name_abbrev, command->name_full, existing->name_abbrev, existing->name_full);
+		return false;
+	}
+
+	return Script_RegisterName(command->name_abbrev, command)
+		&& Script_RegisterName(command->name_full, command);
+}
+
+/* Register a NULL-terminated table, e.g. an architecture's own commands. Returns false if any of them clashed */
+bool Script_RegisterCommands(gpu_script_command_t* command_table)
+{
+	bool success = true;
+
+	for (gpu_script_command_t* command = command_table; command->name_abbrev; command++)
+	{
+		if (!Script_RegisterCommand(command))
+			success = false;
+	}
+
+	return success;
+}
+
+gpu_script_command_t* Script_FindCommand(const char* name)
+{
+	Script_InitCommands();
+
+	if (!script_registry)
+		return NULL;
+
+	script_registry_entry_t* slot = Script_FindSlot(script_registry, script_registry_capacity, name);
+	return slot->command;
+}
+
+void Script_ShutdownCommands()
+{
+	free(script_registry);
+	script_registry = NULL;
+	script_registry_capacity = script_registry_count = 0;
+	script_builtins_registered = false;
+}
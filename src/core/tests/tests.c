@@ -13,6 +13,7 @@
 
 #include <core/tests/tests.h>
 #include <config/config.h>
+#include <core/timing/gpu_timing.h>
 
 // Architecture includes
 #include <architecture/generic/nv_generic.h>
@@ -24,23 +25,33 @@ nv_test_t nv_tests[] =
     // Generic tests
     { PCI_VENDOR_GENERIC, PCI_DEVICE_GENERIC, "GPU_DumpPCI", "GPU Generic - Dump PCI", NVGeneric_DumpPCISpace},
     { PCI_VENDOR_GENERIC, PCI_DEVICE_GENERIC, "GPU_DumpMMIO", "GPU Generic - Dump MMIO", NVGeneric_DumpMMIO},
+    { PCI_VENDOR_GENERIC, PCI_DEVICE_GENERIC, "GPU_DumpVRAM", "GPU Generic - Dump VRAM", NVGeneric_DumpVRAM},
     { PCI_VENDOR_GENERIC, PCI_DEVICE_GENERIC, "GPU_DumpVBIOS", "GPU Generic - Dump VBIOS", NVGeneric_DumpVBIOS},
+    { PCI_VENDOR_GENERIC, PCI_DEVICE_GENERIC, "GPU_BenchBlockIO", "GPU Generic - Block I/O Throughput", NVGeneric_BenchBlockIO},
+    { PCI_VENDOR_GENERIC, PCI_DEVICE_GENERIC, "GPU_BenchNearPtr", "GPU Generic - Selector vs Near Pointer", NVGeneric_BenchNearPtr},
+    { PCI_VENDOR_GENERIC, PCI_DEVICE_GENERIC, "GPU_ProfileMMIO", "GPU Generic - MMIO Read Latency Profile", NVGeneric_ProfileMMIO},
+    { PCI_VENDOR_GENERIC, PCI_DEVICE_GENERIC, "GPU_BenchAGP", "GPU Generic - LFB Bandwidth per AGP Mode", NVGeneric_BenchAGP},
+    { PCI_VENDOR_GENERIC, PCI_DEVICE_GENERIC, "GPU_BenchPCITiming", "GPU Generic - LFB Bandwidth per Latency Timer/Cache Line Size", NVGeneric_BenchPCITiming},
 
     // Rage128 Pro PF tests
     { PCI_VENDOR_ATI, PCI_DEVICE_RAGE128_PRO_PF, "R128_DumpMfgInfo", "Rage128 Pro PF - Dump Mfg Info", r128_dump_mfg_info},
     { PCI_VENDOR_ATI, PCI_DEVICE_RAGE128_PRO_PF, "R128_DumpMMIO", "Rage128 Pro PF - Dump MMIO", r128_dump_mmio},
+    { PCI_VENDOR_ATI, PCI_DEVICE_RAGE128_PRO_PF, "R128_BenchVRAM", "Rage128 Pro PF - VRAM Bandwidth", NVGeneric_BenchVRAM},
 
     // Rage128 Pro PR tests
     { PCI_VENDOR_ATI, PCI_DEVICE_RAGE128_PRO_PR, "R128_DumpMfgInfo", "Rage128 Pro PR - Dump Mfg Info", r128_dump_mfg_info},
     { PCI_VENDOR_ATI, PCI_DEVICE_RAGE128_PRO_PR, "R128_DumpMMIO", "Rage128 Pro PR - Dump MMIO", r128_dump_mmio},
+    { PCI_VENDOR_ATI, PCI_DEVICE_RAGE128_PRO_PR, "R128_BenchVRAM", "Rage128 Pro PR - VRAM Bandwidth", NVGeneric_BenchVRAM},
 
     // Voodoo3 tests
     { PCI_VENDOR_3DFX, PCI_DEVICE_VOODOO3, "Voodoo3_DumpMfgInfo", "Voodoo3 - Dump Mfg Info", voodoo3_dump_mfg_info},
     { PCI_VENDOR_3DFX, PCI_DEVICE_VOODOO3, "Voodoo3_DumpMMIO", "Voodoo3 - Dump MMIO", voodoo3_dump_mmio},
+    { PCI_VENDOR_3DFX, PCI_DEVICE_VOODOO3, "Voodoo3_BenchVRAM", "Voodoo3 - VRAM Bandwidth", NVGeneric_BenchVRAM},
 
     // Voodoo Banshee tests
     { PCI_VENDOR_3DFX, PCI_DEVICE_BANSHEE, "Voodoo3_DumpMfgInfo", "Voodoo Banshee - Dump Mfg Info", voodoo3_dump_mfg_info},
     { PCI_VENDOR_3DFX, PCI_DEVICE_BANSHEE, "Voodoo3_DumpMMIO", "Voodoo Banshee - Dump MMIO", voodoo3_dump_mmio},
+    { PCI_VENDOR_3DFX, PCI_DEVICE_BANSHEE, "Voodoo3_BenchVRAM", "Voodoo Banshee - VRAM Bandwidth", NVGeneric_BenchVRAM},
 
     { 0x0000, 0x0000, "", "", NULL}, // Sentinel value, do not remove
 };
@@ -98,12 +109,14 @@ bool Test_Run(nv_config_test_entry_t* test)
 	*/
 	if (test->test_function)
 	{
+		uint64_t start = Timing_ReadTSC();
 		bool success = test->test_function();	
+		double duration_ms = Timing_CyclesToNs(Timing_ReadTSC() - start) / 1000000.0;
 
 		if (success)
-			Logging_Write(log_level_message, "Test %s succeeded\n", test->name);
+			Logging_Write(log_level_message, "Test %s succeeded (%.3f ms)\n", test->name, duration_ms);
 		else
-			Logging_Write(log_level_message, "Test %s failed! :(\n", test->name);
+			Logging_Write(log_level_message, "Test %s failed! :( (%.3f ms)\n", test->name, duration_ms);
 	
         return success; 
     }
@@ -0,0 +1,249 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_timing.c: High resolution timing: TSC calibration, scoped timers and histograms
+*/
+
+#include <gpuplay.h>
+#include <core/timing/gpu_timing.h>
+
+#ifdef __DJGPP__
+#include "dos.h"
+#endif
+
+// 8254 channel 2 is gated through the keyboard controller's port B, and nothing else in DOS uses it except the speaker
+#define TIMING_PORT_PIT_CHANNEL2        0x42
+#define TIMING_PORT_PIT_COMMAND         0x43
+#define TIMING_PORT_B                   0x61
+
+#define TIMING_PORT_B_GATE2             0x01
+#define TIMING_PORT_B_SPEAKER           0x02
+#define TIMING_PORT_B_OUT2              0x20
+
+#define TIMING_PIT_CHANNEL2_MODE0       0xB0            // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count), binary
+
+#define TIMING_CPUID_TSC                (1 << 4)
+#define TIMING_EFLAGS_ID                (1 << 21)
+
+timing_state_t timing_state = {0};
+
+#ifdef __DJGPP__
+
+/* CPUID exists if we can flip EFLAGS.ID, and leaf 1 EDX bit 4 says there's a TSC */
+static bool Timing_CPUHasTSC()
+{
+    uint32_t before, after;
+
+    __asm__ __volatile__(
+        "pushfl\n\t"
+        "popl %0\n\t"
+        "movl %0, %1\n\t"
+        "xorl %2, %1\n\t"
+        "pushl %1\n\t"
+        "popfl\n\t"
+        "pushfl\n\t"
+        "popl %1\n\t"
+        "pushl %0\n\t"
+        "popfl"
+        : "=&r" (before), "=&r" (after)
+        : "i" (TIMING_EFLAGS_ID)
+        : "cc");
+
+    if (!((before ^ after) & TIMING_EFLAGS_ID))
+        return false;
+
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ __volatile__("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+
+    return (edx & TIMING_CPUID_TSC);
+}
+
+/* Time TIMING_CALIBRATION_COUNT PIT ticks with the TSC. Returns cycles elapsed */
+static uint64_t Timing_CalibrateOnce()
+{
+    disable();
+
+    // gate off with the speaker disconnected, load the count, then raise the gate to start counting
+    uint8_t port_b = inportb(TIMING_PORT_B) & ~(TIMING_PORT_B_GATE2 | TIMING_PORT_B_SPEAKER);
+    outportb(TIMING_PORT_B, port_b);
+
+    outportb(TIMING_PORT_PIT_COMMAND, TIMING_PIT_CHANNEL2_MODE0);
+    outportb(TIMING_PORT_PIT_CHANNEL2, TIMING_CALIBRATION_COUNT & 0xFF);
+    outportb(TIMING_PORT_PIT_CHANNEL2, TIMING_CALIBRATION_COUNT >> 8);
+
+    outportb(TIMING_PORT_B, port_b | TIMING_PORT_B_GATE2);
+    uint64_t start = Timing_ReadTSC();
+
+    // OUT2 goes high at terminal count
+    while (!(inportb(TIMING_PORT_B) & TIMING_PORT_B_OUT2))
+        ;
+
+    uint64_t end = Timing_ReadTSC();
+
+    outportb(TIMING_PORT_B, port_b);
+    enable();
+
+    return end - start;
+}
+
+#endif
+
+bool Timing_Init()
+{
+#ifndef __DJGPP__
+    // no PIT to calibrate against, and no need: Timing_ReadTSC counts nanoseconds here
+    timing_state.has_tsc = false;
+    timing_state.tsc_hz = 1000000000;
+    timing_state.ns_per_cycle = 1.0;
+    return true;
+#else
+    timing_state.has_tsc = Timing_CPUHasTSC();
+
+    if (!timing_state.has_tsc)
+    {
+        timing_state.tsc_hz = UCLOCKS_PER_SEC;
+        timing_state.ns_per_cycle = 1000000000.0 / timing_state.tsc_hz;
+        uclock(); // the first call sets up uclock's timer
+
+        Logging_Write(log_level_warning, "No TSC on this CPU; timing falls back to uclock() (%lu Hz)\n", (uint32_t)timing_state.tsc_hz);
+        return true;
+    }
+
+    // anything that got in the way (an SMI, the DPMI host) only ever makes a run longer, so take the shortest
+    uint64_t best = 0;
+
+    for (uint32_t run = 0; run < TIMING_CALIBRATION_RUNS; run++)
+    {
+        uint64_t cycles = Timing_CalibrateOnce();
+
+        if (!best
+        || cycles < best)
+            best = cycles;
+    }
+
+    if (!best)
+    {
+        Logging_Write(log_level_error, "TSC calibration failed\n");
+        return false;
+    }
+
+    timing_state.tsc_hz = (best * TIMING_PIT_HZ) / TIMING_CALIBRATION_COUNT;
+    timing_state.ns_per_cycle = 1000000000.0 / timing_state.tsc_hz;
+
+    Logging_Write(log_level_message, "TSC calibrated: %.2f MHz\n", timing_state.tsc_hz / 1000000.0);
+    return true;
+#endif
+}
+
+double Timing_CyclesToNs(uint64_t cycles)
+{
+    return (double)cycles * timing_state.ns_per_cycle;
+}
+
+double Timing_CyclesToSeconds(uint64_t cycles)
+{
+    return (double)cycles / timing_state.tsc_hz;
+}
+
+uint64_t Timing_MicrosecondsToCycles(uint32_t us)
+{
+    return ((uint64_t)us * timing_state.tsc_hz) / 1000000;
+}
+
+//
+// Scoped timers
+//
+
+timing_scope_t Timing_ScopeBegin(const char* name)
+{
+    timing_scope_t scope = { name, Timing_ReadTSC() };
+    return scope;
+}
+
+uint64_t Timing_ScopeEnd(timing_scope_t* scope)
+{
+    uint64_t cycles = Timing_ReadTSC() - scope->start;
+
+    Logging_Write(log_level_message, "[TIME] %s: %.3f us (%llu cycles)\n", scope->name, Timing_CyclesToNs(cycles) / 1000.0, cycles);
+    return cycles;
+}
+
+//
+// Histograms
+//
+
+void Timing_HistogramReset(timing_histogram_t* histogram, const char* name)
+{
+    memset(histogram, 0, sizeof(timing_histogram_t));
+    histogram->name = name;
+}
+
+void Timing_HistogramAdd(timing_histogram_t* histogram, uint64_t cycles)
+{
+    uint64_t ns = (uint64_t)Timing_CyclesToNs(cycles);
+    uint32_t bucket = 0;
+
+    while (ns > 1
+    && bucket < TIMING_HISTOGRAM_BUCKETS - 1)
+    {
+        ns >>= 1;
+        bucket++;
+    }
+
+    histogram->buckets[bucket]++;
+
+    if (!histogram->count
+    || cycles < histogram->min)
+        histogram->min = cycles;
+
+    if (cycles > histogram->max)
+        histogram->max = cycles;
+
+    histogram->total += cycles;
+    histogram->count++;
+}
+
+/* Upper edge of the bucket the percentile falls in */
+double Timing_HistogramPercentile(timing_histogram_t* histogram, uint32_t percentile)
+{
+    if (!histogram->count)
+        return 0.0;
+
+    uint64_t target = (histogram->count * percentile + 99) / 100;
+    uint64_t seen = 0;
+
+    for (uint32_t bucket = 0; bucket < TIMING_HISTOGRAM_BUCKETS; bucket++)
+    {
+        seen += histogram->buckets[bucket];
+
+        if (seen >= target)
+            return (double)(2ULL << bucket);
+    }
+
+    return Timing_CyclesToNs(histogram->max);
+}
+
+void Timing_HistogramReport(timing_histogram_t* histogram)
+{
+    if (!histogram->count)
+    {
+        Logging_Write(log_level_message, "[TIME] %s: no samples\n", histogram->name);
+        return;
+    }
+
+    Logging_Write(log_level_message, "[TIME] %s: %llu samples, min %.1f ns, mean %.1f ns, max %.1f ns, p50 <%.0f ns, p99 <%.0f ns\n",
+        histogram->name, histogram->count,
+        Timing_CyclesToNs(histogram->min), Timing_CyclesToNs(histogram->total) / histogram->count, Timing_CyclesToNs(histogram->max),
+        Timing_HistogramPercentile(histogram, 50), Timing_HistogramPercentile(histogram, 99));
+
+    for (uint32_t bucket = 0; bucket < TIMING_HISTOGRAM_BUCKETS; bucket++)
+    {
+        if (histogram->buckets[bucket])
+            Logging_Write(log_level_debug, "[TIME]   %10llu-%10llu ns: %lu\n",
+                (bucket) ? (1ULL << bucket) : 0ULL, (1ULL << (bucket + 1)) - 1, histogram->buckets[bucket]);
+    }
+}
@@ -0,0 +1,78 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_timing.h: High resolution timing. RDTSC, calibrated against the 8254 PIT at startup.
+
+    CPUs without a TSC fall back to uclock(), so everything here still works, just at PIT resolution.
+    Host builds have neither, and use CLOCK_MONOTONIC.
+*/
+
+#pragma once
+#include <gpuplay.h>
+
+#define TIMING_PIT_HZ                   1193182         // 8254 input clock
+#define TIMING_CALIBRATION_COUNT        59659           // PIT ticks per calibration run (~50ms)
+#define TIMING_CALIBRATION_RUNS         3               // Best of
+
+#define TIMING_HISTOGRAM_BUCKETS        32              // Bucket n holds samples in [2^n, 2^(n+1)) ns
+
+typedef struct timing_state_s
+{
+    bool has_tsc;                   // False on pre-Pentium CPUs; cycles are uclock() ticks then
+    uint64_t tsc_hz;                // Cycles per second
+    double ns_per_cycle;
+} timing_state_t;
+
+extern timing_state_t timing_state;
+
+/* A named timer, started by Timing_ScopeBegin. Timing_ScopeEnd logs how long it ran */
+typedef struct timing_scope_s
+{
+    const char* name;
+    uint64_t start;
+} timing_scope_t;
+
+typedef struct timing_histogram_s
+{
+    const char* name;
+    uint64_t count;
+    uint64_t total;                 // Sum of all samples, in cycles
+    uint64_t min;                   // Cycles
+    uint64_t max;                   // Cycles
+    uint32_t buckets[TIMING_HISTOGRAM_BUCKETS];
+} timing_histogram_t;
+
+bool Timing_Init();
+
+double Timing_CyclesToNs(uint64_t cycles);
+double Timing_CyclesToSeconds(uint64_t cycles);
+uint64_t Timing_MicrosecondsToCycles(uint32_t us);
+
+timing_scope_t Timing_ScopeBegin(const char* name);
+uint64_t Timing_ScopeEnd(timing_scope_t* scope);          // Returns elapsed cycles and logs them
+
+void Timing_HistogramReset(timing_histogram_t* histogram, const char* name);
+void Timing_HistogramAdd(timing_histogram_t* histogram, uint64_t cycles);
+double Timing_HistogramPercentile(timing_histogram_t* histogram, uint32_t percentile);  // ns, to bucket precision
+void Timing_HistogramReport(timing_histogram_t* histogram);
+
+static inline uint64_t Timing_ReadTSC()
+{
+#ifdef __DJGPP__
+    if (!timing_state.has_tsc)
+        return uclock();
+
+    uint32_t low, high;
+    __asm__ __volatile__("rdtsc" : "=a" (low), "=d" (high));
+    return ((uint64_t)high << 32) | low;
+#else
+    // host builds count in CLOCK_MONOTONIC nanoseconds instead
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
@@ -0,0 +1,86 @@
+/* 
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_trace.c: Binary access tracer. Records go into a locked buffer and are written out a whole buffer at a time.
+*/
+
+#include <gpuplay.h>
+#include <core/trace/gpu_trace.h>
+
+trace_state_t trace_state = {0};
+
+bool Trace_Init()
+{
+#ifdef GPUPLAY_TRACE
+    uint32_t buffer_size = TRACE_BUFFER_RECORDS * sizeof(trace_record_t);
+
+    trace_state.stream = fopen(TRACE_FILE_DEFAULT_NAME, "wb");
+
+    if (!trace_state.stream)
+    {
+        Logging_Write(log_level_error, "Failed to open trace file %s\n", TRACE_FILE_DEFAULT_NAME);
+        return false;
+    }
+
+    trace_record_t* buffer = calloc(1, buffer_size);
+
+    if (!buffer)
+    {
+        Logging_Write(log_level_error, "Failed to allocate trace buffer\n");
+        fclose(trace_state.stream);
+        trace_state.stream = NULL;
+        return false;
+    }
+
+#ifdef __DJGPP__
+    // don't let the DPMI host page the buffer out from under us in the middle of a timed sequence
+    if (_go32_dpmi_lock_data(buffer, buffer_size))
+        Logging_Write(log_level_warning, "Couldn't lock the trace buffer; tracing may perturb timings\n");
+#endif
+
+    trace_file_header_t header = {0};
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(trace_record_t);
+    header.tsc_hz = timing_state.tsc_hz;
+    fwrite(&header, sizeof(trace_file_header_t), 1, trace_state.stream);
+
+    trace_state.head = 0;
+    trace_state.buffer = buffer;
+
+    // exit() paths still get their trace
+    atexit(Trace_Shutdown);
+
+    Logging_Write(log_level_message, "Tracing to %s\n", TRACE_FILE_DEFAULT_NAME);
+#endif
+    return true; 
+}
+
+/* Write out everything recorded so far and start the buffer again */
+void Trace_Spill()
+{
+    if (!trace_state.stream)
+        return;
+
+    if (trace_state.head)
+        fwrite(trace_state.buffer, sizeof(trace_record_t), trace_state.head, trace_state.stream);
+
+    trace_state.head = 0;
+}
+
+void Trace_Shutdown()
+{
+    if (!trace_state.buffer)
+        return;
+
+    Trace_Spill();
+    fclose(trace_state.stream);
+
+    free(trace_state.buffer);
+    trace_state.buffer = NULL;
+    trace_state.stream = NULL;
+}
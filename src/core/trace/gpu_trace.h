@@ -0,0 +1,94 @@
+/* 
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    gpu_trace.h: Binary access tracer for MMIO, DFB, port and PCI configuration accesses
+    
+    Only built when GPUPLAY_TRACE is defined (cmake -DGPUPLAY_TRACE=ON). Otherwise GPU_TRACE expands to nothing
+    and none of this costs anything.
+*/
+
+#pragma once
+#include <gpuplay.h>
+#include <core/timing/gpu_timing.h>
+
+#define TRACE_FILE_DEFAULT_NAME         "gpuplay.trc"
+#define TRACE_MAGIC                     0x52545047      // 'GPTR'
+#define TRACE_VERSION                   2
+#define TRACE_BUFFER_RECORDS            65536           // Records held in memory before being spilled to disk
+
+// Width used for block transfers. The value field holds the size in bytes.
+#define TRACE_WIDTH_BLOCK               0
+
+typedef enum trace_op_e
+{
+    trace_op_mmio_read = 0,
+    trace_op_mmio_write = 1,
+    trace_op_dfb_read = 2,
+    trace_op_dfb_write = 3,
+    trace_op_port_read = 4,
+    trace_op_port_write = 5,
+    trace_op_pci_read = 6,                              // address = (bus << 16) | (function << 8) | offset
+    trace_op_pci_write = 7,
+} trace_op; 
+
+// Packs a config space location into the trace record's address field
+#define PCI_TRACE_ADDRESS(bus_number, function_number, offset)     (((bus_number) << 16) | ((function_number) << 8) | (offset))
+
+typedef struct trace_file_header_s
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;           // sizeof(trace_record_t) so readers can skip fields they don't know about
+    uint64_t tsc_hz;                // [v2+] Calibrated TSC frequency, for turning record timestamps into time
+} trace_file_header_t;
+
+typedef struct trace_record_s
+{
+    uint64_t tsc;                   // RDTSC at the time of the access
+    uint32_t address;
+    uint32_t value;
+    uint8_t op;                     // trace_op
+    uint8_t width;                  // Access width in bytes, or TRACE_WIDTH_BLOCK
+    uint16_t reserved;
+} trace_record_t;
+
+typedef struct trace_state_s
+{
+    trace_record_t* buffer;         // Locked, preallocated ring buffer. NULL until Trace_Init
+    uint32_t head;                  // Next record to write
+    FILE* stream;
+} trace_state_t;
+
+extern trace_state_t trace_state;
+
+bool Trace_Init();
+void Trace_Spill();
+void Trace_Shutdown();
+
+/* Record an access. Kept inline and branch-light: the only slow path is spilling a full buffer */
+static inline void Trace_Record(uint8_t op, uint8_t width, uint32_t address, uint32_t value)
+{
+    if (!trace_state.buffer)
+        return;
+
+    trace_record_t* record = &trace_state.buffer[trace_state.head];
+
+    record->tsc = Timing_ReadTSC();
+    record->address = address;
+    record->value = value;
+    record->op = op;
+    record->width = width;
+
+    if (++trace_state.head == TRACE_BUFFER_RECORDS)
+        Trace_Spill();
+}
+
+#ifdef GPUPLAY_TRACE
+#define GPU_TRACE(op, width, address, value)        Trace_Record(op, width, address, value)
+#else
+#define GPU_TRACE(op, width, address, value)
+#endif
@@ -43,8 +43,7 @@ static void gdb_write_packet(unsigned char *buffer);
 #define gdb_debug(...)
 #endif
 
-#include <crt0.h>
-int _crt0_startup_flags = _CRT0_FLAG_LOCK_MEMORY;
+// _crt0_startup_flags (which needs _CRT0_FLAG_LOCK_MEMORY for the stub) is defined in main.c, with the other flags GPUPlay needs
 
 #define UART_LINE_CONTROL 3
 #define UART_LCR_DIVISOR_LATCH 0x80
@@ -9,11 +9,8 @@
 */
 
 #pragma once
-#include <bios.h>
 #include <ctype.h>
-#include <dpmi.h>
-#include <go32.h>
-#include <pc.h>
+#include <inttypes.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -21,8 +18,16 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+
+// The DOS build. Without these there's no hardware backend, only -sim (see CMakeLists.txt)
+#ifdef __DJGPP__
+#include <bios.h>
+#include <dpmi.h>
+#include <go32.h>
+#include <pc.h>
 #include <sys/nearptr.h>
 #include <sys/farptr.h>
+#endif
 
 // #pragma once my beloved
 #include <util/util.h>
@@ -63,9 +68,10 @@ void GPUPlay_ShowHelpAndExit();
 
 #define PCI_CFG_OFFSET_STATUS				0x06
 #define PCI_CFG_OFFSET_REVISION				0x08
-#define PCI_CFG_OFFSET_CLASS_CODE			0x09	
-#define PCI_CFG_OFFSET_CLASS_CODE_HIGH 		0x09
-#define PCI_CFG_OFFSET_CLASS_CODE_LOW		0x0A
+#define PCI_CFG_OFFSET_CLASS_CODE			0x09	// 24 bits: programming interface, subclass, base class
+#define PCI_CFG_OFFSET_PROG_IF				0x09
+#define PCI_CFG_OFFSET_SUBCLASS				0x0A
+#define PCI_CFG_OFFSET_BASE_CLASS			0x0B
 #define PCI_CFG_OFFSET_CACHE_LINE_SIZE		0x0C
 #define PCI_CFG_OFFSET_LATENCY_TIMER		0x0D
 #define PCI_CFG_OFFSET_HEADER_TYPE			0x0E
@@ -83,16 +89,59 @@ Well, I guess they would all be used for 64-bit mapping. But we only care about
 #define PCI_CFG_OFFSET_BAR5					0x24	// For dumping purposes
 
 #define PCI_CFG_OFFSET_CARDBUS_CIS_PTR		0x28
-#define PCI_CFG_OFFSET_SUBSYSTEM_VENDOR_ID	0x2A
-#define PCI_CFG_OFFSET_SUBSYSTEM_ID			0x2C
+#define PCI_CFG_OFFSET_SUBSYSTEM_VENDOR_ID	0x2C
+#define PCI_CFG_OFFSET_SUBSYSTEM_ID			0x2E
 #define PCI_CFG_OFFSET_EXPANSION_ROM_BASE	0x30
 #define PCI_CFG_OFFSET_CAPABILITIES_PTR 	0x34
-#define PCI_CFG_OFFSET_INTERRUPT_LINE		0x39
-#define PCI_CFG_OFFSET_INTERRUPT_PIN		0x3A
-#define PCI_CFG_OFFSET_MINIMUM_GRANT		0x3B
-#define PCI_CFG_OFFSET_MAXIMUM_LATENCY		0x3C
-
-/* TODO: AGP SHIT! */
+#define PCI_CFG_OFFSET_INTERRUPT_LINE		0x3C
+#define PCI_CFG_OFFSET_INTERRUPT_PIN		0x3D
+#define PCI_CFG_OFFSET_MINIMUM_GRANT		0x3E
+#define PCI_CFG_OFFSET_MAXIMUM_LATENCY		0x3F
+
+#define PCI_CONFIG_SPACE_SIZE				0x100	// Conventional PCI; extended config space is PCIe only
+
+#define PCI_CFG_OFFSET_STATUS_CAPABILITIES	0x10	// Status bit: CAPABILITIES_PTR is valid
+
+/* Capability list. Each entry starts with an ID byte and a next pointer byte */
+#define PCI_CAP_OFFSET_ID					0x00
+#define PCI_CAP_OFFSET_NEXT					0x01
+#define PCI_CAP_POINTER_MASK				0xFC	// The bottom two bits of a pointer are reserved
+#define PCI_CAP_MIN_OFFSET					0x40	// Capabilities live after the type-0 header
+#define PCI_MAX_CAPABILITIES				48		// (256 - 64) / 4, so a looped list can't hang us
+
+#define PCI_CAP_ID_PM						0x01
+#define PCI_CAP_ID_AGP						0x02
+#define PCI_CAP_ID_MSI						0x05
+
+// Power management
+#define PCI_PM_OFFSET_PMC					0x02
+#define PCI_PM_OFFSET_PMCSR					0x04
+#define PCI_PM_PMCSR_STATE_MASK				0x03	// D0-D3hot
+
+// MSI
+#define PCI_MSI_OFFSET_CONTROL				0x02
+#define PCI_MSI_CONTROL_ENABLE				0x0001
+#define PCI_MSI_CONTROL_MMC_SHIFT			1		// log2 of the number of vectors requested
+#define PCI_MSI_CONTROL_MMC_MASK			0x07
+#define PCI_MSI_CONTROL_64BIT				0x0080
+
+// AGP. The status register says what a side can do, the command register what it has been told to do
+#define PCI_AGP_OFFSET_VERSION				0x02	// Major in bits 7:4, minor in 3:0
+#define PCI_AGP_OFFSET_STATUS				0x04
+#define PCI_AGP_OFFSET_COMMAND				0x08
+
+#define PCI_AGP_RATE_1X						0x01
+#define PCI_AGP_RATE_2X						0x02
+#define PCI_AGP_RATE_4X						0x04
+#define PCI_AGP_RATE_MASK					0x07
+#define PCI_AGP_FAST_WRITES					0x10
+#define PCI_AGP_4GB							0x20	// Status only
+#define PCI_AGP_ENABLE						0x100	// Command only
+#define PCI_AGP_SIDEBAND					0x200
+#define PCI_AGP_RQ_SHIFT					24		// Status: requests the target can queue. Command: how many the master may issue
+#define PCI_AGP_RQ_MASK						0xFF000000
+
+#define PCI_CLASS_HOST_BRIDGE				0x0600	// class_code >> 8. The AGP target lives here
 
 /* PCI Structures & Enums */
 typedef enum 
@@ -125,8 +174,193 @@ typedef enum
 	PCI_ERROR_BAD_PCI_REGISTER = 0x87,
 } pci_errors_t; 
 
+/* How config space is reached */
+typedef enum pci_mechanism_e
+{
+	pci_mechanism_bios = 0,						// INT 1Ah PCI BIOS. Always works, but every access is a trip through real mode
+	pci_mechanism_1 = 1,						// Configuration mechanism #1, ports 0xCF8/0xCFC
+} pci_mechanism; 
+
+#define PCI_MECHANISM_1_ADDRESS		0xCF8
+#define PCI_MECHANISM_1_DATA		0xCFC
+#define PCI_MECHANISM_1_ENABLE		0x80000000
+
+extern pci_mechanism pci_config_mechanism;
+extern uint32_t pci_last_bus;					// Highest bus number, from the PCI BIOS
+
+/* PCI enumeration (see pci_enum.c) */
+#define PCI_MAX_DEVICES				256			// Functions kept in the table
+#define PCI_MAX_DEVICE_NUMBER		31
+#define PCI_MAX_FUNCTIONS			8
+#define PCI_NUM_BARS				6
+
+#define PCI_HEADER_TYPE_MASK			0x7F
+#define PCI_HEADER_TYPE_NORMAL			0x00
+#define PCI_HEADER_TYPE_BRIDGE			0x01
+#define PCI_HEADER_TYPE_MULTI_FUNCTION	0x80
+
+typedef struct pci_device_entry_s
+{
+	uint8_t bus_number;
+	uint8_t function_number;					// (device << 3) | function, like the PCI BIOS uses
+	uint16_t vendor_id;
+	uint16_t device_id;
+	uint8_t revision;
+	uint8_t header_type;
+	uint32_t class_code;						// (class << 16) | (subclass << 8) | programming interface
+	uint32_t bars[PCI_NUM_BARS];				// Raw BAR values. Bridges only have the first two
+} pci_device_entry_t;
+
+typedef struct pci_device_table_s
+{
+	pci_device_entry_t entries[PCI_MAX_DEVICES];
+	uint32_t count;
+	bool enumerated;
+} pci_device_table_t;
+
+extern pci_device_table_t pci_devices;
+
+bool PCI_Enumerate();
+pci_device_entry_t* PCI_FindDevice(uint32_t vendor_id, uint32_t device_id, uint32_t index);
+void PCI_PrintDeviceTable();
+
+/* Config space snapshots (see pci_snapshot.c). The whole 256 byte header in 64 dword reads, plus the type-0 fields decoded out of it */
+typedef struct pci_config_decoded_s
+{
+	uint16_t vendor_id;
+	uint16_t device_id;
+	uint16_t command;
+	uint16_t status;
+	uint8_t revision;
+	uint32_t class_code;						// (class << 16) | (subclass << 8) | programming interface
+	uint8_t cache_line_size;
+	uint8_t latency_timer;
+	uint8_t header_type;
+	uint8_t bist;
+	uint32_t bars[PCI_NUM_BARS];
+	uint32_t cardbus_cis_ptr;
+	uint16_t subsystem_vendor_id;
+	uint16_t subsystem_id;
+	uint32_t rom_bar;
+	uint8_t capabilities_ptr;
+	uint8_t interrupt_line;
+	uint8_t interrupt_pin;
+	uint8_t minimum_grant;
+	uint8_t maximum_latency;
+} pci_config_decoded_t;
+
+typedef struct pci_config_snapshot_s
+{
+	uint32_t bus_number;
+	uint32_t function_number;
+	bool valid;									// False until captured
+	union
+	{
+		uint8_t bytes[PCI_CONFIG_SPACE_SIZE];
+		uint32_t dwords[PCI_CONFIG_SPACE_SIZE / 4];
+	};
+	pci_config_decoded_t decoded;				// Kept in step with the raw image
+} pci_config_snapshot_t;
+
+bool PCI_SnapshotCapture(pci_config_snapshot_t* snapshot, uint32_t bus_number, uint32_t function_number);
+pci_config_snapshot_t* PCI_CurrentConfig();		// The current device's snapshot, captured on first use
+void PCI_SnapshotRefresh(uint32_t bus_number, uint32_t function_number, uint32_t offset);
+void PCI_SnapshotPrint(const pci_config_snapshot_t* snapshot);
+bool PCI_SnapshotSave(const pci_config_snapshot_t* snapshot, const char* file_name);
+bool PCI_SnapshotLoad(pci_config_snapshot_t* snapshot, const char* file_name);
+uint32_t PCI_SnapshotCompare(const pci_config_snapshot_t* before, const pci_config_snapshot_t* after);
+
+/* Capability lists (see pci_caps.c). Walked from a snapshot, so it costs no extra config cycles */
+typedef struct pci_capability_s
+{
+	uint8_t id;
+	uint8_t offset;
+} pci_capability_t;
+
+uint32_t PCI_WalkCapabilities(const pci_config_snapshot_t* snapshot, pci_capability_t* capabilities, uint32_t max_capabilities);
+uint8_t PCI_FindCapability(const pci_config_snapshot_t* snapshot, uint8_t id);
+void PCI_PrintCapabilities(const pci_config_snapshot_t* snapshot);
+
+/* AGP mode configuration (see pci_agp.c) */
+typedef struct agp_state_s
+{
+	bool present;								// Both the GPU and a host bridge have an AGP capability
+	struct nv_device_s* device;					// The GPU this was set up for
+	pci_config_snapshot_t bridge;				// The host bridge (the AGP target)
+	uint8_t bridge_capability;
+	uint8_t device_capability;
+	uint32_t bridge_status;
+	uint32_t device_status;
+	uint32_t original_bridge_command;			// Whatever the BIOS set up, put back by AGP_Restore
+	uint32_t original_device_command;
+	bool modified;								// AGP_Configure has been called since the last restore
+} agp_state_t;
+
+extern agp_state_t agp_state;
+
+bool AGP_Init();
+uint32_t AGP_CommonModes();						// Rate, fast write and sideband bits both sides support
+bool AGP_Configure(uint32_t rate, bool fast_writes, bool sideband);
+void AGP_Restore();
+
+/* BAR sizing (see pci_bar.c) */
+#define PCI_BAR_IO						0x01		// Bit 0: I/O space
+#define PCI_BAR_MEM_TYPE_MASK			0x06		// Bits 2:1 of a memory BAR
+#define PCI_BAR_MEM_TYPE_64				0x04
+#define PCI_BAR_MEM_PREFETCHABLE		0x08
+#define PCI_BAR_IO_ADDRESS_MASK			0xFFFFFFFC
+#define PCI_BAR_MEM_ADDRESS_MASK		0xFFFFFFF0
+#define PCI_ROM_BAR_ENABLE				0x01		// Expansion ROM BAR: decode the ROM
+#define PCI_ROM_BAR_ADDRESS_MASK		0xFFFFF800
+
+typedef struct pci_bar_s
+{
+	uint32_t base;								// Bus address (port number for I/O BARs) with the flag bits masked off
+	uint32_t size;								// Bytes decoded, found by writing all ones. 0 if the BAR isn't implemented
+	bool io;
+	bool prefetchable;
+	bool is_64bit;								// The upper half is in the next BAR, which is then not a BAR of its own
+} pci_bar_t;
+
+bool PCI_ProbeBar(uint32_t bus_number, uint32_t function_number, uint32_t bar, pci_bar_t* info);
+uint32_t PCI_ProbeBars(uint32_t bus_number, uint32_t function_number, pci_bar_t* bars);
+bool PCI_ProbeRomBar(uint32_t bus_number, uint32_t function_number, pci_bar_t* info);
+int32_t PCI_MapBar(const pci_bar_t* bar, uint32_t* linear_address);
+void PCI_UnmapBar(int32_t selector, uint32_t linear_address);
+
+/* Expansion ROM image layout (PCI firmware spec). A ROM is one or more images back to back */
+#define PCI_ROM_SIGNATURE				0xAA55		// 55 AA at the start of every image
+#define PCI_ROM_OFFSET_SIZE				0x02		// x86 images: size in 512 byte units
+#define PCI_ROM_OFFSET_PCIR				0x18		// 16-bit pointer to the PCI data structure
+#define PCI_ROM_UNIT					512
+#define PCI_ROM_MAX_IMAGES				8
+#define PCI_ROM_PCIR_SIGNATURE			0x52494350	// "PCIR"
+#define PCI_ROM_PCIR_OFFSET_VENDOR_ID	0x04
+#define PCI_ROM_PCIR_OFFSET_DEVICE_ID	0x06
+#define PCI_ROM_PCIR_OFFSET_LENGTH		0x10		// Image length in 512 byte units
+#define PCI_ROM_PCIR_OFFSET_CODE_TYPE	0x14		// 0 = x86, 1 = Open Firmware, 3 = EFI
+#define PCI_ROM_PCIR_OFFSET_INDICATOR	0x15
+#define PCI_ROM_PCIR_INDICATOR_LAST		0x80		// No more images after this one
+
+static inline uint8_t PCI_Snapshot8(const pci_config_snapshot_t* snapshot, uint32_t offset)
+{
+	return snapshot->bytes[offset & (PCI_CONFIG_SPACE_SIZE - 1)];
+}
+
+static inline uint16_t PCI_Snapshot16(const pci_config_snapshot_t* snapshot, uint32_t offset)
+{
+	return snapshot->dwords[(offset & (PCI_CONFIG_SPACE_SIZE - 1)) >> 2] >> ((offset & 2) * 8);
+}
+
+static inline uint32_t PCI_Snapshot32(const pci_config_snapshot_t* snapshot, uint32_t offset)
+{
+	return snapshot->dwords[(offset & (PCI_CONFIG_SPACE_SIZE - 1)) >> 2];
+}
+
 /* PCI Functions */
 bool PCI_BiosIsPresent(void);
+bool PCI_Mechanism1IsPresent(void);
+void PCI_SelectMechanism(const char* setting);
 bool PCI_DevicePresent(uint32_t device_id, uint32_t vendor_id);
 
 uint8_t PCI_ReadConfig8(uint32_t bus_number, uint32_t function_number, uint32_t offset);
@@ -137,6 +371,35 @@ bool PCI_WriteConfig8(uint32_t bus_number, uint32_t function_number, uint32_t of
 bool PCI_WriteConfig16(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint16_t value);
 bool PCI_WriteConfig32(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t value);
 
+/* The real config space with nothing on top: no journal, trace, snapshot or simulated backend. False if the BIOS refused */
+bool PCI_HardwareRead(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t width, uint32_t* value);
+bool PCI_HardwareWrite(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t width, uint32_t value);
+
+/* Config write journal: the original of every dword we write, put back in reverse order on exit, Ctrl+C or a crash */
+#define PCI_JOURNAL_MAX_ENTRIES			256
+
+typedef struct pci_journal_entry_s
+{
+	uint32_t bus_number;
+	uint32_t function_number;
+	uint32_t offset;							// Dword aligned
+	uint32_t original;							// Before our first write to it
+} pci_journal_entry_t;
+
+typedef struct pci_journal_s
+{
+	bool enabled;
+	bool restoring;								// Don't journal the restore's own writes
+	uint32_t count;
+	pci_journal_entry_t entries[PCI_JOURNAL_MAX_ENTRIES];
+} pci_journal_t;
+
+extern pci_journal_t pci_journal;
+
+void PCI_JournalEnable(bool enabled);
+void PCI_JournalRecord(uint32_t bus_number, uint32_t function_number, uint32_t offset);	// Before writing behind the wrappers' backs
+void PCI_JournalRestore();
+
 #define INT_VIDEO					0x10
 #define INT_PCI_BIOS        		0x1A		// PCI BIOS interrupt 
 
@@ -169,19 +432,40 @@ typedef struct nv_device_info_s
 	void (*shutdown_function)();						// Function to call on shutdown
 	bool (*gpus_section_applies)(uint32_t fourcc);		// Does this GPUS section apply for this GPU?
 	bool (*gpus_section_parse)(uint32_t fourcc, FILE* stream);		// Parse a specific GPUS section
+	struct gpu_script_command_s* script_commands;		// NULL-terminated script commands only this GPU has, or NULL
+	bool (*sim_init_function)();						// Hooks the registers a simulated one needs to behave (see GPUSim_AddHook), or NULL
 } nv_device_info_t; 
 
 /* List of supported devices */
 extern nv_device_info_t supported_devices[]; 
 
+/* Shadow register cache (see gpu_io.c) */
+#define GPU_SHADOW_SPACE_SIZE		0x10000			// Registers past this offset aren't shadowed
+
+#define GPU_SHADOW_FLAG_VALID		0x01			// We know the register's value
+#define GPU_SHADOW_FLAG_NO_READ		0x02			// Write-only or read has side effects: reads come from the shadow
+
+typedef enum gpu_shadow_space_e
+{
+	gpu_shadow_space_mmio = 0,
+	gpu_shadow_space_port = 1,
+	gpu_shadow_space_count,
+} gpu_shadow_space;
+
+typedef struct gpu_shadow_s
+{
+	uint32_t* values[gpu_shadow_space_count];		// One per dword, allocated on first use
+	uint8_t* flags[gpu_shadow_space_count];
+} gpu_shadow_t;
+
 /* Full NV Device Struct (shared across all devices) */
 typedef struct nv_device_s
 {
 	nv_device_info_t device_info;
 	uint32_t bus_number;			// PCI bus number
 	uint32_t function_number; 		// PCI function number
-	void* bar0;						// PCI BAR0 mapping - gpu stuff
-	void* bar1;						// PCI BAR1 mapping for DFB
+	void* bar0;						// Near pointer to the BAR0 mapping, NULL unless near pointers are enabled
+	void* bar1;						// Near pointer to the BAR1 mapping, NULL unless near pointers are enabled
 	int32_t bar0_selector;			// MUST BE USED FOR ACCESS TO BAR0
 	int32_t bar1_selector;			// MUST BE USED FOR ACCESS TO BAR1
 	uint32_t bar1_dfb_start;		// DFB start address
@@ -198,12 +482,61 @@ typedef struct nv_device_s
 	uint32_t mpll;					// [NV1+] Core Clock [NV4+] Memory Clock
 	uint32_t vpll;					// [NV1+] Video Clock
 	uint32_t nvpll;					// [NV4+] Core Clock
+
+	gpu_shadow_t* shadow;			// Shadow register cache. NULL (and not recording) until GPU_ShadowMark/GPU_ShadowGet first use it
+	pci_config_snapshot_t pci_config;	// Cached config space. Our own config writes keep it up to date
+	pci_bar_t bars[PCI_NUM_BARS];	// Sized BARs, filled in by the init function
+
+	uint32_t index;					// Position in gpu_devices (what -device takes)
+	bool initialized;				// init_function has run and succeeded, so shutdown_function needs to run
+	void* arch_state;				// Architecture-specific state (r128_state_t etc.), allocated on first use, freed at shutdown
 } nv_device_t;
 
-extern nv_device_t current_device;
+/* Every supported GPU found by GPU_Detect, in bus order */
+#define GPU_MAX_DEVICES				8
+
+extern nv_device_t gpu_devices[GPU_MAX_DEVICES];
+extern uint32_t gpu_num_devices;
+extern nv_device_t* gpu_active_device;		// The device every accessor talks to. Only GPU_SelectDevice changes it
+
+// Everything predates multi-GPU support and just says current_device
+#define current_device				(*gpu_active_device)
 
 // Detection functions
 bool GPU_Detect(); 
+bool GPU_SelectDevice(uint32_t index);
+
+// Near pointer fast path (see gpu_io.c)
+bool GPU_EnableNearPointers();
+void GPU_DisableNearPointers();
+
+// Posted write queue (see gpu_io.c)
+void GPU_EnableWriteQueue(bool enabled);
+void GPU_FlushWrites();
+void GPU_WriteBarrier();
+
+// Register polling (see gpu_io.c)
+typedef enum gpu_poll_space_e
+{
+	gpu_poll_space_mmio = 0,
+	gpu_poll_space_dfb = 1,
+	gpu_poll_space_port = 2,		// offset is an absolute port number
+} gpu_poll_space;
+
+typedef struct gpu_poll_result_s
+{
+	bool matched;				// False if it timed out
+	uint32_t value;				// The last value read
+	uint32_t iterations;		// Reads it took
+	uint64_t cycles;			// TSC cycles (uclock ticks without a TSC) from the first read to the last
+} gpu_poll_result_t;
+
+bool GPU_Poll32(gpu_poll_space space, uint32_t offset, uint32_t mask, uint32_t match, uint64_t timeout_cycles, gpu_poll_result_t* result);
+
+// Shadow register cache (see gpu_io.c)
+void GPU_ShadowMark(gpu_shadow_space space, uint32_t offset, uint32_t size, bool no_read);
+bool GPU_ShadowGet(gpu_shadow_space space, uint32_t offset, uint32_t* val);
+void GPU_ShadowReset();
 
 
 //
@@ -224,6 +557,113 @@ void nv_dfb_write8(uint32_t offset, uint8_t val);
 void nv_dfb_write16(uint32_t offset, uint16_t val);
 void nv_dfb_write32(uint32_t offset, uint32_t val);
 
+/* Block transfers. Sizes are in bytes; use these for anything bigger than a handful of registers */
+void mmio_read_block(uint32_t offset, void* buffer, uint32_t size);
+void mmio_write_block(uint32_t offset, const void* buffer, uint32_t size);
+void mmio_fill32(uint32_t offset, uint32_t val, uint32_t size);
+void nv_dfb_read_block(uint32_t offset, void* buffer, uint32_t size);
+void nv_dfb_write_block(uint32_t offset, const void* buffer, uint32_t size);
+void nv_dfb_fill32(uint32_t offset, uint32_t val, uint32_t size);
+
+
+/* Port I/O. Absolute port numbers */
+uint8_t port_read8(uint16_t port);
+uint16_t port_read16(uint16_t port);
+void port_write8(uint16_t port, uint8_t val);
+void port_write16(uint16_t port, uint16_t val);
+uint32_t port_read32(uint16_t port);
+void port_write32(uint16_t port, uint32_t val);
+
+/* Read-modify-write. Replaces the bits in mask with val and returns the new value. Non-readable registers are read from the shadow */
+uint32_t mmio_rmw32(uint32_t offset, uint32_t mask, uint32_t val);
+uint32_t port_rmw32(uint16_t port, uint32_t mask, uint32_t val);
+
+/* String port I/O. Sizes are in bytes (whole dwords). The block functions hit the same port every time (rep insl/outsl, for FIFOs and data ports);
+   port_read_range32 walks consecutive ports, for dumping a register file in one go */
+void port_read_block32(uint16_t port, void* buffer, uint32_t size);
+void port_write_block32(uint16_t port, const void* buffer, uint32_t size);
+void port_read_range32(uint16_t port, void* buffer, uint32_t size);
+
+//
+// I/O backends
+// Every access above ends up in one of these. The hardware backend talks to the real card; the simulated
+// backend keeps everything in RAM so scripts, GPUS files and tests can run without one.
+//
+
+typedef struct gpu_io_backend_s
+{
+	const char* name;
+
+	uint8_t (*mmio_read8)(uint32_t offset);
+	uint32_t (*mmio_read32)(uint32_t offset);
+	void (*mmio_write8)(uint32_t offset, uint8_t val);
+	void (*mmio_write32)(uint32_t offset, uint32_t val);
+
+	uint8_t (*dfb_read8)(uint32_t offset);
+	uint16_t (*dfb_read16)(uint32_t offset);
+	uint32_t (*dfb_read32)(uint32_t offset);
+	void (*dfb_write8)(uint32_t offset, uint8_t val);
+	void (*dfb_write16)(uint32_t offset, uint16_t val);
+	void (*dfb_write32)(uint32_t offset, uint32_t val);
+
+	void (*mmio_read_block)(uint32_t offset, void* buffer, uint32_t size);
+	void (*mmio_write_block)(uint32_t offset, const void* buffer, uint32_t size);
+	void (*mmio_fill32)(uint32_t offset, uint32_t val, uint32_t size);
+	void (*dfb_read_block)(uint32_t offset, void* buffer, uint32_t size);
+	void (*dfb_write_block)(uint32_t offset, const void* buffer, uint32_t size);
+	void (*dfb_fill32)(uint32_t offset, uint32_t val, uint32_t size);
+
+	uint8_t (*port_read8)(uint16_t port);
+	uint16_t (*port_read16)(uint16_t port);
+	void (*port_write8)(uint16_t port, uint8_t val);
+	void (*port_write16)(uint16_t port, uint16_t val);
+	uint32_t (*port_read32)(uint16_t port);
+	void (*port_write32)(uint16_t port, uint32_t val);
+	void (*port_read_block32)(uint16_t port, void* buffer, uint32_t size);
+	void (*port_write_block32)(uint16_t port, const void* buffer, uint32_t size);
+	void (*port_read_range32)(uint16_t port, void* buffer, uint32_t size);
+
+	// Optional. If NULL, config space goes through the PCI BIOS
+	uint32_t (*pci_read32)(uint32_t bus_number, uint32_t function_number, uint32_t offset);
+	void (*pci_write32)(uint32_t bus_number, uint32_t function_number, uint32_t offset, uint32_t val);
+} gpu_io_backend_t;
+
+extern gpu_io_backend_t* gpu_io_backend;			// The backend in use
+extern gpu_io_backend_t gpu_io_backend_sim;			// gpu_io_sim.c
+
+#ifdef __DJGPP__
+extern gpu_io_backend_t gpu_io_backend_hardware;	// gpu_io_hw.c
+#define GPU_IO_BACKEND_DEFAULT		gpu_io_backend_hardware
+#else
+// No hardware to talk to outside DOS. Until GPUSim_Init, every read floats high like an empty slot
+#define GPU_IO_BACKEND_DEFAULT		gpu_io_backend_sim
+#endif
+
+/* Simulated backend */
+typedef enum gpu_sim_space_e
+{
+	gpu_sim_space_mmio = 0,
+	gpu_sim_space_dfb = 1,
+	gpu_sim_space_port = 2,
+	gpu_sim_space_pci = 3,
+
+	gpu_sim_space_count,
+} gpu_sim_space; 
+
+#define GPU_SIM_MMIO_SIZE				0x1000000		// 16MB of simulated MMIO
+#define GPU_SIM_VRAM_SIZE				0x1000000		// 16MB of simulated VRAM
+#define GPU_SIM_PORT_SIZE				0x10000			// The whole x86 port space
+#define GPU_SIM_PCI_SIZE				0x100			// One type-0 config header
+#define GPU_SIM_HOOKS_MAX				256
+
+// Hooks work on the aligned dword containing the access. A read hook returns the value the read should see;
+// a write hook gets the old and new dword and returns the value to store.
+typedef uint32_t (*gpu_sim_read_hook_t)(uint32_t offset, uint32_t value);
+typedef uint32_t (*gpu_sim_write_hook_t)(uint32_t offset, uint32_t old_value, uint32_t value);
+
+bool GPUSim_Init(uint32_t vendor_id, uint32_t device_id);
+bool GPUSim_AddHook(gpu_sim_space space, uint32_t offset, gpu_sim_read_hook_t read_hook, gpu_sim_write_hook_t write_hook);
+void GPUSim_Shutdown();
 
 // Clock
 
@@ -266,23 +706,115 @@ void vga_attribute_write(uint8_t index, uint8_t value);
 // SCRIPT PARSER
 //
 
-void Script_Run();
+#define GPU_SCRIPT_MAX_ARGS		16			// Including the command name
+#define GPU_SCRIPT_LINE_SIZE		260			// MAX_STR, which util.h may not have defined yet when it pulls this header in
+
+/* A line split into arguments once, with every argument already decoded as hex */
+typedef struct gpu_script_args_s
+{
+	uint32_t argc;							// Including the command name
+	char* argv[GPU_SCRIPT_MAX_ARGS];		// Point into tokens
+	uint32_t values[GPU_SCRIPT_MAX_ARGS];	// argv decoded as hex (0 if it isn't a number)
+	bool is_number[GPU_SCRIPT_MAX_ARGS];
+	char text[GPU_SCRIPT_LINE_SIZE];		// The trimmed line as it was
+	char tokens[GPU_SCRIPT_LINE_SIZE];		// The same line with a NUL after every argument
+} gpu_script_args_t;
+
+bool Script_Run();										// False if the script didn't run to the end
 void Script_RunCommand(char* line_buf);
+bool Script_Tokenize(const char* line, gpu_script_args_t* args);
+bool Script_EvaluateArgs(gpu_script_args_t* args);		// Fills in values for $variable and (expression) arguments. False if one can't be evaluated
+
+/* Variables and expressions (see gpu_script_expression.c). Assigned by name (set x 5), read back as $x */
+#define GPU_SCRIPT_MAX_VARIABLES		64
+#define GPU_SCRIPT_VARIABLE_NAME_SIZE	32			// Including the NUL
+#define GPU_SCRIPT_MAX_DEPTH			16			// How deep for/repeat/if blocks can nest
+
+bool Script_IsVariableName(const char* name);
+uint32_t* Script_GetVariable(const char* name, bool create);		// NULL if it doesn't exist (or can't be created)
+void Script_ClearVariables();
+bool Script_Evaluate(const char* expression, uint32_t* value);
+
+/* Bytecode opcodes. Anything without its own opcode is compiled as its text and run through Script_RunCommand */
+typedef enum gpu_script_opcode_e
+{
+	script_op_text = 0,
+	script_op_write_mmio8,
+	script_op_write_mmio32,
+	script_op_write_vram8,
+	script_op_write_vram16,
+	script_op_write_vram32,
+	script_op_flush,
+	script_op_barrier,
+	script_op_for,				// Blocks. address is where to go when the loop doesn't run or the condition is false
+	script_op_repeat,
+	script_op_next,
+	script_op_if,
+	script_op_jump,
+	script_op_count,
+} gpu_script_opcode;
 
 // This sucks. It's not a proper lexer/tokeniser, but we don't need one
 typedef struct gpu_script_command_s
 {
 	const char* name_abbrev;
 	const char* name_full;		// don't really need an alias system
-	bool (*function)();
+	bool (*function)(gpu_script_args_t* args);
 	uint32_t num_parameters;		// for parameter size checking
+	gpu_script_opcode opcode;		// What the compiler turns it into when every parameter is a number
 } gpu_script_command_t; 
 
 extern gpu_script_command_t commands[];
 
+/* Command registry (see gpu_script_registry.c). Lookups are by either name, through a hash table that grows as commands are added */
+#define GPU_SCRIPT_REGISTRY_INITIAL_SIZE	128		// Slots; both names of every built-in command fit without growing
+
+void Script_InitCommands();												// Registers commands[]. Called at startup, or on first use
+bool Script_RegisterCommand(gpu_script_command_t* command);
+bool Script_RegisterCommands(gpu_script_command_t* command_table);		// NULL-terminated, like commands[]
+gpu_script_command_t* Script_FindCommand(const char* name);
+void Script_ShutdownCommands();
+
 /* Command utility stuff */
+const char* Script_ArgvRest(const gpu_script_args_t* args, uint32_t argv);
+bool Script_Wait32(gpu_script_args_t* args, gpu_poll_space space, uint32_t base);		// wait32 and friends: <offset> <mask> <value> <timeout in us>
+void Script_Abort();																	// Stop the script after the command that is running
+
+// For code that doesn't have the args to hand. These read the command that is running now
 const char* Command_Argv(uint32_t argv);
 uint32_t Command_Argc();
+const char* Command_ArgvRest(uint32_t argv);
+
+/* Compiled scripts (see gpu_script_bytecode.c), cached next to the source as <name>.nvc */
+#define GPU_SCRIPT_BYTECODE_MAGIC		0x4350564E	// 'NVPC'
+#define GPU_SCRIPT_BYTECODE_VERSION		3
+#define GPU_SCRIPT_BYTECODE_EXTENSION	".nvc"
+
+typedef struct gpu_script_bytecode_header_s
+{
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t source_size;		// The cache is only used if all three of these still match the source
+	uint32_t source_mtime;
+	uint32_t source_crc32;
+	uint32_t commands_crc32;	// Command names and opcodes this was compiled against, so a different build recompiles
+	uint32_t num_instructions;
+	uint32_t code_size;			// Bytes of instructions after the header
+} gpu_script_bytecode_header_t;
+
+typedef struct gpu_script_instruction_s
+{
+	uint8_t opcode;				// gpu_script_opcode
+	uint8_t width;				// Access size in bytes, 0 if it doesn't access anything
+	uint16_t text_size;			// script_op_text/for/repeat/if: bytes of line that follow, NUL included and padded to 4
+	uint32_t address;			// Blocks: offset of the instruction to jump to
+	uint32_t value;
+} gpu_script_instruction_t;
+
+uint8_t* Script_Compile(const char* source, uint32_t source_size, uint32_t* code_size, uint32_t* num_instructions);
+bool Script_Execute(const uint8_t* code, uint32_t code_size);		// False if the script stopped early
+uint8_t* Script_LoadCompiled(const char* file_name, uint32_t* code_size);		// Compiles (and caches) if the cache is missing or stale
 
 //
 // SAVESTATES
@@ -12,11 +12,36 @@
 #include "util/util.h"
 #include <gpuplay.h>
 #include <config/config.h>
+#include <core/mtrr/gpu_mtrr.h>
+#include <core/timing/gpu_timing.h>
+#include <core/trace/gpu_trace.h>
 #include <stdio.h>
 
+#ifdef __DJGPP__
+#include <crt0.h>
+
 #define GDB_IMPLEMENTATION
 #include "gdbstub.h"
 
+// Locked memory is for the gdb stub's interrupt handlers. Keep the DS base fixed so near pointers to the BARs stay valid after malloc
+int _crt0_startup_flags = _CRT0_FLAG_LOCK_MEMORY | _CRT0_FLAG_NONMOVE_SBRK;
+#else
+// host builds can be debugged with the host's own gdb
+#define _gdb_start()
+#endif
+
+/*
+	Exit codes:
+	0 = success, 1 = no PCI BIOS, 2 = no GPU (or the simulated one failed), 3 = GPU unsupported or config failed to load,
+	4 = GPU init failed, 5 = no tests enabled, 6 = script stopped early (e.g. a wait32 timed out),
+	7 = logging failed to start or the script failed to compile, 8 = tracing failed to start, 9 = timing failed to start,
+	0x5042 = unknown initialisation error
+*/
+#define GPUPLAY_EXIT_SCRIPT_FAILED		6
+
+// What GPUPlay_Shutdown exits with
+static int32_t gpuplay_exit_code = 0;
+
 
 void GPUPlay_RunTests()
 {
@@ -24,6 +49,13 @@ void GPUPlay_RunTests()
 
 	if (config.num_tests_enabled == 0)
 	{
+		// with -alldevices, the next GPU might still have something to run
+		if (command_line.all_devices)
+		{
+			Logging_Write(log_level_warning, "No tests to run on %s\n", current_device.device_info.name);
+			return;
+		}
+
 		Logging_Write(log_level_warning, "No tests to run. Exiting...\n");
 		exit(5);
 	}
@@ -86,24 +118,84 @@ void GPUPlay_RunTests()
 
 
 
-void GPUPlay_Run()
+/* Bring up the selected GPU. Returns false if it isn't supported or its init function failed */
+bool GPUPlay_InitDevice()
 {
-/* Make sure the GPU is supported */
+	// before the -sim check, so a script sees the same commands on the simulated GPU as on the real one
+	if (current_device.device_info.script_commands)
+		Script_RegisterCommands(current_device.device_info.script_commands);
+
+	// a simulated GPU has no bring-up to do, the backend is already live
+	if (command_line.simulate)
+		return true;
+
+	/* Make sure the GPU is supported */
 	if (!current_device.device_info.init_function)
 	{
 		Logging_Write(log_level_error, "This GPU is not yet supported :(\n");
-		exit(3);
+		return false;
 	}
 
 	if (!current_device.device_info.init_function())
 	{
 		Logging_Write(log_level_error, "GPU initialisation failed!\n");
-		exit(4);
+		return false;
 	}	
 
+	current_device.initialized = true;
+
+	if (command_line.use_nearptr)
+		GPU_EnableNearPointers();
+
+	// not fatal: everything still works, just slower
+	if (command_line.write_combining)
+		GPU_EnableWriteCombining();
+
+	return true;
+}
+
+/* Test mode on every detected GPU in turn. One that won't come up doesn't stop the rest */
+void GPUPlay_RunAllDevices()
+{
+	for (uint32_t device = 0; device < gpu_num_devices; device++)
+	{
+		GPU_SelectDevice(device);
+		Logging_Write(log_level_message, "GPU %lu of %lu: %s\n", device + 1, gpu_num_devices, current_device.device_info.name);
+
+		// the test list depends on which GPU it's for
+		Config_UnloadTests();
+
+		if (!Config_Load()
+		|| !GPUPlay_InitDevice())
+			continue;
+
+		GPUPlay_RunTests();
+	}
+}
+
+void GPUPlay_Run()
+{
+	if (command_line.use_write_queue)
+		GPU_EnableWriteQueue(true);
+
+	if (command_line.all_devices
+	&& command_line.use_test_ini
+	&& !command_line.load_reg_script
+	&& !command_line.load_savestate_file)
+	{
+		GPUPlay_RunAllDevices();
+		return;
+	}
+
+	if (!GPUPlay_InitDevice())
+		exit((current_device.device_info.init_function) ? 4 : 3);
 
 	if (command_line.load_reg_script)
-		Script_Run();
+	{
+		// batch callers find out from the exit status, not the log
+		if (!Script_Run())
+			gpuplay_exit_code = GPUPLAY_EXIT_SCRIPT_FAILED;
+	}
 	else if (command_line.load_savestate_file)
 		GPUS_Load();
 	else if (command_line.use_test_ini)
@@ -114,11 +206,39 @@ void GPUPlay_Run()
 
 void GPUPlay_Shutdown()
 {
-	if (current_device.device_info.shutdown_function)
-		current_device.device_info.shutdown_function();
+	// before any device is shut down, since it talks to the device that changed mode
+	AGP_Restore();
+
+	for (uint32_t device = 0; device < gpu_num_devices; device++)
+	{
+		GPU_SelectDevice(device);
+
+		if (current_device.initialized
+		&& current_device.device_info.shutdown_function)
+			current_device.device_info.shutdown_function();
+
+		GPU_FlushWrites();
+		GPU_DisableNearPointers();
+		GPU_ShadowReset();
+
+		free(current_device.arch_state);
+		current_device.arch_state = NULL;
+	}
+
+	// last, so the shutdown functions still had bus mastering and decoding to talk to the GPUs with
+	PCI_JournalRestore();
+
+	// the LFBs are gone, so their WC ranges go too
+	MTRR_Shutdown();
+
+	if (command_line.simulate)
+		GPUSim_Shutdown();
+
+	Script_ShutdownCommands();
+	Trace_Shutdown();
 
 	Logging_Shutdown();
-	exit(0);
+	exit(gpuplay_exit_code);
 }
 
 void GPUPlay_ShowHelpAndExit()
@@ -148,6 +268,14 @@ bool GPUPlay_Init(int32_t argc, char** argv)
 
 	Logging_Write(log_level_message, APP_SIGNON_STRING);
 
+	// Everything that measures time (trace timestamps included) needs the TSC calibrated first
+	if (!Timing_Init())
+		exit(9);
+
+	// Start tracing before the first PCI access. Does nothing unless built with GPUPLAY_TRACE
+	if (!Trace_Init())
+		exit(8);
+
 	// return
 		if (command_line.show_help)
 	{
@@ -155,10 +283,40 @@ bool GPUPlay_Init(int32_t argc, char** argv)
 		return false;
 	}
 
-	if (!PCI_BiosIsPresent())
-		exit(1);
+	if (!Config_Init())
+		exit(3);
+
+	// so name clashes show up at the top of the log, not at the first script line
+	Script_InitCommands();
+
+	if (command_line.simulate)
+	{
+		if (!GPUSim_Init(command_line.sim_vendor_id, command_line.sim_device_id))
+			exit(2);
+	}
+	else
+	{
+		if (!PCI_BiosIsPresent())
+			exit(1);
+
+		PCI_SelectMechanism(ini_section_get_string(ini_find_section(config.ini_file, "PCI"), "Mechanism", "auto"));
+	}
+
+	// every config write from here on is undone at exit, except with -bootonly where leaving the card set up is the point
+	PCI_JournalEnable(!command_line.boot_only);
+
+	// before detection, so it works on machines without a supported GPU
+	if (command_line.list_devices)
+	{
+		PCI_PrintDeviceTable();
+		GPUPlay_Shutdown();
+	}
+
+	if (!command_line.simulate
+	&& !GPU_Detect())
+		exit(2);
 
-	if (!GPU_Detect())
+	if (!GPU_SelectDevice(command_line.device_index))
 		exit(2);
 
 	if (!Config_Load())
@@ -18,7 +18,14 @@ const char* msg_help = "GPUPlay help:\n\n"
 "-s, -script <file>: Run a .NVS script file.\n"
 "-t, -test: Enter into test mode. If supported graphics hardware is detected, gpuplay.ini will be parsed and tests that are enabled will be run.\n"
 "-nvs, -savestate <file>: EXPERIMENTAL FUNCTIONALITY: Load an NVS savestate file into your graphics hardware\n"
-"-boot, -bootonly: Boot the GPU and exit. This can be used to initialise and run Other GPUs that have broken VBIOSes (at least under DOS and Windows 9x using autoexec)\n"
+"-boot, -bootonly: Boot the GPU and exit. This can be used to initialise and run Other GPUs that have broken VBIOSes (at least under DOS and Windows 9x using autoexec). PCI config space changes are kept; every other mode puts them back on exit\n"
+"-n, -nearptr: Access the GPU through near pointers instead of selectors. Faster, but disables memory protection. Falls back to selectors if the DPMI host doesn't allow it\n"
+"-wq, -writequeue: Queue 32-bit MMIO/VRAM writes and send them in bursts. The queue is drained before any read, by the flush and barrier script commands, and on exit\n"
+"-sim, -simulate <vendor:device>: Don't touch any hardware. MMIO, VRAM, I/O ports and PCI config space are backed by RAM, and the given device (e.g. 1002:5046) is reported as present. Useful for testing scripts and tests. Required outside DOS\n"
+"-l, -list: List every PCI device in the system (vendor, device, class, header type and BARs) and exit\n"
+"-dev, -device <n>: Use the nth supported GPU found (numbered from 0 in the log) instead of the first one\n"
+"-ad, -alldevices: With -test, run the enabled tests on every supported GPU found, one after another\n"
+"-wc, -writecombine: Make the linear framebuffer write-combining with an MTRR, and log the write bandwidth before and after. Needs a ring 0 DPMI host (e.g. CWSDPR0); the MTRR is removed on exit\n"
 "-?, -help: Show this text and exit\n\n"
 "---SUPPORTED GRAPHICS CARDS---\n\n"
 "The following graphics cards are supported by GPUPlay:\n"
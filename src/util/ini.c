@@ -603,12 +603,12 @@ ini_section_get_int(ini_section_t self, const char *name, int32_t def)
     if (entry == NULL)
         return def;
 
-    if (stricmp(entry->data, "true") == 0)
+    if (strcasecmp(entry->data, "true") == 0)
         return 1;
-    if (stricmp(entry->data, "false") == 0)
+    if (strcasecmp(entry->data, "false") == 0)
         return 0;
 
-    sscanf(entry->data, "%li", &value);
+    sscanf(entry->data, "%" SCNi32, &value);
     
     return value;
 }
@@ -627,7 +627,7 @@ ini_section_get_uint(ini_section_t self, const char *name, uint32_t def)
     if (entry == NULL)
         return def;
 
-    sscanf(entry->data, "%lu", &value);
+    sscanf(entry->data, "%" SCNu32, &value);
 
     return value;
 }
@@ -676,7 +676,7 @@ ini_section_get_hex16(ini_section_t self, const char *name, int32_t def)
     if (entry == NULL)
         return def;
 
-    sscanf(entry->data, "%04lX", &value);
+    sscanf(entry->data, "%04" SCNx32, &value);
 
     return value;
 }
@@ -695,7 +695,7 @@ ini_section_get_hex20(ini_section_t self, const char *name, int32_t def)
     if (entry == NULL)
         return def;
 
-    sscanf(entry->data, "%05lX", &value);
+    sscanf(entry->data, "%05" SCNx32, &value);
 
     return value;
 }
@@ -714,7 +714,7 @@ ini_section_get_hex32(ini_section_t self, const char *name, int32_t def)
     if (entry == NULL)
         return def;
 
-    sscanf(entry->data, "%08lX", &value);
+    sscanf(entry->data, "%08" SCNx32, &value);
 
     return value;
 }
@@ -735,7 +735,7 @@ ini_section_get_mac(ini_section_t self, const char *name, int32_t def)
     if (entry == NULL)
         return def;
 
-    sscanf(entry->data, "%02lx:%02lx:%02lx", &val0, &val1, &val2);
+    sscanf(entry->data, "%02" SCNx32 ":%02" SCNx32 ":%02" SCNx32, &val0, &val1, &val2);
 
     return ((val0 << 16) + (val1 << 8) + val2);
 }
@@ -769,7 +769,7 @@ ini_section_set_int(ini_section_t self, const char *name, int32_t val)
     if (ent == NULL)
         ent = create_entry(section, name);
 
-    sprintf(ent->data, "%li", val);
+    sprintf(ent->data, "%" PRIi32, val);
 }
 
 void
@@ -785,7 +785,7 @@ ini_section_set_uint(ini_section_t self, const char *name, uint32_t val)
     if (ent == NULL)
         ent = create_entry(section, name);
 
-    sprintf(ent->data, "%li", val);
+    sprintf(ent->data, "%" PRIu32, val);
 }
 
 void
@@ -817,7 +817,7 @@ ini_section_set_hex16(ini_section_t self, const char *name, int32_t val)
     if (ent == NULL)
         ent = create_entry(section, name);
 
-    sprintf(ent->data, "%04lX", val);
+    sprintf(ent->data, "%04" PRIX32, val);
 }
 
 void
@@ -833,7 +833,7 @@ ini_section_set_hex20(ini_section_t self, const char *name, int32_t val)
     if (ent == NULL)
         ent = create_entry(section, name);
 
-    sprintf(ent->data, "%05lX", val);
+    sprintf(ent->data, "%05" PRIX32, val);
 }
 
 void
@@ -849,7 +849,7 @@ ini_section_set_hex32(ini_section_t self, const char *name, int32_t val)
     if (ent == NULL)
         ent = create_entry(section, name);
 
-    sprintf(ent->data, "%08lX", val);
+    sprintf(ent->data, "%08" PRIX32, val);
 }
 
 void
@@ -865,7 +865,7 @@ ini_section_set_mac(ini_section_t self, const char *name, int32_t val)
     if (ent == NULL)
         ent = create_entry(section, name);
 
-    sprintf(ent->data, "%02lx:%02lx:%02lx",
+    sprintf(ent->data, "%02" PRIx32 ":%02" PRIx32 ":%02" PRIx32,
             (val >> 16) & 0xff, (val >> 8) & 0xff, val & 0xff);
 }
 
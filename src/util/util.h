@@ -79,9 +79,18 @@ typedef struct command_line_s
     bool load_replay_file;          // Load a replay file
     bool show_help;                 // Show a help message
     bool boot_only;                 // Boot the card and exit.
+    bool use_nearptr;               // Access the BARs through near pointers instead of selectors
+    bool use_write_queue;           // Buffer 32-bit register writes and drain them in bursts
+    bool simulate;                  // Run against the simulated I/O backend instead of real hardware
+    bool list_devices;              // Print every PCI device and exit
+    bool all_devices;               // Run the test list on every detected GPU, one after another
+    bool write_combining;           // Make the LFB write-combining with an MTRR (ring 0 only)
     char reg_script_file[MAX_STR];  // The registry script file to use
     char savestate_file[MAX_STR];   // The savestate file to use
     char replay_file[MAX_STR];      // The replay file to use
+    uint32_t sim_vendor_id;         // Vendor ID of the simulated GPU
+    uint32_t sim_device_id;         // Device ID of the simulated GPU
+    uint32_t device_index;          // Which detected GPU to use (-device)
 
 } command_line_t;
 
@@ -98,3 +107,21 @@ char* String_GetTokenSeparatedPart(char* fmt, const char* delim, uint32_t n);
 char* String_LTrim(char* fmt, uint32_t max);
 char* String_RTrim(char* fmt, uint32_t max);
 
+// Hash utils
+
+#define HASH_SHA1_DIGEST_SIZE       20
+
+typedef struct hash_sha1_s
+{
+    uint32_t state[5];
+    uint64_t length;                // Bytes hashed so far
+    uint8_t block[64];
+    uint32_t block_used;
+} hash_sha1_t;
+
+uint32_t Hash_CRC32(uint32_t crc, const void* data, uint32_t size);    // Start with crc = 0; feed the result back in to continue
+
+void Hash_SHA1Init(hash_sha1_t* sha1);
+void Hash_SHA1Update(hash_sha1_t* sha1, const void* data, uint32_t size);
+void Hash_SHA1Final(hash_sha1_t* sha1, uint8_t* digest);
+
@@ -29,6 +29,20 @@ command_line_t command_line = {0};
 #define COMMAND_LINE_HELP_FULL "-help"
 #define COMMAND_LINE_BOOTONLY "-b"
 #define COMMAND_LINE_BOOTONLY_FULL "-bootonly"
+#define COMMAND_LINE_NEARPTR "-n"
+#define COMMAND_LINE_NEARPTR_FULL "-nearptr"
+#define COMMAND_LINE_WRITE_QUEUE "-wq"
+#define COMMAND_LINE_WRITE_QUEUE_FULL "-writequeue"
+#define COMMAND_LINE_SIMULATE "-sim"
+#define COMMAND_LINE_SIMULATE_FULL "-simulate"
+#define COMMAND_LINE_LIST "-l"
+#define COMMAND_LINE_LIST_FULL "-list"
+#define COMMAND_LINE_DEVICE "-dev"
+#define COMMAND_LINE_DEVICE_FULL "-device"
+#define COMMAND_LINE_ALL_DEVICES "-ad"
+#define COMMAND_LINE_ALL_DEVICES_FULL "-alldevices"
+#define COMMAND_LINE_WRITE_COMBINING "-wc"
+#define COMMAND_LINE_WRITE_COMBINING_FULL "-writecombine"
 
 
 bool Cmdline_Parse(int argc, char** argv)
@@ -117,6 +131,59 @@ bool Cmdline_Parse(int argc, char** argv)
             // Maybe make it so we can load custom INI files?
             command_line.use_test_ini = true;
         }  
+        else if (!strcasecmp(current_arg, COMMAND_LINE_NEARPTR)
+        || !strcasecmp(current_arg, COMMAND_LINE_NEARPTR_FULL))
+        {
+            command_line.use_nearptr = true; 
+        }
+        else if (!strcasecmp(current_arg, COMMAND_LINE_WRITE_QUEUE)
+        || !strcasecmp(current_arg, COMMAND_LINE_WRITE_QUEUE_FULL))
+        {
+            command_line.use_write_queue = true; 
+        }
+        else if (!strcasecmp(current_arg, COMMAND_LINE_SIMULATE)
+        || !strcasecmp(current_arg, COMMAND_LINE_SIMULATE_FULL))
+        {
+            if (i + 1 >= argc
+            || sscanf(next_arg, "%" SCNx32 ":%" SCNx32, &command_line.sim_vendor_id, &command_line.sim_device_id) != 2)
+            {
+                printf("-simulate provided, but no vendor:device pair provided (e.g. 1002:5046)!\n");
+                return false; 
+            }
+
+            command_line.simulate = true;
+
+            //skip vendor:device
+            i++;
+        }
+        else if (!strcasecmp(current_arg, COMMAND_LINE_LIST)
+        || !strcasecmp(current_arg, COMMAND_LINE_LIST_FULL))
+        {
+            command_line.list_devices = true; 
+        }
+        else if (!strcasecmp(current_arg, COMMAND_LINE_DEVICE)
+        || !strcasecmp(current_arg, COMMAND_LINE_DEVICE_FULL))
+        {
+            if (i + 1 >= argc
+            || sscanf(next_arg, "%" SCNu32, &command_line.device_index) != 1)
+            {
+                printf("-device provided, but no device number provided (see the \"Detected GPU\" lines in the log)!\n");
+                return false; 
+            }
+
+            //skip device number
+            i++;
+        }
+        else if (!strcasecmp(current_arg, COMMAND_LINE_ALL_DEVICES)
+        || !strcasecmp(current_arg, COMMAND_LINE_ALL_DEVICES_FULL))
+        {
+            command_line.all_devices = true; 
+        }
+        else if (!strcasecmp(current_arg, COMMAND_LINE_WRITE_COMBINING)
+        || !strcasecmp(current_arg, COMMAND_LINE_WRITE_COMBINING_FULL))
+        {
+            command_line.write_combining = true; 
+        }
     }
 
     return true; 
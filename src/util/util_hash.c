@@ -0,0 +1,158 @@
+/*
+    GPUPlay
+    Copyright © 2025 frostbite3000
+
+    Raw GPU programming for Other GPUs
+    Licensed under the MIT license (see license file)
+
+    util_hash.c: CRC32 and SHA-1, for identifying dumps
+*/
+
+#include <gpuplay.h>
+#include <string.h>
+
+// Table for the reflected 0xEDB88320 polynomial (the zip/PNG one), built on first use
+static uint32_t crc32_table[256];
+static bool crc32_table_ready = false;
+
+uint32_t Hash_CRC32(uint32_t crc, const void* data, uint32_t size)
+{
+    const uint8_t* bytes = data;
+
+    if (!crc32_table_ready)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t value = i;
+
+            for (uint32_t bit = 0; bit < 8; bit++)
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320 : (value >> 1);
+
+            crc32_table[i] = value;
+        }
+
+        crc32_table_ready = true;
+    }
+
+    crc = ~crc;
+
+    while (size--)
+        crc = crc32_table[(crc ^ *bytes++) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+#define HASH_ROL32(value, bits)     (((value) << (bits)) | ((value) >> (32 - (bits))))
+
+static void Hash_SHA1Block(hash_sha1_t* sha1, const uint8_t* block)
+{
+    uint32_t w[80];
+
+    for (uint32_t i = 0; i < 16; i++)
+        w[i] = ((uint32_t)block[i * 4] << 24) | (block[i * 4 + 1] << 16) | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+
+    for (uint32_t i = 16; i < 80; i++)
+        w[i] = HASH_ROL32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = sha1->state[0], b = sha1->state[1], c = sha1->state[2], d = sha1->state[3], e = sha1->state[4];
+
+    for (uint32_t i = 0; i < 80; i++)
+    {
+        uint32_t f, k;
+
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        uint32_t temp = HASH_ROL32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = HASH_ROL32(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    sha1->state[0] += a;
+    sha1->state[1] += b;
+    sha1->state[2] += c;
+    sha1->state[3] += d;
+    sha1->state[4] += e;
+}
+
+void Hash_SHA1Init(hash_sha1_t* sha1)
+{
+    memset(sha1, 0, sizeof(hash_sha1_t));
+
+    sha1->state[0] = 0x67452301;
+    sha1->state[1] = 0xEFCDAB89;
+    sha1->state[2] = 0x98BADCFE;
+    sha1->state[3] = 0x10325476;
+    sha1->state[4] = 0xC3D2E1F0;
+}
+
+void Hash_SHA1Update(hash_sha1_t* sha1, const void* data, uint32_t size)
+{
+    const uint8_t* bytes = data;
+
+    sha1->length += size;
+
+    while (size)
+    {
+        uint32_t amount = sizeof(sha1->block) - sha1->block_used;
+
+        if (amount > size)
+            amount = size;
+
+        memcpy(&sha1->block[sha1->block_used], bytes, amount);
+        sha1->block_used += amount;
+        bytes += amount;
+        size -= amount;
+
+        if (sha1->block_used == sizeof(sha1->block))
+        {
+            Hash_SHA1Block(sha1, sha1->block);
+            sha1->block_used = 0;
+        }
+    }
+}
+
+/* Pad, then write the 20 byte digest */
+void Hash_SHA1Final(hash_sha1_t* sha1, uint8_t* digest)
+{
+    uint64_t bit_length = sha1->length << 3;
+    uint8_t padding = 0x80;
+
+    Hash_SHA1Update(sha1, &padding, 1);
+    padding = 0;
+
+    // leave exactly 8 bytes in the last block for the length
+    while (sha1->block_used != sizeof(sha1->block) - 8)
+        Hash_SHA1Update(sha1, &padding, 1);
+
+    uint8_t length_bytes[8];
+
+    for (uint32_t i = 0; i < 8; i++)
+        length_bytes[i] = bit_length >> (56 - i * 8);
+
+    Hash_SHA1Update(sha1, length_bytes, 8);
+
+    for (uint32_t i = 0; i < HASH_SHA1_DIGEST_SIZE; i++)
+        digest[i] = sha1->state[i >> 2] >> (24 - (i & 3) * 8);
+}